@@ -0,0 +1,553 @@
+#include <engine/aabbTree.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AABB_TREE_SSE
+#endif
+
+static constexpr int PACKET_SIZE = 4;
+
+AabbTree::AabbTree(float margin) : _margin(margin) {}
+
+int AabbTree::insert(const AABB &bounds, void *userData)
+{
+    int leaf = allocateNode();
+    _nodes[leaf].bounds = {bounds.min - _margin, bounds.max + _margin};
+    _nodes[leaf].userData = userData;
+    insertLeaf(leaf);
+
+    _proxyCount++;
+    return leaf;
+}
+
+void AabbTree::insert(int count, const AABB *bounds, void *const *userData, int *proxies)
+{
+    if (count < _proxyCount)
+    {
+        SpatialIndex::insert(count, bounds, userData, proxies);
+        return;
+    }
+
+    // Leaves only, the tree above them is built once they are all in
+    for (int i = 0; i < count; i++)
+    {
+        int leaf = allocateNode();
+        _nodes[leaf].bounds = {bounds[i].min - _margin, bounds[i].max + _margin};
+        _nodes[leaf].userData = userData[i];
+        proxies[i] = leaf;
+    }
+    _proxyCount += count;
+    _root = NULL_NODE;
+
+    rebuild();
+}
+
+void AabbTree::update(int proxy, const AABB &bounds)
+{
+    if (_nodes[proxy].bounds.contains(bounds))
+        return;
+
+    removeLeaf(proxy);
+    _nodes[proxy].bounds = {bounds.min - _margin, bounds.max + _margin};
+    insertLeaf(proxy);
+    _reinserted++;
+}
+
+void AabbTree::remove(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    _proxyCount--;
+}
+
+void AabbTree::clear()
+{
+    _nodes.clear();
+    _root = NULL_NODE;
+    _freeList = NULL_NODE;
+    _proxyCount = 0;
+}
+
+void AabbTree::rebuild()
+{
+    if (_proxyCount == 0)
+        return;
+
+    // Twice the centers, only their order matters
+    std::vector<BuildLeaf> leaves;
+    leaves.reserve(_proxyCount);
+    for (int i = 0; i < (int)_nodes.size(); i++)
+    {
+        if (_nodes[i].height == 0)
+            leaves.push_back({_nodes[i].bounds.min + _nodes[i].bounds.max, i});
+        else if (_nodes[i].height > 0)
+            freeNode(i);
+    }
+
+    _root = build(leaves.data(), leaves.size());
+    _nodes[_root].parent = NULL_NODE;
+}
+
+int AabbTree::build(BuildLeaf *leaves, int count)
+{
+    if (count == 1)
+        return leaves[0].node;
+
+    glm::vec3 min = leaves[0].center;
+    glm::vec3 max = min;
+    for (int i = 1; i < count; i++)
+    {
+        min = glm::min(min, leaves[i].center);
+        max = glm::max(max, leaves[i].center);
+    }
+
+    glm::vec3 size = max - min;
+    int axis = size.x > size.y && size.x > size.z ? 0 : (size.y > size.z ? 1 : 2);
+    int half = count / 2;
+    std::nth_element(leaves, leaves + half, leaves + count, [axis](const BuildLeaf &a, const BuildLeaf &b)
+                     { return a.center[axis] < b.center[axis]; });
+
+    int left = build(leaves, half);
+    int right = build(leaves + half, count - half);
+
+    int node = allocateNode();
+    Node &parent = _nodes[node];
+    parent.children[0] = left;
+    parent.children[1] = right;
+    parent.bounds = _nodes[left].bounds.merged(_nodes[right].bounds);
+    parent.height = 1 + std::max(_nodes[left].height, _nodes[right].height);
+    _nodes[left].parent = node;
+    _nodes[right].parent = node;
+
+    return node;
+}
+
+void *AabbTree::getUserData(int proxy) const { return _nodes[proxy].userData; }
+int AabbTree::getProxyCount() const { return _proxyCount; }
+const AABB &AabbTree::getBounds(int proxy) const { return _nodes[proxy].bounds; }
+
+int AabbTree::getHeight() const
+{
+    return _root == NULL_NODE ? 0 : _nodes[_root].height;
+}
+
+int AabbTree::allocateNode()
+{
+    if (_freeList == NULL_NODE)
+    {
+        _nodes.emplace_back();
+        return _nodes.size() - 1;
+    }
+
+    int node = _freeList;
+    _freeList = _nodes[node].parent;
+    _nodes[node] = Node();
+    return node;
+}
+
+void AabbTree::freeNode(int node)
+{
+    _nodes[node].height = -1;
+    _nodes[node].parent = _freeList;
+    _freeList = node;
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+    if (_root == NULL_NODE)
+    {
+        _root = leaf;
+        _nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    AABB bounds = _nodes[leaf].bounds;
+    int index = _root;
+    while (!_nodes[index].isLeaf())
+    {
+        const Node &node = _nodes[index];
+        float area = node.bounds.getPerimeter();
+        float combinedArea = node.bounds.merged(bounds).getPerimeter();
+
+        // Pairing the leaf with this node makes a new parent, going further down grows this node anyway
+        float cost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        for (int i = 0; i < 2; i++)
+        {
+            const Node &child = _nodes[node.children[i]];
+            float merged = child.bounds.merged(bounds).getPerimeter();
+            childCosts[i] = (child.isLeaf() ? merged : merged - child.bounds.getPerimeter()) + inheritedCost;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+            break;
+
+        index = node.children[childCosts[0] < childCosts[1] ? 0 : 1];
+    }
+
+    int sibling = index;
+    int oldParent = _nodes[sibling].parent;
+    int newParent = allocateNode();
+
+    Node &parent = _nodes[newParent];
+    parent.parent = oldParent;
+    parent.bounds = _nodes[sibling].bounds.merged(bounds);
+    parent.height = _nodes[sibling].height + 1;
+    parent.children[0] = sibling;
+    parent.children[1] = leaf;
+    _nodes[sibling].parent = newParent;
+    _nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE)
+        _root = newParent;
+    else
+    {
+        int *children = _nodes[oldParent].children;
+        children[children[0] == sibling ? 0 : 1] = newParent;
+    }
+
+    refit(newParent);
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+    if (leaf == _root)
+    {
+        _root = NULL_NODE;
+        return;
+    }
+
+    int parent = _nodes[leaf].parent;
+    int grandParent = _nodes[parent].parent;
+    const int *children = _nodes[parent].children;
+    int sibling = children[0] == leaf ? children[1] : children[0];
+
+    freeNode(parent);
+    _nodes[sibling].parent = grandParent;
+    if (grandParent == NULL_NODE)
+    {
+        _root = sibling;
+        return;
+    }
+
+    int *grandChildren = _nodes[grandParent].children;
+    grandChildren[grandChildren[0] == parent ? 0 : 1] = sibling;
+    refit(grandParent);
+}
+
+void AabbTree::refit(int index)
+{
+    while (index != NULL_NODE)
+    {
+        index = balance(index);
+
+        Node &node = _nodes[index];
+        const Node &left = _nodes[node.children[0]];
+        const Node &right = _nodes[node.children[1]];
+        node.height = 1 + std::max(left.height, right.height);
+        node.bounds = left.bounds.merged(right.bounds);
+
+        index = node.parent;
+    }
+}
+
+int AabbTree::balance(int a)
+{
+    Node &nodeA = _nodes[a];
+    if (nodeA.isLeaf() || nodeA.height < 2)
+        return a;
+
+    // The deeper child takes the place of a, a keeps the other child and the shallower grandchild
+    int deeper = _nodes[nodeA.children[1]].height > _nodes[nodeA.children[0]].height ? 1 : 0;
+    int b = nodeA.children[deeper];
+    int c = nodeA.children[1 - deeper];
+    Node &nodeB = _nodes[b];
+    Node &nodeC = _nodes[c];
+    if (nodeB.height - nodeC.height < 2)
+        return a;
+
+    int f = nodeB.children[0];
+    int g = nodeB.children[1];
+    Node &nodeF = _nodes[f];
+    Node &nodeG = _nodes[g];
+
+    nodeB.children[0] = a;
+    nodeB.parent = nodeA.parent;
+    nodeA.parent = b;
+
+    if (nodeB.parent == NULL_NODE)
+        _root = b;
+    else
+    {
+        int *children = _nodes[nodeB.parent].children;
+        children[children[0] == a ? 0 : 1] = b;
+    }
+
+    // The deeper grandchild stays under b
+    bool keepF = nodeF.height > nodeG.height;
+    int kept = keepF ? f : g;
+    int moved = keepF ? g : f;
+    Node &nodeKept = _nodes[kept];
+    Node &nodeMoved = _nodes[moved];
+
+    nodeB.children[1] = kept;
+    nodeA.children[deeper] = moved;
+    nodeMoved.parent = a;
+
+    nodeA.bounds = nodeC.bounds.merged(nodeMoved.bounds);
+    nodeA.height = 1 + std::max(nodeC.height, nodeMoved.height);
+    nodeB.bounds = nodeA.bounds.merged(nodeKept.bounds);
+    nodeB.height = 1 + std::max(nodeA.height, nodeKept.height);
+
+    return b;
+}
+
+void AabbTree::queryFrustum(const Frustum &frustum, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    if (_root == NULL_NODE)
+        return;
+
+    int stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = _root;
+    while (size > 0)
+    {
+        const Node &node = _nodes[stack[--size]];
+        if (!frustum.intersects(node.bounds))
+            continue;
+
+        if (node.isLeaf())
+            proxies.push_back(&node - _nodes.data());
+        else
+        {
+            stack[size++] = node.children[0];
+            stack[size++] = node.children[1];
+        }
+    }
+}
+
+void AabbTree::querySphere(const glm::vec3 &center, float radius, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    if (_root == NULL_NODE)
+        return;
+
+    int stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = _root;
+    while (size > 0)
+    {
+        const Node &node = _nodes[stack[--size]];
+        if (node.bounds.distanceSquared(center) > radius * radius)
+            continue;
+
+        if (node.isLeaf())
+            proxies.push_back(&node - _nodes.data());
+        else
+        {
+            stack[size++] = node.children[0];
+            stack[size++] = node.children[1];
+        }
+    }
+}
+
+void AabbTree::findNearest(const glm::vec3 &point, int count, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    if (_root == NULL_NODE || count <= 0)
+        return;
+
+    // Max heap of the best found so far, kept per thread so repeated queries do not allocate
+    thread_local std::vector<std::pair<float, int>> nearest;
+    nearest.clear();
+
+    int stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = _root;
+    while (size > 0)
+    {
+        int index = stack[--size];
+        const Node &node = _nodes[index];
+        float distance = node.bounds.distanceSquared(point);
+        if ((int)nearest.size() == count && distance >= nearest.front().first)
+            continue;
+
+        if (node.isLeaf())
+        {
+            nearest.push_back({distance, index});
+            std::push_heap(nearest.begin(), nearest.end());
+            if ((int)nearest.size() > count)
+            {
+                std::pop_heap(nearest.begin(), nearest.end());
+                nearest.pop_back();
+            }
+            continue;
+        }
+
+        // Nearer child on top
+        int left = node.children[0];
+        int right = node.children[1];
+        if (_nodes[left].bounds.distanceSquared(point) < _nodes[right].bounds.distanceSquared(point))
+            std::swap(left, right);
+        stack[size++] = left;
+        stack[size++] = right;
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end());
+    for (const std::pair<float, int> &entry : nearest)
+        proxies.push_back(entry.second);
+}
+
+RayHit AabbTree::raycast(const Ray &ray, float maxDistance, const RayTest &test) const
+{
+    RayHit hit;
+    if (_root == NULL_NODE)
+        return hit;
+
+    float closest = maxDistance;
+    int stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = _root;
+    while (size > 0)
+    {
+        int index = stack[--size];
+        const Node &node = _nodes[index];
+        float distance;
+        if (!ray.intersects(node.bounds, closest, distance))
+            continue;
+
+        if (node.isLeaf())
+        {
+            float hitDistance = test ? test(index, distance) : distance;
+            if (hitDistance >= 0.0f && hitDistance <= closest)
+            {
+                closest = hitDistance;
+                hit = {index, hitDistance};
+            }
+            continue;
+        }
+
+        // Nearer child on top, its hits clip the ray before the other is tested
+        float distances[2];
+        bool hits[2];
+        for (int i = 0; i < 2; i++)
+            hits[i] = ray.intersects(_nodes[node.children[i]].bounds, closest, distances[i]);
+
+        int nearer = hits[1] && (!hits[0] || distances[1] < distances[0]) ? 1 : 0;
+        if (hits[1 - nearer])
+            stack[size++] = node.children[1 - nearer];
+        if (hits[nearer])
+            stack[size++] = node.children[nearer];
+    }
+
+    return hit;
+}
+
+void AabbTree::raycast(const Ray *rays, int count, float maxDistance, RayHit *hits) const
+{
+    for (int first = 0; first < count; first += PACKET_SIZE)
+        raycastPacket(rays + first, std::min(count - first, PACKET_SIZE), maxDistance, hits + first);
+}
+
+void AabbTree::raycastPacket(const Ray *rays, int count, float maxDistance, RayHit *hits) const
+{
+    for (int i = 0; i < count; i++)
+        hits[i] = RayHit();
+    if (_root == NULL_NODE)
+        return;
+
+#if defined(AABB_TREE_SSE)
+    // One lane per ray, unused lanes can never hit anything closer than -1
+    alignas(16) float origins[3][PACKET_SIZE] = {};
+    alignas(16) float inverses[3][PACKET_SIZE] = {};
+    alignas(16) float closest[PACKET_SIZE];
+    for (int i = 0; i < PACKET_SIZE; i++)
+    {
+        closest[i] = i < count ? maxDistance : -1.0f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            origins[axis][i] = i < count ? rays[i].origin[axis] : 0.0f;
+            inverses[axis][i] = i < count ? 1.0f / rays[i].direction[axis] : 1.0f;
+        }
+    }
+
+    __m128 origin[3];
+    __m128 inverse[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        origin[axis] = _mm_load_ps(origins[axis]);
+        inverse[axis] = _mm_load_ps(inverses[axis]);
+    }
+    __m128 limit = _mm_load_ps(closest);
+    __m128 zero = _mm_setzero_ps();
+
+    // Children are visited nearer first along the packet's mean direction
+    glm::vec3 direction = glm::vec3(0.0f);
+    for (int i = 0; i < count; i++)
+        direction += rays[i].direction;
+
+    int stack[STACK_SIZE];
+    int size = 0;
+    stack[size++] = _root;
+    while (size > 0)
+    {
+        int index = stack[--size];
+        const Node &node = _nodes[index];
+
+        __m128 enter = zero;
+        __m128 exit = limit;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.min[axis]), origin[axis]), inverse[axis]);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds.max[axis]), origin[axis]), inverse[axis]);
+            enter = _mm_max_ps(enter, _mm_min_ps(t1, t2));
+            exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+        }
+
+        int mask = _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+        if (mask == 0)
+            continue;
+
+        if (!node.isLeaf())
+        {
+            const AABB &first = _nodes[node.children[0]].bounds;
+            const AABB &second = _nodes[node.children[1]].bounds;
+            int nearer = glm::dot(second.min + second.max - first.min - first.max, direction) < 0.0f ? 1 : 0;
+            stack[size++] = node.children[1 - nearer];
+            stack[size++] = node.children[nearer];
+            continue;
+        }
+
+        alignas(16) float distances[PACKET_SIZE];
+        _mm_store_ps(distances, enter);
+        for (int i = 0; i < count; i++)
+        {
+            if (!(mask & (1 << i)))
+                continue;
+
+            closest[i] = distances[i];
+            hits[i] = {index, distances[i]};
+        }
+        limit = _mm_load_ps(closest);
+    }
+#else
+    for (int i = 0; i < count; i++)
+        hits[i] = raycast(rays[i], maxDistance);
+#endif
+}
+
+void AabbTree::imguiDraw()
+{
+    ImGui::Text("Proxies: %d, nodes: %d, height: %d", _proxyCount, (int)_nodes.size(), getHeight());
+    ImGui::Text("Reinserted: %d", _reinserted);
+    _reinserted = 0;
+}
@@ -0,0 +1,176 @@
+#include <engine/allocationTracker.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Everything here is constant initialized, operator new may run before any constructor
+static std::atomic<const char *> scopeNames[AllocationTracker::MAX_SCOPES] = {"Outside scopes"};
+static std::atomic<uint64_t> counts[AllocationTracker::MAX_SCOPES];
+static std::atomic<uint64_t> bytes[AllocationTracker::MAX_SCOPES];
+static std::atomic<uint64_t> frameCounts[AllocationTracker::MAX_SCOPES];
+static std::atomic<uint64_t> frameBytes[AllocationTracker::MAX_SCOPES];
+
+// Deeper scopes are counted in the deepest one kept
+static constexpr int MAX_DEPTH = 32;
+static thread_local int scopeStack[MAX_DEPTH];
+static thread_local int scopeDepth = 0;
+
+static int findScope(const char *name)
+{
+    for (int i = 1; i < AllocationTracker::MAX_SCOPES; i++)
+    {
+        const char *current = scopeNames[i].load(std::memory_order_acquire);
+        if (current == name || (current && std::strcmp(current, name) == 0))
+            return i;
+
+        // Claim the first free slot, another thread may take it first with a different name
+        if (!current && scopeNames[i].compare_exchange_strong(current, name, std::memory_order_acq_rel))
+            return i;
+        if (current && std::strcmp(current, name) == 0)
+            return i;
+    }
+
+    return 0;
+}
+
+bool AllocationTracker::isEnabled()
+{
+#ifdef ENGINE_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationTracker::beginScope(const char *name)
+{
+    if (scopeDepth < MAX_DEPTH)
+        scopeStack[scopeDepth] = findScope(name);
+    scopeDepth++;
+}
+
+void AllocationTracker::endScope()
+{
+    if (scopeDepth > 0)
+        scopeDepth--;
+}
+
+void AllocationTracker::endFrame()
+{
+    for (int i = 0; i < MAX_SCOPES; i++)
+    {
+        frameCounts[i].store(counts[i].exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        frameBytes[i].store(bytes[i].exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+void AllocationTracker::getFrameStats(std::vector<Stats> &stats)
+{
+    stats.clear();
+    for (int i = 0; i < MAX_SCOPES; i++)
+    {
+        uint64_t count = frameCounts[i].load(std::memory_order_relaxed);
+        if (count > 0)
+            stats.push_back({scopeNames[i].load(std::memory_order_acquire), count, frameBytes[i].load(std::memory_order_relaxed)});
+    }
+}
+
+uint64_t AllocationTracker::getFrameCount()
+{
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_SCOPES; i++)
+        total += frameCounts[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t AllocationTracker::getFrameBytes()
+{
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_SCOPES; i++)
+        total += frameBytes[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+void AllocationTracker::record(size_t size)
+{
+    int scope = scopeDepth == 0 ? 0 : scopeStack[(scopeDepth < MAX_DEPTH ? scopeDepth : MAX_DEPTH) - 1];
+    counts[scope].fetch_add(1, std::memory_order_relaxed);
+    bytes[scope].fetch_add(size, std::memory_order_relaxed);
+}
+
+#ifdef ENGINE_TRACK_ALLOCATIONS
+
+static void *allocate(size_t size)
+{
+    AllocationTracker::record(size);
+    return std::malloc(size ? size : 1);
+}
+
+static void *allocateAligned(size_t size, std::align_val_t alignment)
+{
+    AllocationTracker::record(size);
+    size_t align = (size_t)alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+}
+
+static void freeAligned(void *pointer)
+{
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void *operator new(size_t size)
+{
+    if (void *pointer = allocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    if (void *pointer = allocateAligned(size, alignment))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocateAligned(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocateAligned(size, alignment); }
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { freeAligned(pointer); }
+
+#endif
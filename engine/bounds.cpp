@@ -0,0 +1,157 @@
+#include <engine/bounds.h>
+
+#include <algorithm>
+#include <cmath>
+
+glm::vec3 AABB::getCenter() const
+{
+    return (min + max) * 0.5f;
+}
+
+glm::vec3 AABB::getExtents() const
+{
+    return (max - min) * 0.5f;
+}
+
+float AABB::getPerimeter() const
+{
+    glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool AABB::contains(const AABB &box) const
+{
+    return glm::all(glm::lessThanEqual(min, box.min)) && glm::all(glm::lessThanEqual(box.max, max));
+}
+
+bool AABB::overlaps(const AABB &box) const
+{
+    return glm::all(glm::lessThanEqual(min, box.max)) && glm::all(glm::lessThanEqual(box.min, max));
+}
+
+AABB AABB::merged(const AABB &box) const
+{
+    return {glm::min(min, box.min), glm::max(max, box.max)};
+}
+
+float AABB::distanceSquared(const glm::vec3 &point) const
+{
+    glm::vec3 outside = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+AABB AABB::transformed(const glm::mat4 &matrix) const
+{
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+    glm::vec3 extents = getExtents();
+
+    glm::vec3 newExtents = glm::abs(glm::vec3(matrix[0])) * extents.x +
+                           glm::abs(glm::vec3(matrix[1])) * extents.y +
+                           glm::abs(glm::vec3(matrix[2])) * extents.z;
+
+    return {center - newExtents, center + newExtents};
+}
+
+glm::vec3 Ray::at(float distance) const
+{
+    return origin + direction * distance;
+}
+
+bool Ray::intersects(const AABB &box, float maxDistance, float &distance) const
+{
+    // Slabs, infinite inverses keep axis aligned rays right
+    glm::vec3 inverse = 1.0f / direction;
+    glm::vec3 t1 = (box.min - origin) * inverse;
+    glm::vec3 t2 = (box.max - origin) * inverse;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+    if (enter > exit)
+        return false;
+
+    distance = enter;
+    return true;
+}
+
+bool Ray::intersects(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float maxDistance, float &distance) const
+{
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::abs(determinant) < 1e-8f)
+        return false;
+
+    float inverse = 1.0f / determinant;
+    glm::vec3 toOrigin = origin - a;
+    float u = glm::dot(toOrigin, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    glm::vec3 q = glm::cross(toOrigin, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    float t = glm::dot(edge2, q) * inverse;
+    if (t < 0.0f || t > maxDistance)
+        return false;
+
+    distance = t;
+    return true;
+}
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+    // Gribb and Hartmann, rows of the matrix combined per plane
+    glm::mat4 m = glm::transpose(viewProjection);
+
+    planes[LEFT_PLANE] = m[3] + m[0];
+    planes[RIGHT_PLANE] = m[3] - m[0];
+    planes[BOTTOM_PLANE] = m[3] + m[1];
+    planes[TOP_PLANE] = m[3] - m[1];
+    planes[NEAR_PLANE] = m[3] + m[2];
+    planes[FAR_PLANE] = m[3] - m[2];
+}
+
+bool Frustum::intersects(const AABB &box, bool ignoreNear) const
+{
+    glm::vec3 center = box.getCenter();
+    glm::vec3 extents = box.getExtents();
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (ignoreNear && i == NEAR_PLANE)
+            continue;
+
+        const glm::vec4 &plane = planes[i];
+        float radius = glm::dot(extents, glm::abs(glm::vec3(plane)));
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+AABB Frustum::getBounds() const
+{
+    AABB bounds = {glm::vec3(INFINITY), glm::vec3(-INFINITY)};
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const glm::vec4 &a = planes[corner & 1 ? RIGHT_PLANE : LEFT_PLANE];
+        const glm::vec4 &b = planes[corner & 2 ? TOP_PLANE : BOTTOM_PLANE];
+        const glm::vec4 &c = planes[corner & 4 ? FAR_PLANE : NEAR_PLANE];
+
+        // Where n . x + w = 0 for all three
+        glm::vec3 na = glm::vec3(a), nb = glm::vec3(b), nc = glm::vec3(c);
+        glm::vec3 bc = glm::cross(nb, nc);
+        glm::vec3 point = -(a.w * bc + b.w * glm::cross(nc, na) + c.w * glm::cross(na, nb)) / glm::dot(na, bc);
+
+        bounds.min = glm::min(bounds.min, point);
+        bounds.max = glm::max(bounds.max, point);
+    }
+
+    return bounds;
+}
@@ -40,7 +40,21 @@ glm::mat4 Camera::getProjectionMatrix() const
     return projection;
 }
 
-void Camera::setUniforms(Shader &shader) const
+Ray Camera::getScreenRay(const glm::vec2 &position) const
+{
+    const glm::vec2 &screenSize = getGame().getScreenSize();
+    glm::vec2 ndc = glm::vec2(position.x / screenSize.x * 2.0f - 1.0f, 1.0f - position.y / screenSize.y * 2.0f);
+
+    glm::mat4 inverse = glm::inverse(getProjectionMatrix() * getViewMatrix());
+    glm::vec4 start = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 end = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+    start /= start.w;
+    end /= end.w;
+
+    return {glm::vec3(start), glm::normalize(glm::vec3(end - start))};
+}
+
+void Camera::setUniforms(const Shader &shader) const
 {
     shader.setUniform("view", getViewMatrix());
     shader.setUniform("viewPos", transform.position);
@@ -0,0 +1,62 @@
+#include <engine/frameArena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+FrameArena::FrameArena(size_t capacity) : _memory(std::make_unique<std::byte[]>(capacity)), _capacity(capacity)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    for (const OverflowBlock &block : _overflowBlocks)
+        ::operator delete(block.memory, std::align_val_t(block.alignment));
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+    // Worst case padding is reserved with the size so a single atomic add claims the range
+    size_t claimed = size + alignment - 1;
+    size_t begin = _used.fetch_add(claimed, std::memory_order_relaxed);
+    if (begin + claimed <= _capacity)
+    {
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(_memory.get() + begin);
+        address = (address + alignment - 1) / alignment * alignment;
+        return reinterpret_cast<void *>(address);
+    }
+
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    void *memory = ::operator new(size, std::align_val_t(alignment));
+
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    _overflowBlocks.push_back({memory, alignment});
+    _overflow += claimed;
+    return memory;
+}
+
+void FrameArena::reset()
+{
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    for (const OverflowBlock &block : _overflowBlocks)
+        ::operator delete(block.memory, std::align_val_t(block.alignment));
+    _overflowBlocks.clear();
+
+    // Some headroom so a slowly growing frame does not reallocate every time
+    if (_overflow > 0)
+    {
+        _capacity = (_capacity + _overflow) * 3 / 2;
+        _memory = std::make_unique<std::byte[]>(_capacity);
+        _overflow = 0;
+    }
+
+    _used = 0;
+}
+
+size_t FrameArena::getUsed() const { return std::min(_used.load(), _capacity); }
+size_t FrameArena::getCapacity() const { return _capacity; }
+size_t FrameArena::getOverflow() const
+{
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    return _overflow;
+}
@@ -0,0 +1,372 @@
+#include <engine/frameCapture.h>
+#include <engine/profiler.h>
+#include <engine/resourceTracker.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <zlib.h>
+#include "imgui.h"
+
+static float millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void writeBigEndian(std::FILE *file, uint32_t value)
+{
+    const unsigned char bytes[] = {(unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value};
+    std::fwrite(bytes, 1, 4, file);
+}
+
+static void writePngChunk(std::FILE *file, const char *type, const unsigned char *data, uint32_t size)
+{
+    // A null buffer would reset the CRC
+    uLong crc = crc32(0, (const Bytef *)type, 4);
+    if (size > 0)
+        crc = crc32(crc, data, size);
+
+    writeBigEndian(file, size);
+    std::fwrite(type, 1, 4, file);
+    if (size > 0)
+        std::fwrite(data, 1, size, file);
+    writeBigEndian(file, crc);
+}
+
+FrameCapture::FrameCapture(Profiler &profiler, CaptureFormat format, const std::string &path, int frameRate, int encoderCount,
+                           int maxQueuedFrames)
+    : _profiler(profiler), _format(format), _path(path), _frameRate(frameRate)
+{
+    for (Readback &readback : _readbacks)
+        glGenBuffers(1, &readback.buffer);
+
+    if (format == CaptureFormat::CAPTURE_PNG)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(path, error);
+        if (error)
+            std::cout << "ERROR::FRAME_CAPTURE::DIRECTORY_NOT_CREATED " << path << std::endl;
+    }
+
+    for (int i = 0; i < std::max(maxQueuedFrames, 1); i++)
+    {
+        _frames.push_back(std::make_unique<Frame>());
+        _freeFrames.push_back(_frames.back().get());
+    }
+
+    for (int i = 0; i < std::max(encoderCount, 1); i++)
+        _encoders.emplace_back(&FrameCapture::encoderLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    keepEveryFrame = true;
+    collect(true);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _queued.notify_all();
+    for (std::thread &encoder : _encoders)
+        encoder.join();
+
+    if (_stream)
+        std::fclose(_stream);
+
+    for (Readback &readback : _readbacks)
+    {
+        ResourceTracker::release(RESOURCE_GL_BUFFER, readback.buffer);
+        glDeleteBuffers(1, &readback.buffer);
+    }
+}
+
+void FrameCapture::capture(const glm::ivec2 &size)
+{
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    _profiler.beginCpu("Frame capture");
+
+    collect(false);
+
+    Readback &readback = _readbacks[_next];
+    int frame = _frame++;
+    if (readback.fence && !keepEveryFrame)
+    {
+        // Every buffer still waits on the GPU, reading more would only queue behind them
+        _dropped++;
+    }
+    else
+    {
+        if (readback.fence)
+            retire(readback);
+
+        GLsizeiptr bytes = (GLsizeiptr)size.x * size.y * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        if (readback.capacity < bytes)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            readback.capacity = bytes;
+            ResourceTracker::track(RESOURCE_GL_BUFFER, readback.buffer, RESOURCE_BUFFER, "Frame capture", bytes);
+        }
+
+        // Only queues the copy, the fence tells when the buffer holds it
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.size = size;
+        readback.frame = frame;
+        _next = (_next + 1) % READBACK_BUFFERS;
+    }
+
+    _profiler.endCpu();
+    _overhead = _overhead * 0.95f + millisecondsSince(start) * 0.05f;
+}
+
+void FrameCapture::collect(bool wait)
+{
+    for (int i = 0; i < READBACK_BUFFERS; i++)
+    {
+        Readback &readback = _readbacks[(_next + i) % READBACK_BUFFERS];
+        if (!readback.fence)
+            continue;
+        if (!wait && glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+
+        retire(readback);
+    }
+}
+
+void FrameCapture::retire(Readback &readback)
+{
+    while (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    Frame *frame = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (keepEveryFrame)
+            _room.wait(lock, [this]
+                       { return !_freeFrames.empty(); });
+        if (!_freeFrames.empty())
+        {
+            frame = _freeFrames.back();
+            _freeFrames.pop_back();
+        }
+    }
+
+    // The encoders are behind, the memory they may hold is bounded
+    if (!frame)
+    {
+        _dropped++;
+        return;
+    }
+
+    GLsizeiptr bytes = (GLsizeiptr)readback.size.x * readback.size.y * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const unsigned char *pixels = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        frame->pixels.assign(pixels, pixels + bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!pixels)
+    {
+        std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED" << std::endl;
+        _freeFrames.push_back(frame);
+        _dropped++;
+        return;
+    }
+
+    frame->size = readback.size;
+    frame->frame = readback.frame;
+    frame->sequence = _sequence++;
+    _queue.push_back(frame);
+    _captured++;
+    _queued.notify_one();
+}
+
+void FrameCapture::encoderLoop()
+{
+    while (true)
+    {
+        Frame *frame;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queued.wait(lock, [this]
+                         { return _quit || !_queue.empty(); });
+            if (_queue.empty())
+                return;
+
+            frame = _queue.front();
+            _queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool written = _format == CaptureFormat::CAPTURE_PNG ? writePng(*frame) : writeY4m(*frame);
+        if (!written)
+            _dropped++;
+        _encodeTime = _encodeTime * 0.95f + millisecondsSince(start) * 0.05f;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _freeFrames.push_back(frame);
+        }
+        _room.notify_one();
+    }
+}
+
+bool FrameCapture::writePng(Frame &frame)
+{
+    int width = frame.size.x;
+    int height = frame.size.y;
+    size_t rowSize = 1 + (size_t)width * 3;
+
+    // Top down RGB rows, each with the Up filter so flat areas compress to almost nothing
+    frame.converted.resize(rowSize * height);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *row = &frame.pixels[(size_t)(height - 1 - y) * width * 4];
+        const unsigned char *above = y > 0 ? &frame.pixels[(size_t)(height - y) * width * 4] : nullptr;
+        unsigned char *out = &frame.converted[y * rowSize];
+        *out++ = 2;
+        for (int x = 0; x < width; x++)
+            for (int channel = 0; channel < 3; channel++)
+                *out++ = row[x * 4 + channel] - (above ? above[x * 4 + channel] : 0);
+    }
+
+    uLongf compressedSize = compressBound(frame.converted.size());
+    frame.compressed.resize(compressedSize);
+    if (compress2(frame.compressed.data(), &compressedSize, frame.converted.data(), frame.converted.size(), Z_BEST_SPEED) != Z_OK)
+    {
+        std::cout << "ERROR::FRAME_CAPTURE::COMPRESSION_FAILED" << std::endl;
+        return false;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%06d.png", frame.frame);
+    std::FILE *file = std::fopen((_path + name).c_str(), "wb");
+    if (!file)
+    {
+        std::cout << "ERROR::FRAME_CAPTURE::FILE_NOT_OPENED " << _path << name << std::endl;
+        return false;
+    }
+
+    const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    // Width, height, 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+    const unsigned char header[] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        8, 2, 0, 0, 0};
+
+    std::fwrite(signature, 1, sizeof(signature), file);
+    writePngChunk(file, "IHDR", header, sizeof(header));
+    writePngChunk(file, "IDAT", frame.compressed.data(), compressedSize);
+    writePngChunk(file, "IEND", nullptr, 0);
+
+    bool written = !std::ferror(file);
+    std::fclose(file);
+    return written;
+}
+
+bool FrameCapture::writeY4m(Frame &frame)
+{
+    int width = frame.size.x;
+    int height = frame.size.y;
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+
+    // BT.601 full range, chroma averaged over each 2x2 block
+    frame.converted.resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+    unsigned char *luma = frame.converted.data();
+    unsigned char *blue = luma + (size_t)width * height;
+    unsigned char *red = blue + (size_t)chromaWidth * chromaHeight;
+    auto pixel = [&](int x, int y)
+    { return &frame.pixels[((size_t)(height - 1 - y) * width + x) * 4]; };
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            const unsigned char *rgb = pixel(x, y);
+            luma[y * width + x] = (77 * rgb[0] + 150 * rgb[1] + 29 * rgb[2] + 128) >> 8;
+        }
+
+    for (int y = 0; y < chromaHeight; y++)
+        for (int x = 0; x < chromaWidth; x++)
+        {
+            int r = 0, g = 0, b = 0, count = 0;
+            for (int dy = 0; dy < 2 && y * 2 + dy < height; dy++)
+                for (int dx = 0; dx < 2 && x * 2 + dx < width; dx++)
+                {
+                    const unsigned char *rgb = pixel(x * 2 + dx, y * 2 + dy);
+                    r += rgb[0];
+                    g += rgb[1];
+                    b += rgb[2];
+                    count++;
+                }
+            r /= count;
+            g /= count;
+            b /= count;
+
+            blue[y * chromaWidth + x] = std::clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255);
+            red[y * chromaWidth + x] = std::clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255);
+        }
+
+    // Frames go out in the order they were handed over, whichever encoder finishes first
+    std::unique_lock<std::mutex> lock(_streamMutex);
+    _written.wait(lock, [&]
+                  { return _nextWrite == frame.sequence; });
+    _nextWrite++;
+
+    bool written = false;
+    if (!_stream)
+    {
+        _stream = std::fopen(_path.c_str(), "wb");
+        _streamSize = frame.size;
+        if (_stream)
+            std::fprintf(_stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, _frameRate);
+        else
+            std::cout << "ERROR::FRAME_CAPTURE::FILE_NOT_OPENED " << _path << std::endl;
+    }
+
+    // A stream has one size, frames after a resize are left out
+    if (_stream && frame.size == _streamSize)
+    {
+        std::fputs("FRAME\n", _stream);
+        std::fwrite(frame.converted.data(), 1, frame.converted.size(), _stream);
+        written = !std::ferror(_stream);
+    }
+
+    lock.unlock();
+    _written.notify_all();
+    return written;
+}
+
+int FrameCapture::getCapturedCount() const { return _captured; }
+int FrameCapture::getDroppedCount() const { return _dropped; }
+
+void FrameCapture::imguiDraw()
+{
+    int queued;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        queued = _queue.size();
+    }
+
+    ImGui::Text("Format: %s, %s", _format == CaptureFormat::CAPTURE_PNG ? "PNG" : "Y4M", _path.c_str());
+    ImGui::Text("Captured: %d, dropped: %d, queued: %d / %d", _captured.load(), _dropped.load(), queued, (int)_frames.size());
+    ImGui::Text("Overhead: %.3f ms per frame, encoding %.1f ms per frame", _overhead, _encodeTime.load());
+}
@@ -0,0 +1,106 @@
+#include <engine/framePacer.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+// Left to spin at the end of a wait, more than the usual sleep overshoot
+static constexpr std::chrono::microseconds SPIN_TIME(2000);
+
+void FramePacer::wait()
+{
+    if (frameLimit <= 0)
+        return;
+
+    Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameLimit));
+    Clock::time_point now = Clock::now();
+
+    // More than a frame late, start over from now instead of rushing the next frames to catch up
+    if (_nextFrame + period < now)
+        _nextFrame = now;
+
+    if (_nextFrame - now > SPIN_TIME)
+        std::this_thread::sleep_for(_nextFrame - now - SPIN_TIME);
+    while (Clock::now() < _nextFrame)
+        std::this_thread::yield();
+
+    _nextFrame += period;
+}
+
+void FramePacer::beginFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (_lastFrame == Clock::time_point())
+    {
+        _lastFrame = now;
+        return;
+    }
+
+    _rawDeltaTime = std::chrono::duration<float>(now - _lastFrame).count();
+    _lastFrame = now;
+
+    _history[_frames % HISTORY] = _rawDeltaTime * 1000.0f;
+    _recent[_frames % SMOOTHING] = std::min(_rawDeltaTime, MAX_DELTA_TIME);
+    _frames++;
+
+    int count = std::min<unsigned long long>(_frames, SMOOTHING);
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++)
+        sum += _recent[i];
+    _smoothedDeltaTime = sum / count;
+}
+
+float FramePacer::getDeltaTime() const
+{
+    return smoothDeltaTime ? _smoothedDeltaTime : std::min(_rawDeltaTime, MAX_DELTA_TIME);
+}
+
+float FramePacer::getRawDeltaTime() const { return _rawDeltaTime; }
+
+void FramePacer::imguiDraw()
+{
+    int count = std::min<unsigned long long>(_frames, HISTORY);
+    if (count == 0)
+        return;
+
+    float sorted[HISTORY];
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        sorted[i] = _history[i];
+        sum += _history[i];
+    }
+    float mean = sum / count;
+
+    float variance = 0.0f;
+    float bins[BINS] = {};
+    for (int i = 0; i < count; i++)
+    {
+        float deviation = _history[i] - mean;
+        variance += deviation * deviation;
+
+        int bin = (int)std::floor(deviation / BIN_MILLISECONDS) + BINS / 2;
+        bins[std::clamp(bin, 0, BINS - 1)] += 1.0f;
+    }
+    float deviation = std::sqrt(variance / count);
+
+    float *p99 = sorted + std::min(count - 1, count * 99 / 100);
+    std::nth_element(sorted, p99, sorted + count);
+    auto [shortest, longest] = std::minmax_element(_history, _history + count);
+
+    ImGui::Text("Frame time: %.2f ms, %.2f std dev", mean, deviation);
+    ImGui::Text("Min %.2f, max %.2f, 99th %.2f ms", *shortest, *longest, *p99);
+    ImGui::Text("Delta time: %.2f ms%s", getDeltaTime() * 1000.0f, smoothDeltaTime ? " (smoothed)" : "");
+
+    // Oldest first once the ring has wrapped
+    int offset = _frames > HISTORY ? _frames % HISTORY : 0;
+    ImGui::PlotLines("##Frame times", _history, count, offset, nullptr, 0.0f, *longest, ImVec2(0.0f, 50.0f));
+
+    char overlay[48];
+    std::snprintf(overlay, sizeof(overlay), "+-%.1f ms around the mean", BIN_MILLISECONDS * BINS / 2);
+    ImGui::PlotHistogram("##Frame time deviation", bins, BINS, 0, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 50.0f));
+}
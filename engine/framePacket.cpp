@@ -0,0 +1,89 @@
+#include <engine/framePacket.h>
+
+#include <cstring>
+
+template <typename T>
+static void copyVector(ImVector<T> &destination, const ImVector<T> &source)
+{
+    destination.resize(source.Size);
+    if (source.Size > 0)
+        std::memcpy(destination.Data, source.Data, source.size_in_bytes());
+}
+
+FramePacket::~FramePacket()
+{
+    for (ImDrawList *list : _imguiLists)
+        IM_DELETE(list);
+}
+
+void FramePacket::copyLights(const std::vector<Light *> &source)
+{
+    _directionalLights.clear();
+    _pointLights.clear();
+    _spotLights.clear();
+
+    // Spot lights are point lights too, test them first
+    for (Light *light : source)
+    {
+        if (SpotLight *spot = dynamic_cast<SpotLight *>(light))
+            _spotLights.push_back(*spot);
+        else if (PointLight *point = dynamic_cast<PointLight *>(light))
+            _pointLights.push_back(*point);
+        else if (DirectionalLight *directional = dynamic_cast<DirectionalLight *>(light))
+            _directionalLights.push_back(*directional);
+    }
+
+    // Pointers once the vectors stopped growing
+    lights.clear();
+    int directionalIndex = 0;
+    int pointIndex = 0;
+    int spotIndex = 0;
+    for (Light *light : source)
+    {
+        if (dynamic_cast<SpotLight *>(light))
+            lights.push_back(&_spotLights[spotIndex++]);
+        else if (dynamic_cast<PointLight *>(light))
+            lights.push_back(&_pointLights[pointIndex++]);
+        else if (dynamic_cast<DirectionalLight *>(light))
+            lights.push_back(&_directionalLights[directionalIndex++]);
+    }
+}
+
+void FramePacket::copyImGuiData(const ImDrawData &data)
+{
+    while (_imguiLists.size() < data.CmdLists.Size)
+        _imguiLists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+    // Field by field, assigning ImDrawData would reallocate its list array
+    imguiData.Valid = data.Valid;
+    imguiData.CmdListsCount = data.CmdListsCount;
+    imguiData.TotalIdxCount = data.TotalIdxCount;
+    imguiData.TotalVtxCount = data.TotalVtxCount;
+    imguiData.DisplayPos = data.DisplayPos;
+    imguiData.DisplaySize = data.DisplaySize;
+    imguiData.FramebufferScale = data.FramebufferScale;
+    imguiData.OwnerViewport = data.OwnerViewport;
+
+    imguiData.CmdLists.resize(data.CmdLists.Size);
+    for (int i = 0; i < data.CmdLists.Size; i++)
+    {
+        const ImDrawList *source = data.CmdLists[i];
+        ImDrawList *list = _imguiLists[i];
+
+        copyVector(list->CmdBuffer, source->CmdBuffer);
+        copyVector(list->IdxBuffer, source->IdxBuffer);
+        copyVector(list->VtxBuffer, source->VtxBuffer);
+        list->Flags = source->Flags;
+
+        imguiData.CmdLists[i] = list;
+    }
+}
+
+void FramePacket::clearImGuiData()
+{
+    imguiData.Valid = false;
+    imguiData.CmdListsCount = 0;
+    imguiData.TotalIdxCount = 0;
+    imguiData.TotalVtxCount = 0;
+    imguiData.CmdLists.resize(0);
+}
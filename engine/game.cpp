@@ -1,19 +1,46 @@
 #include <engine/game.h>
 #include <engine/object.h>
+#include <engine/materialRegistry.h>
+#include <engine/camera.h>
+#include <engine/profiler.h>
+#include <engine/jobSystem.h>
+#include <engine/light.h>
+#include <engine/framePacket.h>
+#include <engine/renderThread.h>
+#include <engine/allocationTracker.h>
+#include <engine/aabbTree.h>
+#include <engine/hashGrid.h>
+#include <engine/resourceTracker.h>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
-Game::Game()
+// Objects per update job, enough to hide the cost of queueing it
+static constexpr int UPDATE_CHUNK_SIZE = 1024;
+// Pick ids hold the slot index in the low bits and the low bits of its generation above them
+static constexpr int PICK_INDEX_BITS = 20;
+// Frames allowed to allocate while containers grow to their steady state size
+static constexpr int ALLOCATION_WARMUP_FRAMES = 120;
+
+Game::Game(const GameSettings &settings)
 {
+    // Before anything is loaded, to count it
+    if (!settings.metricsAddress.empty() || !settings.metricsLogPath.empty())
+        _metrics = std::make_unique<MetricsExporter>(settings.metricsAddress, settings.metricsLogPath);
+    _metricsLogInterval = settings.metricsLogInterval;
+
     // Initialize glfw
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (settings.headless)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // Create window
     _window = glfwCreateWindow(_screenSize.x, _screenSize.y, "LearnOpenGL", NULL, NULL);
@@ -33,7 +60,6 @@ Game::Game()
 
     glViewport(0, 0, _screenSize.x, _screenSize.y);
     glfwSetFramebufferSizeCallback(_window, framebufferSizeCallback);
-    glfwWindowHint(GLFW_SAMPLES, 4);
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
@@ -41,7 +67,7 @@ Game::Game()
     glEnable(GL_DEPTH_TEST);
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 
-    glEnable(GL_BLEND);
+    // Blending is turned on by the renderer for the passes that need it
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // Setup Dear ImGui context
@@ -54,11 +80,14 @@ Game::Game()
 
     io.IniFilename = nullptr;
 
+    _input = std::make_unique<InputSystem>(_window, settings.rawMouseMotion);
     registerCallbacks();
 
     // Setup Platform/Renderer backends
     ImGui_ImplGlfw_InitForOpenGL(_window, true); // Second param install_callback=true will install GLFW callbacks and chain to existing ones.
     ImGui_ImplOpenGL3_Init();
+    // Creates the font texture while the context is current here, ImGui frames may then be built on any thread
+    ImGui_ImplOpenGL3_NewFrame();
 
     glClearColor(0.1f, 0.2f, 0.4f, 1.0f);
 
@@ -79,6 +108,8 @@ Game::Game()
                  GL_RGBA,          // data format
                  GL_UNSIGNED_BYTE, // data type
                  whitePixel);
+    ResourceTracker::track(RESOURCE_GL_TEXTURE, _whiteTexture, RESOURCE_TEXTURE, "Fallback texture",
+                           ResourceTracker::getTextureBytes(GL_RGBA, 1, 1));
 
     // Texture parameters (same as normal textures)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -86,25 +117,107 @@ Game::Game()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
+    _materials = std::make_unique<MaterialRegistry>(_whiteTexture);
+    _profiler = std::make_unique<Profiler>();
+    _jobs = std::make_unique<JobSystem>(settings.threadCount);
+    _renderer = std::make_unique<Renderer>(settings.renderPath, *_materials, *_profiler, *_jobs, _screenSize);
+    _renderer->depthPrePass = settings.depthPrePass;
+    _renderer->transparencyMode = settings.transparencyMode;
+    _renderer->occlusionCulling = settings.occlusionCulling;
+    _renderer->softwareOcclusion = settings.softwareOcclusion;
+    _renderer->gpuCulling = settings.gpuCulling;
+    _renderer->upscaleSharpness = settings.upscaleSharpness;
+    _renderer->antiAliasing = settings.antiAliasing;
+    _renderer->msaaSamples = settings.msaaSamples;
+    _renderer->getResolution().enabled = settings.dynamicResolution;
+    _renderer->getResolution().targetMilliseconds = settings.resolutionTarget;
+    _renderer->getResolution().minScale = settings.minResolutionScale;
+    _renderer->getResolution().maxScale = std::max(settings.maxResolutionScale, settings.minResolutionScale);
+    _renderer->getPicker().synchronous = settings.syncPicking;
+    _gpuPicking = settings.gpuPicking;
+
+    if (settings.spatialIndex == SpatialIndexType::HASH_GRID)
+        _spatialIndex = std::make_unique<HashGrid>();
+    else
+        _spatialIndex = std::make_unique<AabbTree>();
+
+    _checkAllocations = settings.checkAllocations;
+    _measureInputLatency = settings.measureInputLatency;
+    _vsyncMode = settings.vsyncMode;
+    _pacer.frameLimit = settings.frameLimit;
+    _pacer.smoothDeltaTime = settings.smoothDeltaTime;
+    _lowLatency = settings.lowLatency;
+    _lateLatch = settings.lateLatch;
+    _fixedUpdateRate = settings.fixedUpdateRate;
+    _maxFixedUpdates = settings.maxFixedUpdates;
+    _interpolateTransforms = settings.interpolateTransforms;
+    _capturing = settings.capture;
+    _captureFormat = settings.captureFormat;
+    _capturePath = settings.capturePath;
+    _captureFrames = settings.captureFrames;
+    _captureEveryFrame = settings.captureEveryFrame;
+    _imguiVisible = settings.showImGui;
+    _imguiRate = settings.imguiRate;
+    ResourceTracker::setGpuBudget((uint64_t)settings.gpuMemoryBudget << 20);
+    ResourceTracker::setSystemBudget((uint64_t)settings.systemMemoryBudget << 20);
+    _resourceDumpPath = settings.resourceDumpPath;
+    // Y4M headers need a rate, the one the game is paced at when there is one
+    _captureFrameRate = settings.fixedUpdateRate > 0 ? settings.fixedUpdateRate : (settings.frameLimit > 0 ? settings.frameLimit : 60);
+    _useRenderThread = settings.renderThread;
+    _renderLatency = settings.renderLatency;
+    _packet = std::make_unique<FramePacket>();
+    _renderedSize = _screenSize;
+
     initialized = true;
 
     glActiveTexture(GL_TEXTURE0);
 
     // Show a black screen waiting for run()
-    render();
+    extract(*_packet);
+    renderPacket(*_packet);
 }
 
 void Game::clear()
 {
-    _objects.clear();
     lights.clear();
     activeCamera = nullptr;
+    _objects.clear();
+    _concurrentUpdates.clear();
+    _serialUpdates.clear();
+    _spawned.clear();
+    _despawned.clear();
+    _indexed.clear();
+    _indexPending.clear();
+    if (_spatialIndex)
+        _spatialIndex->clear();
+    _selected = ObjectHandle();
+    _pickRequest.reset();
+    _objectsChanged = true;
+
+    for (ObjectSlot &slot : _slots)
+        if (slot.object)
+            destroyObject(slot);
+    _slots.clear();
+    _freeSlots.clear();
 }
 
 Game::~Game()
 {
+    // While everything is still loaded
+    if (!_resourceDumpPath.empty())
+        ResourceTracker::dumpJson(_resourceDumpPath);
+
     clear();
 
+    waitForGpu();
+    _capture.reset();
+    _metrics.reset();
+    _packet.reset();
+    _renderer.reset();
+    _jobs.reset();
+    _profiler.reset();
+    _materials.reset();
+    ResourceTracker::release(RESOURCE_GL_TEXTURE, _whiteTexture);
     glDeleteTextures(1, &_whiteTexture);
 
     ImGui_ImplOpenGL3_Shutdown();
@@ -117,78 +230,769 @@ Game::~Game()
 
 void Game::run()
 {
-    float lastFrame = glfwGetTime();
+    int frame = 0;
+
+    // Owns the context until the loop ends, GL resources have to be created before run()
+    std::unique_ptr<RenderThread> renderThread;
+    if (_useRenderThread)
+    {
+        glfwMakeContextCurrent(nullptr);
+        renderThread = std::make_unique<RenderThread>(_window, _renderLatency, [this](FramePacket &packet)
+                                                      {
+            renderPacket(packet);
+            waitForGpu(); });
+    }
+
+    flushObjects();
 
     while (!glfwWindowShouldClose(_window))
     {
-        // Calculate deltaTime
-        _time = glfwGetTime();
-        _deltaTime = _time - lastFrame;
-        lastFrame = _time;
+        _profiler->beginCpu("Frame pacing");
+        _pacer.wait();
+        // The render thread waits for the fence itself once it has rendered, being idle means the GPU is done
+        if (!renderThread)
+            waitForGpu();
+        else if (_lowLatency)
+            renderThread->waitIdle();
+        _profiler->endCpu();
+
+        _pacer.beginFrame();
+
+        _frameArena.reset();
+
+        // Counts of the last frame the profiler closed
+        if (_checkAllocations && ++frame > ALLOCATION_WARMUP_FRAMES && AllocationTracker::getFrameCount() > 0)
+            std::cout << "ERROR::GAME::FRAME_ALLOCATED " << AllocationTracker::getFrameCount() << " allocations, "
+                      << AllocationTracker::getFrameBytes() << " bytes" << std::endl;
 
         glfwPollEvents();
+        _input->beginFrame();
+
+        if (_fixedUpdateRate > 0)
+            fixedUpdate();
+        else
+        {
+            _time = glfwGetTime();
+            _deltaTime = _pacer.getDeltaTime();
+            _interpolation = 1.0f;
+            _input->beginUpdate();
+            update();
+        }
+
+        updateSpatialIndex();
+        pick();
 
-        for (const std::unique_ptr<Object> &object : _objects)
-            object->notification(Notification::UPDATE);
+        if (_input->wasKeyPressedThisFrame(GLFW_KEY_F1))
+            _imguiVisible = !_imguiVisible;
 
-        render();
+        if (renderThread)
+        {
+            extract(renderThread->acquire());
+            renderThread->submit();
+        }
+        else
+        {
+            extract(*_packet);
+            renderPacket(*_packet);
+        }
+
+        flushObjects();
+
+        if (_metrics)
+            updateMetrics();
     }
 }
 
-void Game::render() const
+void Game::update()
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    _profiler->beginCpu("Update");
+    _jobs->parallelFor(_concurrentUpdates.size(), UPDATE_CHUNK_SIZE, [this](int begin, int end)
+                       {
+        for (int i = begin; i < end; i++)
+            _concurrentUpdates[i]->notification(Notification::UPDATE); });
+
+    for (Object *object : _serialUpdates)
+        object->notification(Notification::UPDATE);
+    _profiler->endCpu();
+}
+
+void Game::fixedUpdate()
+{
+    float timestep = 1.0f / _fixedUpdateRate;
+    _deltaTime = timestep;
+
+    // Wall clock time, smoothing it would let the simulation drift from it
+    _accumulator += _pacer.getRawDeltaTime();
+    _fixedUpdatesLastFrame = 0;
+    while (_accumulator >= timestep)
+    {
+        // Updates slower than real time would only fall further behind
+        if (_fixedUpdatesLastFrame == _maxFixedUpdates)
+        {
+            _droppedFixedUpdates += (unsigned long long)(_accumulator / timestep);
+            _accumulator = std::fmod(_accumulator, (double)timestep);
+            break;
+        }
+
+        // Each update reacts to the input that arrived since the previous one
+        _input->beginUpdate();
+        storePreviousTransforms();
+        update();
 
-    glStencilMask(0x00);
-    for (const std::unique_ptr<Object> &object : _objects)
+        _time += timestep;
+        _accumulator -= timestep;
+        _fixedUpdatesLastFrame++;
+    }
+
+    _interpolation = _accumulator / timestep;
+}
+
+void Game::storePreviousTransforms()
+{
+    _jobs->parallelFor(_objects.size(), UPDATE_CHUNK_SIZE, [this](int begin, int end)
+                       {
+        for (int i = begin; i < end; i++)
+            _objects[i]->_previousTransform = _objects[i]->transform; });
+}
+
+bool Game::isInterpolating() const
+{
+    return _fixedUpdateRate > 0 && _interpolateTransforms;
+}
+
+void Game::beginInterpolation()
+{
+    if (!isInterpolating())
+        return;
+
+    _jobs->parallelFor(_objects.size(), UPDATE_CHUNK_SIZE, [this](int begin, int end)
+                       {
+        for (int i = begin; i < end; i++)
+        {
+            Object *object = _objects[i];
+            object->_simulatedTransform = object->transform;
+            object->transform = Transform::interpolate(object->_previousTransform, object->transform, _interpolation);
+        } });
+}
+
+void Game::endInterpolation()
+{
+    if (!isInterpolating())
+        return;
+
+    _jobs->parallelFor(_objects.size(), UPDATE_CHUNK_SIZE, [this](int begin, int end)
+                       {
+        for (int i = begin; i < end; i++)
+            _objects[i]->transform = _objects[i]->_simulatedTransform; });
+}
+
+void Game::extract(FramePacket &packet)
+{
+    _profiler->beginCpu("Extract");
+    beginInterpolation();
+    for (Object *object : _objects)
+    {
+        _renderer->setPickId(getPickId(object));
         object->notification(Notification::DRAW);
+    }
+    _renderer->setPickId(0);
+
+    _renderer->extract(packet.commands);
+    if (Object *selected = get(_selected))
+    {
+        uint32_t selectedId = getPickId(selected);
+        for (DrawCommand &command : packet.commands)
+            if (command.pickId == selectedId)
+                command.outlined = true;
+    }
+    packet.pickPixel = _pickRequest;
+    _pickRequest.reset();
+    packet.copyLights(lights);
+    // Back to the simulated transforms before ImGui shows and edits them
+    endInterpolation();
+    _materials->takeUpload(packet.materials);
+    packet.inputTime = _measureInputLatency ? _input->getOldestEventTime() : 0.0;
+    packet.lowLatency = _lowLatency;
+    _profiler->endCpu();
+
+    imguiUpdate(packet);
+
+    // The view is the last thing taken from the frame, with the input that arrived while it was built
+    if (_lateLatch)
+    {
+        glfwPollEvents();
+        _input->latch();
+        if (activeCamera)
+            activeCamera->notification(Notification::LATE_UPDATE);
+    }
+
+    packet.camera.reset();
+    if (activeCamera)
+    {
+        packet.camera.emplace(*activeCamera);
+        if (isInterpolating())
+            packet.camera->transform = Transform::interpolate(activeCamera->_previousTransform, activeCamera->transform, _interpolation);
+    }
+    packet.screenSize = _screenSize;
+}
+
+void Game::renderPacket(FramePacket &packet)
+{
+    std::lock_guard<std::mutex> lock(_renderMutex);
+
+    _profiler->beginFrame();
+    applyVsyncMode();
+
+    if (packet.screenSize != _renderedSize)
+    {
+        _renderedSize = packet.screenSize;
+        glViewport(0, 0, _renderedSize.x, _renderedSize.y);
+        _renderer->resize(_renderedSize);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    _materials->upload(packet.materials);
 
-    imguiRender();
+    if (packet.pickPixel)
+        _renderer->requestPick(*packet.pickPixel);
+
+    _profiler->beginCpu("Render");
+    if (packet.camera)
+        _renderer->render(*packet.camera, packet.lights, packet.commands);
+    _profiler->endCpu();
+
+    if (Metrics::isEnabled())
+    {
+        static MetricHistogram &renderTime = Metrics::histogram("engine_render_seconds", "CPU time spent rendering a frame",
+                                                                {0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.1});
+        static MetricGauge &drawCommands = Metrics::gauge("engine_draw_commands", "Draw commands of the last frame rendered");
+        renderTime.observe(_profiler->getCpuMilliseconds("Render") / 1000.0);
+        drawCommands.set(packet.commands.size());
+    }
+    packet.commands.clear();
+
+    // The scene only, before ImGui is drawn over it
+    updateCapture();
+    if (_capture && packet.camera)
+    {
+        _capture->capture(_renderedSize);
+        if (_captureFrames > 0 && _capture->getCapturedCount() >= _captureFrames)
+            glfwSetWindowShouldClose(_window, true);
+    }
+
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplOpenGL3_RenderDrawData(&packet.imguiData);
 
     glfwSwapBuffers(_window);
+
+    if (packet.lowLatency && !_frameFence)
+        _frameFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    if (packet.inputTime > 0.0)
+    {
+        // Until the GPU is done with the frame, the display adds at most one refresh after that
+        glFinish();
+        float latency = (glfwGetTime() - packet.inputTime) * 1000.0;
+        _inputLatency = latency;
+        _averageInputLatency = _averageInputLatency * 0.95f + latency * 0.05f;
+    }
+}
+
+void Game::updateMetrics()
+{
+    static MetricCounter &frames = Metrics::counter("engine_frames_total", "Frames simulated");
+    static MetricHistogram &frameTime = Metrics::histogram("engine_frame_seconds", "Time between the starts of two frames",
+                                                           {0.004, 0.008, 0.0167, 0.0333, 0.05, 0.1, 0.25});
+    static MetricGauge &updateTime = Metrics::gauge("engine_update_seconds", "CPU time of the last update");
+    static MetricGauge &objects = Metrics::gauge("engine_objects", "Objects in the game");
+    static MetricCounter &spawned = Metrics::counter("engine_objects_spawned_total", "Objects that joined the game");
+    static MetricCounter &despawned = Metrics::counter("engine_objects_despawned_total", "Objects destroyed");
+    static MetricGauge &allocations = Metrics::gauge("engine_heap_allocations", "Heap allocations of the last frame");
+    static MetricGauge &gpuMemory = Metrics::gauge("engine_gpu_memory_bytes", "GPU memory held by tracked resources");
+    static MetricGauge &systemMemory = Metrics::gauge("engine_system_memory_bytes", "System memory held by tracked resources");
+
+    frames.add();
+    frameTime.observe(_pacer.getRawDeltaTime());
+    updateTime.set(_profiler->getCpuMilliseconds("Update") / 1000.0);
+    objects.set(_objects.size());
+    spawned.add(_spawnedLastFrame);
+    despawned.add(_despawnedLastFrame);
+    allocations.set(AllocationTracker::getFrameCount());
+    gpuMemory.set(ResourceTracker::getGpuUsage().bytes);
+    systemMemory.set(ResourceTracker::getSystemUsage().bytes);
+
+    if (_metricsLogInterval > 0 && frames.get() % _metricsLogInterval == 0)
+        _metrics->log(frames.get(), glfwGetTime());
+}
+
+void Game::applyVsyncMode()
+{
+    VsyncMode mode = _vsyncMode;
+    if (_appliedVsyncMode == mode)
+        return;
+    _appliedVsyncMode = mode;
+
+    int interval = mode == VsyncMode::VSYNC_OFF ? 0 : 1;
+    if (mode == VsyncMode::VSYNC_ADAPTIVE)
+    {
+        // Negative intervals are only valid with one of these
+        _adaptiveVsyncSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                                  glfwExtensionSupported("GLX_EXT_swap_control_tear");
+        if (_adaptiveVsyncSupported)
+            interval = -1;
+    }
+
+    glfwSwapInterval(interval);
+}
+
+void Game::updateCapture()
+{
+    if (_capturing == (bool)_capture)
+    {
+        if (_capture)
+            _capture->keepEveryFrame = _captureEveryFrame;
+        return;
+    }
+
+    if (!_capturing)
+    {
+        // Finishes writing what was read so far
+        _capture.reset();
+        return;
+    }
+
+    std::string path = _capturePath;
+    if (_captureFormat == CaptureFormat::CAPTURE_Y4M && !path.ends_with(".y4m"))
+        path += ".y4m";
+    _capture = std::make_unique<FrameCapture>(*_profiler, _captureFormat, path, _captureFrameRate);
+    _capture->keepEveryFrame = _captureEveryFrame;
+}
+
+void Game::waitForGpu()
+{
+    if (!_frameFence)
+        return;
+
+    _profiler->beginCpu("GPU fence wait");
+    while (glClientWaitSync(_frameFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(_frameFence);
+    _frameFence = nullptr;
+    _profiler->endCpu();
 }
 
 float Game::getTime() const { return _time; }
 float Game::getDeltaTime() const { return _deltaTime; }
-const KeyInput &Game::getKeyInput() const { return _keyInput; }
-const MouseMove &Game::getMouseMove() const { return _mouseMove; }
+float Game::getInterpolation() const { return _interpolation; }
+InputSystem &Game::getInput() const { return *_input; }
 const glm::vec2 &Game::getScreenSize() const { return _screenSize; }
+MaterialRegistry &Game::getMaterials() const { return *_materials; }
+Renderer &Game::getRenderer() const { return *_renderer; }
+Profiler &Game::getProfiler() const { return *_profiler; }
+JobSystem &Game::getJobs() const { return *_jobs; }
+FrameArena &Game::getFrameArena() { return _frameArena; }
 
-void Game::addObject(std::unique_ptr<Object> object)
+int Game::getObjectCount() const { return _objects.size(); }
+SpatialIndex &Game::getSpatialIndex() const { return *_spatialIndex; }
+ObjectHandle Game::getSelected() const { return _selected; }
+
+Object *Game::raycast(const Ray &ray, float maxDistance, float *distance, bool precise) const
+{
+    RayHit hit;
+    if (precise)
+        hit = _spatialIndex->raycast(ray, maxDistance, [this, &ray](int proxy, float)
+                                     { return ((Object *)_spatialIndex->getUserData(proxy))->raycast(ray, FLT_MAX); });
+    else
+        hit = _spatialIndex->raycast(ray, maxDistance);
+
+    if (hit.proxy < 0)
+        return nullptr;
+
+    if (distance)
+        *distance = hit.distance;
+    return (Object *)_spatialIndex->getUserData(hit.proxy);
+}
+
+void Game::indexObject(Object *object)
+{
+    _indexPending.push_back(object);
+}
+
+void Game::updateSpatialIndex()
+{
+    _profiler->beginCpu("Spatial index");
+
+    // World boxes computed in parallel before the index is updated
+    AABB *bounds = _frameArena.allocate<AABB>(_indexed.size());
+    _jobs->parallelFor(_indexed.size(), UPDATE_CHUNK_SIZE, [this, bounds](int begin, int end)
+                       {
+        for (int i = begin; i < end; i++)
+            bounds[i] = _indexed[i]->_bounds.transformed(_indexed[i]->transform.getMatrix()); });
+
+    for (size_t i = 0; i < _indexed.size(); i++)
+        _spatialIndex->update(_indexed[i]->_proxy, bounds[i]);
+
+    _profiler->endCpu();
+}
+
+void Game::pick()
+{
+    // Answers to clicks of previous frames
+    PickResult result;
+    if (_renderer->getPicker().takeResult(result))
+    {
+        Object *object = getPicked(result.id);
+        _selected = object ? object->getHandle() : ObjectHandle();
+        _selectedDistance = -1.0f;
+    }
+
+    if (!activeCamera || !_input->wasMouseButtonPressedThisFrame(GLFW_MOUSE_BUTTON_LEFT) || (_imguiVisible && ImGui::GetIO().WantCaptureMouse))
+        return;
+
+    glm::vec2 position = _input->getCursorMode() == GLFW_CURSOR_DISABLED ? _screenSize * 0.5f : _input->getMousePosition();
+    if (_gpuPicking)
+    {
+        _pickRequest = glm::ivec2(position.x, _screenSize.y - 1.0f - position.y);
+        return;
+    }
+
+    Object *object = raycast(activeCamera->getScreenRay(position), FLT_MAX, &_selectedDistance);
+    _selected = object ? object->getHandle() : ObjectHandle();
+}
+
+uint32_t Game::getPickId(const Object *object) const
+{
+    uint32_t index = object->_handle.index + 1;
+    if (index >= 1u << PICK_INDEX_BITS)
+        return 0;
+    return object->_handle.generation << PICK_INDEX_BITS | index;
+}
+
+Object *Game::getPicked(uint32_t id) const
+{
+    if (!id)
+        return nullptr;
+
+    uint32_t index = (id & ((1u << PICK_INDEX_BITS) - 1)) - 1;
+    if (index >= _slots.size())
+        return nullptr;
+
+    const ObjectSlot &slot = _slots[index];
+    uint32_t generationMask = (1u << (32 - PICK_INDEX_BITS)) - 1;
+    return (slot.generation & generationMask) == id >> PICK_INDEX_BITS ? slot.object : nullptr;
+}
+
+ObjectHandle Game::addObject(std::unique_ptr<Object> object)
 {
-    object->init(*this);
+    return registerObject(object.release(), nullptr);
+}
+
+void Game::despawn(ObjectHandle handle)
+{
+    std::lock_guard<std::mutex> lock(_despawnMutex);
+    _despawned.push_back(handle);
+}
+
+Object *Game::get(ObjectHandle handle) const
+{
+    if (handle.index >= _slots.size())
+        return nullptr;
+
+    const ObjectSlot &slot = _slots[handle.index];
+    return slot.generation == handle.generation ? slot.object : nullptr;
+}
+
+ObjectHandle Game::registerObject(Object *object, ObjectPoolBase *pool)
+{
+    uint32_t index;
+    if (_freeSlots.empty())
+    {
+        index = _slots.size();
+        _slots.emplace_back();
+    }
+    else
+    {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+
+    ObjectSlot &slot = _slots[index];
+    slot.object = object;
+    slot.pool = pool;
+
+    ObjectHandle handle = {index, slot.generation};
+    object->init(*this, handle);
     object->notification(Notification::START);
-    _objects.push_back(std::move(object));
+
+    _spawned.push_back(object);
+    return handle;
 }
 
-void Game::imguiRender() const
+void Game::flushObjects()
+{
+    _profiler->beginCpu("Spawn and despawn");
+
+    _spawnedLastFrame = _spawned.size();
+    for (Object *object : _spawned)
+    {
+        if (object->_hasBounds)
+            _indexPending.push_back(object);
+        object->resetInterpolation();
+        object->_objectIndex = _objects.size();
+        _objects.push_back(object);
+        object->_concurrentUpdate = object->runsConcurrently(Notification::UPDATE);
+        std::vector<Object *> &updates = object->_concurrentUpdate ? _concurrentUpdates : _serialUpdates;
+        object->_updateIndex = updates.size();
+        updates.push_back(object);
+    }
+    _spawned.clear();
+
+    // In one batch, the index may build over them at once rather than insert them one by one
+    std::sort(_indexPending.begin(), _indexPending.end());
+    _indexPending.erase(std::unique(_indexPending.begin(), _indexPending.end()), _indexPending.end());
+    std::erase_if(_indexPending, [](const Object *object)
+                  { return object->_proxy >= 0; });
+    if (!_indexPending.empty())
+    {
+        int count = _indexPending.size();
+        AABB *bounds = _frameArena.allocate<AABB>(count);
+        void **userData = _frameArena.allocate<void *>(count);
+        int *proxies = _frameArena.allocate<int>(count);
+        for (int i = 0; i < count; i++)
+        {
+            bounds[i] = _indexPending[i]->_bounds.transformed(_indexPending[i]->transform.getMatrix());
+            userData[i] = _indexPending[i];
+        }
+
+        _spatialIndex->insert(count, bounds, userData, proxies);
+        for (int i = 0; i < count; i++)
+        {
+            _indexPending[i]->_proxy = proxies[i];
+            _indexPending[i]->_indexedIndex = _indexed.size();
+            _indexed.push_back(_indexPending[i]);
+        }
+        _indexPending.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_despawnMutex);
+        _destroying.swap(_despawned);
+    }
+
+    // Constant time per despawned object, only lights are searched and only when one of them goes
+    _despawnedLastFrame = 0;
+    bool lightDespawned = false;
+    for (ObjectHandle handle : _destroying)
+    {
+        Object *object = get(handle);
+        if (!object || object->_despawned)
+            continue;
+
+        object->_despawned = true;
+        if (object->_proxy >= 0)
+        {
+            _spatialIndex->remove(object->_proxy);
+            object->_proxy = -1;
+            removeFrom(_indexed, &Object::_indexedIndex, object);
+        }
+
+        removeFrom(_objects, &Object::_objectIndex, object);
+        removeFrom(object->_concurrentUpdate ? _concurrentUpdates : _serialUpdates, &Object::_updateIndex, object);
+        lightDespawned |= dynamic_cast<Light *>(object) != nullptr;
+        if (object == activeCamera)
+            activeCamera = nullptr;
+    }
+
+    if (lightDespawned)
+        std::erase_if(lights, [](const Light *light)
+                      { return light->_despawned; });
+
+    // A handle despawned twice no longer matches its slot the second time
+    for (ObjectHandle handle : _destroying)
+    {
+        if (!get(handle))
+            continue;
+
+        destroyObject(_slots[handle.index]);
+        _freeSlots.push_back(handle.index);
+        _despawnedLastFrame++;
+    }
+    _destroying.clear();
+
+    if (_spawnedLastFrame || _despawnedLastFrame)
+        _objectsChanged = true;
+
+    _profiler->endCpu();
+}
+
+void Game::removeFrom(std::vector<Object *> &list, int Object::*position, Object *object)
+{
+    Object *last = list.back();
+    list[object->*position] = last;
+    last->*position = object->*position;
+    list.pop_back();
+    object->*position = -1;
+}
+
+void Game::destroyObject(ObjectSlot &slot)
+{
+    if (slot.pool)
+        slot.pool->destroy(slot.object);
+    else
+        delete slot.object;
+
+    slot.object = nullptr;
+    slot.pool = nullptr;
+    slot.generation++;
+}
+
+void Game::imguiUpdate(FramePacket &packet)
+{
+    if (!_imguiVisible)
+    {
+        // Nothing reads the events meanwhile, they would pile up until it is shown again
+        ImGui::GetIO().ClearEventsQueue();
+        packet.clearImGuiData();
+        _lastImGuiBuild = 0.0;
+        return;
+    }
+
+    _profiler->beginCpu("ImGui");
+    double now = glfwGetTime();
+    if (_imguiRate <= 0 || _lastImGuiBuild == 0.0 || now - _lastImGuiBuild >= 1.0 / _imguiRate)
+    {
+        imguiBuild();
+        _lastImGuiBuild = now;
+    }
+    // The draw data of the last build stays valid until the next one
+    packet.copyImGuiData(*ImGui::GetDrawData());
+    _profiler->endCpu();
+}
+
+void Game::imguiBuild()
 {
-    ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
     ImGui::SetNextWindowSizeConstraints(ImVec2(300.0f, 200.0f), ImVec2(FLT_MAX, FLT_MAX));
     if (ImGui::Begin("Properties", nullptr, ImGuiWindowFlags_NoSavedSettings))
     {
-        ImGui::Text("Mouse pos: %0.f, %0.f", _mouseMove.xPos, _mouseMove.yPos);
-        ImGui::Text("Mouse delta: %0.f, %0.f", _mouseMove.delta.x, _mouseMove.delta.y);
-        ImGui::Text("Key input: key %0d, action %0d", _keyInput.key, _keyInput.action);
+        glm::vec2 mousePosition = _input->getMousePosition();
+        glm::vec2 mouseDelta = _input->getMouseDelta();
+        ImGui::Text("Mouse pos: %0.f, %0.f", mousePosition.x, mousePosition.y);
+        ImGui::Text("Mouse delta: %0.f, %0.f%s", mouseDelta.x, mouseDelta.y, _input->usesRawMouseMotion() ? " (raw)" : "");
+        ImGui::Text("Input events: %d, %d dropped", _input->getEventCount(), _input->getDroppedCount());
+        if (_measureInputLatency)
+            ImGui::Text("Motion to photon: %.1f ms (%.1f avg)", _inputLatency.load(), _averageInputLatency.load());
+
+        float updateMs = _profiler->getCpuMilliseconds("Update");
+        ImGui::Text("Frame: %.2f ms", _pacer.getRawDeltaTime() * 1000.0f);
+        ImGui::Text("Render thread: %s", _useRenderThread ? "on" : "off");
+        ImGui::Text("Threads: %d", _jobs->getThreadCount());
+        ImGui::Text("Objects: %d, %d concurrent", (int)_objects.size(), (int)_concurrentUpdates.size());
+        ImGui::Text("Spawned: %d, despawned: %d", _spawnedLastFrame, _despawnedLastFrame);
+        ImGui::Text("Update: %.2f Mobjects/s", updateMs > 0.0f ? _objects.size() / (updateMs * 1000.0f) : 0.0f);
+        ImGui::Text("Heap allocations: %llu (%.1f KB)", (unsigned long long)AllocationTracker::getFrameCount(),
+                    AllocationTracker::getFrameBytes() / 1024.0);
+        ImGui::Text("Frame arena: %.1f / %.0f KB", _frameArena.getUsed() / 1024.0, _frameArena.getCapacity() / 1024.0);
+        ImGui::Text("ImGui: %.2f ms (F1 hides it)", _profiler->getCpuMilliseconds("ImGui"));
+        ImGui::SliderInt("ImGui rate", &_imguiRate, 0, 60, _imguiRate > 0 ? "%d Hz" : "Every frame");
+
+        if (ImGui::CollapsingHeader("Frame pacing"))
+        {
+            int vsyncMode = _vsyncMode;
+            if (ImGui::Combo("Vsync", &vsyncMode, "Off\0On\0Adaptive\0"))
+                _vsyncMode = (VsyncMode)vsyncMode;
+            if (vsyncMode == VsyncMode::VSYNC_ADAPTIVE && !_adaptiveVsyncSupported)
+                ImGui::TextDisabled("Adaptive vsync unsupported, on instead");
+            ImGui::SliderInt("Frame limit", &_pacer.frameLimit, 0, 240, _pacer.frameLimit > 0 ? "%d fps" : "Off");
+            ImGui::Checkbox("Smooth delta time", &_pacer.smoothDeltaTime);
+            ImGui::Checkbox("Low latency", &_lowLatency);
+            ImGui::Checkbox("Late latch camera", &_lateLatch);
+
+            int fixedUpdateRate = _fixedUpdateRate;
+            if (ImGui::SliderInt("Fixed updates", &fixedUpdateRate, 0, 240, fixedUpdateRate > 0 ? "%d Hz" : "Off"))
+            {
+                // Nothing to blend from until the next update
+                if (_fixedUpdateRate == 0)
+                    storePreviousTransforms();
+                _fixedUpdateRate = fixedUpdateRate;
+                _accumulator = 0.0;
+            }
+            if (_fixedUpdateRate > 0)
+            {
+                ImGui::SliderInt("Max updates per frame", &_maxFixedUpdates, 1, 16);
+                ImGui::Checkbox("Interpolate transforms", &_interpolateTransforms);
+                ImGui::Text("Updates: %d this frame, %llu dropped", _fixedUpdatesLastFrame, _droppedFixedUpdates);
+                ImGui::Text("Interpolation: %.2f", _interpolation);
+            }
+            _pacer.imguiDraw();
+        }
+
+        if (ImGui::CollapsingHeader("Spatial index"))
+        {
+            _spatialIndex->imguiDraw();
+            ImGui::Text("Update: %.2f ms", _profiler->getCpuMilliseconds("Spatial index"));
+            ImGui::Checkbox("GPU picking", &_gpuPicking);
+            if (Object *selected = get(_selected))
+            {
+                if (_selectedDistance >= 0.0f)
+                    ImGui::Text("Selected: %s, %.2f away", selected->objectName.c_str(), _selectedDistance);
+                else
+                    ImGui::Text("Selected: %s", selected->objectName.c_str());
+            }
+            else
+                ImGui::TextDisabled("Click an object to select it");
+        }
+
+        // Renderer settings and materials may change here, wait for the packet being rendered
+        std::lock_guard<std::mutex> lock(_renderMutex);
+
+        _renderer->imguiDraw();
+
+        if (ImGui::CollapsingHeader("Memory"))
+            ResourceTracker::imguiDraw();
 
-        for (const std::unique_ptr<Object> &object : _objects)
-            object->notification(Notification::IMGUI_DRAW);
+        if (ImGui::CollapsingHeader("Frame capture"))
+        {
+            if (ImGui::Button(_capturing ? "Stop capture" : "Start capture"))
+                _capturing = !_capturing;
+            if (!_capturing)
+            {
+                int format = _captureFormat;
+                if (ImGui::Combo("Format", &format, "PNG\0Y4M\0"))
+                    _captureFormat = (CaptureFormat)format;
+            }
+            ImGui::Checkbox("Keep every frame", &_captureEveryFrame);
+            if (_capture)
+                _capture->imguiDraw();
+        }
 
         if (ImGui::Button("QUIT"))
             glfwSetWindowShouldClose(_window, true);
     }
     ImGui::End();
 
+    ImGui::SetNextWindowSizeConstraints(ImVec2(300.0f, 200.0f), ImVec2(FLT_MAX, FLT_MAX));
+    if (ImGui::Begin("Inspector", nullptr, ImGuiWindowFlags_NoSavedSettings))
+    {
+        ObjectHandle selected = _selected;
+        _inspector.draw(*this, _objects, _objectsChanged, _selected);
+        if (_selected != selected)
+            _selectedDistance = -1.0f;
+        _objectsChanged = false;
+    }
+    ImGui::End();
+
+    _profiler->imguiDraw();
+
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void Game::setCursorMode(int mode) const
 {
-    glfwSetInputMode(_window, GLFW_CURSOR, mode);
+    _input->setCursorMode(mode);
 }
 
 void Game::registerCallbacks()
@@ -208,46 +1012,31 @@ void Game::framebufferSizeCallback(GLFWwindow *window, int width, int height)
     game->_screenSize.x = (float)width;
     game->_screenSize.y = (float)height;
 
-    for (const std::unique_ptr<Object> &object : game->_objects)
+    // The viewport and render targets follow with the next packet
+    for (Object *object : game->_objects)
         object->notification(Notification::SCREEN);
-
-    glViewport(0, 0, width, height);
 }
 
 void Game::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
     Game *game = (Game *)glfwGetWindowUserPointer(window);
-    game->_keyInput = {key, scancode, action, mods};
-    for (const std::unique_ptr<Object> &object : game->_objects)
-        object->notification(Notification::KEY_INPUT);
+    game->_input->push({InputEventType::KEY_EVENT, glfwGetTime(), key, action, mods, glm::vec2(0.0f)});
 }
 
 void Game::mouseCallback(GLFWwindow *window, double xPos, double yPos)
 {
     Game *game = (Game *)glfwGetWindowUserPointer(window);
-
-    double prevXPos = game->_mouseMove.xPos;
-    double prevYPos = game->_mouseMove.yPos;
-
-    glm::vec2 delta = glm::vec2(
-        xPos - prevXPos,
-        yPos - prevYPos);
-
-    game->_mouseMove = {
-        prevXPos,
-        prevYPos,
-        xPos,
-        yPos,
-        delta,
-    };
-
-    for (const std::unique_ptr<Object> &object : game->_objects)
-        object->notification(Notification::MOUSE_MOVE);
+    game->_input->push({InputEventType::MOUSE_MOVE_EVENT, glfwGetTime(), 0, 0, 0, glm::vec2(xPos, yPos)});
 }
 
 void Game::mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
 {
+    Game *game = (Game *)glfwGetWindowUserPointer(window);
+    game->_input->push({InputEventType::MOUSE_BUTTON_EVENT, glfwGetTime(), button, action, mods, glm::vec2(0.0f)});
 }
+
 void Game::scrollCallback(GLFWwindow *window, double xOffset, double yOffset)
 {
+    Game *game = (Game *)glfwGetWindowUserPointer(window);
+    game->_input->push({InputEventType::SCROLL_EVENT, glfwGetTime(), 0, 0, 0, glm::vec2(xOffset, yOffset)});
 }
\ No newline at end of file
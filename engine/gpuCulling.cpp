@@ -0,0 +1,330 @@
+#include <engine/gpuCulling.h>
+#include <engine/bounds.h>
+#include <engine/camera.h>
+#include <engine/profiler.h>
+#include <engine/renderer.h>
+#include <engine/resourceTracker.h>
+#include <engine/texture.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "imgui.h"
+
+GpuCulling::GpuCulling(const MaterialRegistry &materials, Profiler &profiler, FrameArena &arena, const glm::vec2 &size)
+    : _materials(materials), _profiler(profiler), _arena(arena), _size(size)
+{
+    _cullShader = std::make_unique<Shader>("./shaders/cull.vs", nullptr, std::vector<std::string>(), std::vector<std::string>{"Visible"});
+    _pyramidShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/depthPyramid.fs");
+
+    glGenVertexArrays(1, &_emptyVao);
+
+    glGenBuffers(1, &_instanceBuffer);
+    glGenBuffers(1, &_visibilityBuffer);
+    reserve(256);
+
+    glGenTextures(1, &_instanceTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, _instanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _instanceBuffer);
+
+    glGenTextures(1, &_visibilityTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, _visibilityTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, _visibilityBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+GpuCulling::~GpuCulling()
+{
+    destroyPyramid();
+
+    GLuint textures[] = {_instanceTexture, _visibilityTexture};
+    GLuint buffers[] = {_instanceBuffer, _visibilityBuffer};
+    for (GLuint buffer : buffers)
+        ResourceTracker::release(RESOURCE_GL_BUFFER, buffer);
+    glDeleteTextures(2, textures);
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &_emptyVao);
+}
+
+void GpuCulling::cull(const std::vector<const DrawCommand *> &commands, const Camera &camera)
+{
+    // Stable so instances keep their front to back order inside a batch. The palette index travels with each
+    // instance, only materials with other maps need a batch of their own
+    _sorted = commands;
+    std::stable_sort(_sorted.begin(), _sorted.end(),
+                     [this](const DrawCommand *a, const DrawCommand *b)
+                     {
+                         if (a->shader != b->shader)
+                             return a->shader < b->shader;
+                         if (!_materials.hasSameMaps(a->material, b->material))
+                             return _materials.isBeforeByMaps(a->material, b->material);
+                         return a->mesh < b->mesh;
+                     });
+
+    _batches.clear();
+    _instanceData.clear();
+    for (int i = 0; i < _sorted.size(); i++)
+    {
+        const DrawCommand &command = *_sorted[i];
+
+        Batch *batch = _batches.empty() ? nullptr : &_batches.back();
+        if (!batch || batch->mesh != command.mesh || batch->shader != command.shader ||
+            !_materials.hasSameMaps(batch->material, command.material))
+            _batches.push_back({command.mesh, command.shader, command.material, i, 0});
+        _batches.back().count++;
+
+        AABB bounds = command.mesh->getBounds().transformed(command.model);
+        for (int column = 0; column < 4; column++)
+            _instanceData.push_back(command.model[column]);
+        // Exact as a float, the palette is far smaller than 2^24
+        _instanceData.push_back(glm::vec4(bounds.min, (float)command.material));
+        _instanceData.push_back(glm::vec4(bounds.max, 0.0f));
+    }
+
+    _profiler.setCounter("GPU cull instances", _sorted.size());
+    _profiler.setCounter("GPU cull batches", _batches.size());
+
+    if (_sorted.empty())
+        return;
+
+    reserve(_sorted.size());
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _instanceData.size() * sizeof(glm::vec4), _instanceData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glm::mat4 viewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+    Frustum frustum(viewProjection);
+
+    _cullShader->use();
+    static const char *planeUniforms[] = {"frustumPlanes[0]", "frustumPlanes[1]", "frustumPlanes[2]",
+                                          "frustumPlanes[3]", "frustumPlanes[4]", "frustumPlanes[5]"};
+    for (int i = 0; i < 6; i++)
+        _cullShader->setUniform(planeUniforms[i], frustum.planes[i]);
+    _cullShader->setUniform("viewProjection", viewProjection);
+    _cullShader->setUniform("occlusionTest", occlusionTest && _pyramidValid);
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::INSTANCE_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, _instanceTexture);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::DEPTH_PYRAMID_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _pyramid);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, _visibilityBuffer);
+    glBindVertexArray(_emptyVao);
+
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, _sorted.size());
+    glEndTransformFeedback();
+
+    glBindVertexArray(0);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    if (validate)
+        validateResults(camera);
+}
+
+const std::vector<GpuCulling::Batch> &GpuCulling::getBatches() const { return _batches; }
+
+void GpuCulling::bind(const Shader &shader, const Batch &batch) const
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::INSTANCE_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, _instanceTexture);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::INSTANCE_VISIBILITY_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, _visibilityTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setUniform("firstInstance", batch.first);
+}
+
+void GpuCulling::buildDepthPyramid(GLuint sceneFramebuffer)
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    if (!_pyramid)
+        createPyramid();
+
+    _profiler.beginGpu("Depth pyramid");
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _depthFramebuffer);
+    glBlitFramebuffer(0, 0, _size.x, _size.y, 0, 0, _size.x, _size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glDisable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _pyramidFramebuffer);
+    glBindVertexArray(_emptyVao);
+    _pyramidShader->use();
+    _pyramidShader->setUniform("source", (int)TextureUnit::DEPTH_PYRAMID_UNIT);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::DEPTH_PYRAMID_UNIT);
+
+    glm::ivec2 size = _size;
+    for (int level = 0; level < _pyramidLevels; level++)
+    {
+        // The level being written is kept out of the sampled range so there is no feedback loop
+        if (level == 0)
+            glBindTexture(GL_TEXTURE_2D, _depthCopy);
+        else
+        {
+            glBindTexture(GL_TEXTURE_2D, _pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _pyramid, level);
+        glViewport(0, 0, size.x, size.y);
+        _pyramidShader->setUniform("reduce", level > 0);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        size = glm::max(size / 2, glm::ivec2(1));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, _pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _pyramidLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, _size.x, _size.y);
+    glEnable(GL_DEPTH_TEST);
+
+    _profiler.endGpu();
+    _pyramidValid = true;
+}
+
+void GpuCulling::resize(const glm::vec2 &size)
+{
+    _size = size;
+    // Created again on first use
+    destroyPyramid();
+}
+
+void GpuCulling::reserve(int instances)
+{
+    if (instances <= _capacity)
+        return;
+
+    while (_capacity < instances)
+        _capacity = std::max(_capacity * 2, 256);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, _capacity * INSTANCE_TEXELS * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, _visibilityBuffer);
+    glBufferData(GL_ARRAY_BUFFER, _capacity * sizeof(float), nullptr, GL_STREAM_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The buffer textures only view these
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _instanceBuffer, RESOURCE_BUFFER, "GPU culling", _capacity * INSTANCE_TEXELS * sizeof(glm::vec4));
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _visibilityBuffer, RESOURCE_BUFFER, "GPU culling", _capacity * sizeof(float));
+}
+
+void GpuCulling::validateResults(const Camera &camera)
+{
+    float *visibility = _arena.allocate<float>(_sorted.size());
+    glBindBuffer(GL_ARRAY_BUFFER, _visibilityBuffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, _sorted.size() * sizeof(float), visibility);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The occlusion test may only cull more, what the frustum rejects has to be culled either way
+    Frustum frustum(camera.getProjectionMatrix() * camera.getViewMatrix());
+    bool occlusion = occlusionTest && _pyramidValid;
+    int culled = 0;
+    int mismatches = 0;
+    for (int i = 0; i < _sorted.size(); i++)
+    {
+        const glm::vec4 *data = &_instanceData[i * INSTANCE_TEXELS];
+        bool expected = frustum.intersects({glm::vec3(data[4]), glm::vec3(data[5])});
+        bool visible = visibility[i] != 0.0f;
+
+        culled += !visible;
+        if (visible ? !expected : expected && !occlusion)
+            mismatches++;
+    }
+
+    _profiler.setCounter("GPU culled", culled);
+    _profiler.setCounter("GPU cull mismatches", mismatches);
+    if (mismatches)
+        std::cout << "ERROR::GPU_CULLING::" << mismatches << "_MISMATCHES_WITH_CPU_FRUSTUM" << std::endl;
+}
+
+void GpuCulling::createPyramid()
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    _pyramidLevels = (int)std::floor(std::log2((float)std::max(_size.x, _size.y))) + 1;
+
+    glGenTextures(1, &_depthCopy);
+    glBindTexture(GL_TEXTURE_2D, _depthCopy);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, _size.x, _size.y, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    ResourceTracker::track(RESOURCE_GL_TEXTURE, _depthCopy, RESOURCE_RENDER_TARGET, "GPU culling",
+                           ResourceTracker::getTextureBytes(GL_DEPTH24_STENCIL8, _size.x, _size.y));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &_depthFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _depthFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, _depthCopy, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::GPU_CULLING::DEPTH_COPY_INCOMPLETE" << std::endl;
+
+    glGenTextures(1, &_pyramid);
+    glBindTexture(GL_TEXTURE_2D, _pyramid);
+    glm::ivec2 size = _size;
+    for (int level = 0; level < _pyramidLevels; level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, size.x, size.y, 0, GL_RED, GL_FLOAT, nullptr);
+        size = glm::max(size / 2, glm::ivec2(1));
+    }
+    ResourceTracker::track(RESOURCE_GL_TEXTURE, _pyramid, RESOURCE_RENDER_TARGET, "GPU culling",
+                           ResourceTracker::getTextureBytes(GL_R32F, _size.x, _size.y, _pyramidLevels));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _pyramidLevels - 1);
+
+    glGenFramebuffers(1, &_pyramidFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _pyramidFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _pyramid, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::GPU_CULLING::PYRAMID_INCOMPLETE" << std::endl;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GpuCulling::destroyPyramid()
+{
+    _pyramidValid = false;
+    if (!_pyramid)
+        return;
+
+    GLuint textures[] = {_depthCopy, _pyramid};
+    GLuint framebuffers[] = {_depthFramebuffer, _pyramidFramebuffer};
+    for (GLuint texture : textures)
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, texture);
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(2, framebuffers);
+
+    _depthCopy = _pyramid = _depthFramebuffer = _pyramidFramebuffer = 0;
+}
+
+void GpuCulling::imguiDraw()
+{
+    if (ImGui::TreeNode("GPU culling"))
+    {
+        ImGui::Text("Batches: %d", (int)_batches.size());
+        ImGui::Text("Pyramid levels: %d", _pyramidLevels);
+        ImGui::Checkbox("Occlusion test", &occlusionTest);
+        ImGui::Checkbox("Validate against CPU", &validate);
+        ImGui::TreePop();
+    }
+}
@@ -0,0 +1,319 @@
+#include <engine/hashGrid.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+HashGrid::HashGrid(float cellSize, int buckets) : _cellSize(cellSize)
+{
+    int size = 1;
+    while (size < buckets)
+        size *= 2;
+    _buckets.assign(size, NULL_PROXY);
+}
+
+int HashGrid::insert(const AABB &bounds, void *userData)
+{
+    int proxy;
+    if (_freeList == NULL_PROXY)
+    {
+        proxy = _proxies.size();
+        _proxies.emplace_back();
+    }
+    else
+    {
+        proxy = _freeList;
+        _freeList = _proxies[proxy].next;
+        _proxies[proxy] = Proxy();
+    }
+
+    Proxy &entry = _proxies[proxy];
+    entry.bounds = bounds;
+    entry.userData = userData;
+    entry.cell = getCell(bounds.getCenter());
+    _maxExtents = glm::max(_maxExtents, bounds.getExtents());
+    _extent = _proxyCount == 0 ? bounds : _extent.merged(bounds);
+    link(proxy);
+
+    _proxyCount++;
+    return proxy;
+}
+
+void HashGrid::update(int proxy, const AABB &bounds)
+{
+    Proxy &entry = _proxies[proxy];
+    entry.bounds = bounds;
+    _maxExtents = glm::max(_maxExtents, bounds.getExtents());
+    _extent = _extent.merged(bounds);
+
+    glm::ivec3 cell = getCell(bounds.getCenter());
+    if (cell == entry.cell)
+        return;
+
+    unlink(proxy);
+    entry.cell = cell;
+    link(proxy);
+}
+
+void HashGrid::remove(int proxy)
+{
+    unlink(proxy);
+    _proxies[proxy].bucket = -1;
+    _proxies[proxy].next = _freeList;
+    _freeList = proxy;
+    _proxyCount--;
+}
+
+void HashGrid::clear()
+{
+    std::fill(_buckets.begin(), _buckets.end(), NULL_PROXY);
+    _proxies.clear();
+    _freeList = NULL_PROXY;
+    _proxyCount = 0;
+    _maxExtents = glm::vec3(0.0f);
+    _extent = AABB();
+}
+
+void *HashGrid::getUserData(int proxy) const { return _proxies[proxy].userData; }
+int HashGrid::getProxyCount() const { return _proxyCount; }
+
+glm::ivec3 HashGrid::getCell(const glm::vec3 &position) const
+{
+    return glm::ivec3(glm::floor(position / _cellSize));
+}
+
+int HashGrid::getBucket(const glm::ivec3 &cell) const
+{
+    unsigned int hash = (unsigned int)cell.x * 73856093u ^ (unsigned int)cell.y * 19349663u ^ (unsigned int)cell.z * 83492791u;
+    return hash & (_buckets.size() - 1);
+}
+
+void HashGrid::link(int proxy)
+{
+    Proxy &entry = _proxies[proxy];
+    entry.bucket = getBucket(entry.cell);
+    entry.previous = NULL_PROXY;
+    entry.next = _buckets[entry.bucket];
+    if (entry.next != NULL_PROXY)
+        _proxies[entry.next].previous = proxy;
+    _buckets[entry.bucket] = proxy;
+}
+
+void HashGrid::unlink(int proxy)
+{
+    Proxy &entry = _proxies[proxy];
+    if (entry.previous != NULL_PROXY)
+        _proxies[entry.previous].next = entry.next;
+    else
+        _buckets[entry.bucket] = entry.next;
+    if (entry.next != NULL_PROXY)
+        _proxies[entry.next].previous = entry.previous;
+}
+
+double HashGrid::getCellCount(const AABB &region) const
+{
+    // In doubles, infinite regions stay infinite
+    glm::dvec3 first = glm::floor(glm::dvec3(region.min - _maxExtents) / (double)_cellSize);
+    glm::dvec3 last = glm::floor(glm::dvec3(region.max + _maxExtents) / (double)_cellSize);
+    glm::dvec3 size = last - first + 1.0;
+    return size.x * size.y * size.z;
+}
+
+template <typename Visit>
+void HashGrid::forEachCandidate(const AABB &region, Visit visit) const
+{
+    if (getCellCount(region) <= _proxyCount)
+    {
+        forEachInCells(getCell(region.min - _maxExtents), getCell(region.max + _maxExtents), visit);
+        return;
+    }
+
+    for (int proxy = 0; proxy < (int)_proxies.size(); proxy++)
+        if (_proxies[proxy].bucket >= 0)
+            visit(proxy);
+}
+
+template <typename Visit>
+void HashGrid::forEachInCells(const glm::ivec3 &first, const glm::ivec3 &last, Visit visit) const
+{
+    // Cells of different positions share buckets, the cell check keeps each proxy to the one it is in
+    for (int z = first.z; z <= last.z; z++)
+        for (int y = first.y; y <= last.y; y++)
+            for (int x = first.x; x <= last.x; x++)
+            {
+                glm::ivec3 cell(x, y, z);
+                for (int proxy = _buckets[getBucket(cell)]; proxy != NULL_PROXY; proxy = _proxies[proxy].next)
+                    if (_proxies[proxy].cell == cell)
+                        visit(proxy);
+            }
+}
+
+void HashGrid::queryFrustum(const Frustum &frustum, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    forEachCandidate(frustum.getBounds(), [&](int proxy)
+                     {
+        if (frustum.intersects(_proxies[proxy].bounds))
+            proxies.push_back(proxy); });
+}
+
+void HashGrid::querySphere(const glm::vec3 &center, float radius, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    forEachCandidate({center - radius, center + radius}, [&](int proxy)
+                     {
+        if (_proxies[proxy].bounds.distanceSquared(center) <= radius * radius)
+            proxies.push_back(proxy); });
+}
+
+void HashGrid::findNearest(const glm::vec3 &point, int count, std::vector<int> &proxies) const
+{
+    proxies.clear();
+    if (_proxyCount == 0 || count <= 0)
+        return;
+
+    // Max heap of the best found so far, kept per thread so repeated queries do not allocate
+    thread_local std::vector<std::pair<float, int>> nearest;
+
+    // Grows the searched sphere until it holds enough proxies, once it covers everything the scan finds them all
+    for (float radius = _cellSize;; radius *= 2.0f)
+    {
+        nearest.clear();
+        bool everything = false;
+        AABB region = {point - radius, point + radius};
+        if (getCellCount(region) > _proxyCount)
+        {
+            everything = true;
+            radius = INFINITY;
+        }
+
+        forEachCandidate(region, [&](int proxy)
+                         {
+            float distance = _proxies[proxy].bounds.distanceSquared(point);
+            if (distance > radius * radius)
+                return;
+
+            nearest.push_back({distance, proxy});
+            std::push_heap(nearest.begin(), nearest.end());
+            if ((int)nearest.size() > count)
+            {
+                std::pop_heap(nearest.begin(), nearest.end());
+                nearest.pop_back();
+            } });
+
+        if ((int)nearest.size() == count || everything)
+            break;
+    }
+
+    std::sort_heap(nearest.begin(), nearest.end());
+    for (const std::pair<float, int> &entry : nearest)
+        proxies.push_back(entry.second);
+}
+
+RayHit HashGrid::raycast(const Ray &ray, float maxDistance, const RayTest &test) const
+{
+    RayHit hit;
+    float closest = maxDistance;
+
+    auto visit = [&](int proxy)
+    {
+        float distance;
+        if (!ray.intersects(_proxies[proxy].bounds, closest, distance))
+            return;
+
+        float hitDistance = test ? test(proxy, distance) : distance;
+        if (hitDistance >= 0.0f && hitDistance <= closest)
+        {
+            closest = hitDistance;
+            hit = {proxy, hitDistance};
+        }
+    };
+
+    // Every hit is inside the extent, the walk covers the part of the ray within it
+    glm::vec3 inverse = 1.0f / ray.direction;
+    glm::vec3 t1 = (_extent.min - ray.origin) * inverse;
+    glm::vec3 t2 = (_extent.max - ray.origin) * inverse;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+    if (_proxyCount == 0 || enter > exit)
+        return hit;
+
+    // A box hit at some point belongs to a proxy at most reach cells away from the cell of that point
+    glm::ivec3 reach = glm::ivec3(glm::ceil(_maxExtents / _cellSize));
+    glm::vec3 side = glm::vec3(reach * 2 + 1);
+    if (side.x * side.y * side.z > _proxyCount)
+    {
+        for (int proxy = 0; proxy < (int)_proxies.size(); proxy++)
+            if (_proxies[proxy].bucket >= 0)
+                visit(proxy);
+        return hit;
+    }
+
+    // Walks the cells the ray passes through, every step only visits the slice of cells its neighbourhood gained
+    glm::vec3 start = ray.at(enter);
+    glm::ivec3 cell = getCell(start);
+    glm::ivec3 step;
+    glm::vec3 next;
+    glm::vec3 delta;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float direction = ray.direction[axis];
+        step[axis] = direction > 0.0f ? 1 : (direction < 0.0f ? -1 : 0);
+        if (step[axis] == 0)
+        {
+            next[axis] = INFINITY;
+            delta[axis] = INFINITY;
+            continue;
+        }
+
+        float boundary = (cell[axis] + (step[axis] > 0 ? 1 : 0)) * _cellSize;
+        next[axis] = enter + (boundary - start[axis]) * inverse[axis];
+        delta[axis] = _cellSize * std::abs(inverse[axis]);
+    }
+
+    forEachInCells(cell - reach, cell + reach, visit);
+    while (true)
+    {
+        int axis = next.x < next.y && next.x < next.z ? 0 : (next.y < next.z ? 1 : 2);
+        if (next[axis] > exit || next[axis] > closest)
+            break;
+
+        cell[axis] += step[axis];
+        next[axis] += delta[axis];
+
+        glm::ivec3 first = cell - reach;
+        glm::ivec3 last = cell + reach;
+        first[axis] = last[axis] = cell[axis] + step[axis] * reach[axis];
+        forEachInCells(first, last, visit);
+    }
+
+    return hit;
+}
+
+void HashGrid::raycast(const Ray *rays, int count, float maxDistance, RayHit *hits) const
+{
+    for (int i = 0; i < count; i++)
+        hits[i] = raycast(rays[i], maxDistance);
+}
+
+void HashGrid::imguiDraw()
+{
+    int used = 0;
+    int longest = 0;
+    for (int head : _buckets)
+    {
+        int length = 0;
+        for (int proxy = head; proxy != NULL_PROXY; proxy = _proxies[proxy].next)
+            length++;
+        used += length > 0;
+        longest = std::max(longest, length);
+    }
+
+    ImGui::Text("Proxies: %d, cell size: %.1f", _proxyCount, _cellSize);
+    ImGui::Text("Buckets used: %d / %d, longest: %d", used, (int)_buckets.size(), longest);
+    ImGui::Text("Max extents: %.1f, %.1f, %.1f", _maxExtents.x, _maxExtents.y, _maxExtents.z);
+}
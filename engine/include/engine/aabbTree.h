@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include "spatialIndex.h"
+
+// Dynamic bounding volume hierarchy, leaves are the proxies. Inserting walks down to the sibling that grows the
+// tree the least and rotations keep it balanced. Leaves keep their box fattened by a margin, a moving proxy only
+// touches the tree once it leaves it, then it is reinserted and both paths to the root are refit
+class AabbTree : public SpatialIndex
+{
+public:
+    // Deeper than any balanced tree gets
+    static constexpr int STACK_SIZE = 256;
+
+    AabbTree(const AabbTree &) = delete;
+    AabbTree &operator=(const AabbTree &) = delete;
+    AabbTree(float margin = 0.2f);
+
+    int insert(const AABB &bounds, void *userData) override;
+    // Rebuilds the tree when adding at least as many proxies as it has
+    void insert(int count, const AABB *bounds, void *const *userData, int *proxies) override;
+    void update(int proxy, const AABB &bounds) override;
+    void remove(int proxy) override;
+    void clear() override;
+    // Top down, splits at the median of the longest axis of the centers
+    void rebuild() override;
+
+    void *getUserData(int proxy) const override;
+    int getProxyCount() const override;
+    // Fattened
+    const AABB &getBounds(int proxy) const;
+    int getHeight() const;
+
+    void queryFrustum(const Frustum &frustum, std::vector<int> &proxies) const override;
+    void querySphere(const glm::vec3 &center, float radius, std::vector<int> &proxies) const override;
+    void findNearest(const glm::vec3 &point, int count, std::vector<int> &proxies) const override;
+    RayHit raycast(const Ray &ray, float maxDistance, const RayTest &test = nullptr) const override;
+    // Packets of rays traverse the tree together, each node is tested against all of them at once
+    void raycast(const Ray *rays, int count, float maxDistance, RayHit *hits) const override;
+
+    void imguiDraw() override;
+
+private:
+    static constexpr int NULL_NODE = -1;
+
+    struct Node
+    {
+        AABB bounds;
+        void *userData = nullptr;
+        // Next free node once freed
+        int parent = NULL_NODE;
+        int children[2] = {NULL_NODE, NULL_NODE};
+        // Leaves are 0, free nodes -1
+        int height = 0;
+
+        bool isLeaf() const { return children[0] == NULL_NODE; }
+    };
+
+    struct BuildLeaf
+    {
+        glm::vec3 center;
+        int node;
+    };
+
+    float _margin;
+    std::vector<Node> _nodes;
+    int _root = NULL_NODE;
+    int _freeList = NULL_NODE;
+    int _proxyCount = 0;
+    // Since the last imguiDraw()
+    int _reinserted = 0;
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // Walks up from node fixing heights and boxes, rotating where a side got too deep
+    void refit(int node);
+    // Returns the node now at its place
+    int balance(int node);
+    // Returns the root of the subtree over the leaves, reorders them
+    int build(BuildLeaf *leaves, int count);
+
+    // Up to four rays
+    void raycastPacket(const Ray *rays, int count, float maxDistance, RayHit *hits) const;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Counts heap allocations made through the global operator new, each one goes to the innermost scope open on the
+// allocating thread. Profiler CPU scopes open one, so allocations show up per subsystem in the overlay
+// The hooks are only built with ENGINE_TRACK_ALLOCATIONS, otherwise every count stays at zero
+class AllocationTracker
+{
+public:
+    static constexpr int MAX_SCOPES = 64;
+
+    struct Stats
+    {
+        const char *name;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    AllocationTracker() = delete;
+
+    static bool isEnabled();
+
+    // Names are expected to be string literals, scopes nest per thread
+    static void beginScope(const char *name);
+    static void endScope();
+
+    // Closes the frame, the counts since the previous call become the last frame's
+    static void endFrame();
+    // Scopes that allocated in the last frame, allocations outside any scope are listed first
+    static void getFrameStats(std::vector<Stats> &stats);
+    static uint64_t getFrameCount();
+    static uint64_t getFrameBytes();
+
+    // From the operator new replacements
+    static void record(size_t size);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 getCenter() const;
+    glm::vec3 getExtents() const;
+    // Half the surface area, ranks candidate parents in the spatial index
+    float getPerimeter() const;
+
+    bool contains(const AABB &box) const;
+    bool overlaps(const AABB &box) const;
+    AABB merged(const AABB &box) const;
+    // Zero inside
+    float distanceSquared(const glm::vec3 &point) const;
+
+    // Box around this one once transformed, slightly bigger than the transformed corners under rotation
+    AABB transformed(const glm::mat4 &matrix) const;
+};
+
+struct Ray
+{
+    glm::vec3 origin = glm::vec3(0.0f);
+    // Normalized, distances are measured along it
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+
+    glm::vec3 at(float distance) const;
+    // Distance where the ray enters the box, zero when it starts inside
+    bool intersects(const AABB &box, float maxDistance, float &distance) const;
+    // Moller Trumbore, counts hits on both faces
+    bool intersects(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float maxDistance, float &distance) const;
+};
+
+// Clip planes of a view projection matrix, normals point inside
+struct Frustum
+{
+    enum Plane
+    {
+        LEFT_PLANE,
+        RIGHT_PLANE,
+        BOTTOM_PLANE,
+        TOP_PLANE,
+        NEAR_PLANE,
+        FAR_PLANE,
+    };
+
+    glm::vec4 planes[6];
+
+    Frustum(const glm::mat4 &viewProjection);
+
+    // Conservative, boxes near the corners may pass while being outside
+    // Depth clamped passes ignore the near plane so casters behind it are kept
+    bool intersects(const AABB &box, bool ignoreNear = false) const;
+    // Around the eight corners where the planes meet
+    AABB getBounds() const;
+};
@@ -13,8 +13,10 @@ public:
 
     glm::mat4 getViewMatrix() const;
     glm::mat4 getProjectionMatrix() const;
+    // Through a point of the window in pixels, from the near plane
+    Ray getScreenRay(const glm::vec2 &position) const;
 
-    void setUniforms(Shader &shader) const;
+    void setUniforms(const Shader &shader) const;
     void setActive();
 
 private:
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for data that only lives until the end of the frame, allocating is a bump of an offset and
+// freeing is reset(). Safe to allocate from several threads, when it runs out the rest of the frame falls back to
+// the heap and the next reset() grows it to what the frame needed
+class FrameArena
+{
+public:
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+    FrameArena(size_t capacity = 1 << 20);
+    ~FrameArena();
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    // Uninitialized, never destroyed
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena memory is released without running destructors");
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Everything allocated since the last reset is invalid afterwards, nothing may be allocating meanwhile
+    void reset();
+
+    size_t getUsed() const;
+    size_t getCapacity() const;
+    // Bytes that did not fit since the last reset
+    size_t getOverflow() const;
+
+private:
+    std::unique_ptr<std::byte[]> _memory;
+    size_t _capacity;
+    std::atomic<size_t> _used = 0;
+
+    struct OverflowBlock
+    {
+        void *memory;
+        size_t alignment;
+    };
+
+    mutable std::mutex _overflowMutex;
+    std::vector<OverflowBlock> _overflowBlocks;
+    size_t _overflow = 0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Profiler;
+
+enum CaptureFormat
+{
+    // One file per frame in a directory, named after the frame so dropped frames leave gaps
+    CAPTURE_PNG,
+    // Every frame in one uncompressed 4:2:0 stream
+    CAPTURE_Y4M,
+};
+
+// Reads rendered frames back through a ring of pixel buffers with a fence each and hands them to encoder threads of
+// its own, the job system's workers are left to the frame. Frames waiting for an encoder are bounded, past that new
+// frames are dropped, or the render thread waits for room when every frame must be kept
+class FrameCapture
+{
+public:
+    static constexpr int READBACK_BUFFERS = 3;
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+    // The path is a directory for PNG and a file for Y4M, the frame rate is only written to Y4M headers
+    FrameCapture(Profiler &profiler, CaptureFormat format, const std::string &path, int frameRate, int encoderCount = 2,
+                 int maxQueuedFrames = 8);
+    // Waits for the frames read so far to be written
+    ~FrameCapture();
+
+    // Waits for room instead of dropping, the game then runs at the pace the encoders sustain
+    bool keepEveryFrame = false;
+
+    // Thread owning the context, reads the back buffer of the frame just drawn
+    void capture(const glm::ivec2 &size);
+
+    // Frames handed to the encoders
+    int getCapturedCount() const;
+    int getDroppedCount() const;
+
+    void imguiDraw();
+
+private:
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsizeiptr capacity = 0;
+        // Null while the buffer is free
+        GLsync fence = nullptr;
+        glm::ivec2 size = glm::ivec2(0);
+        int frame = 0;
+    };
+
+    struct Frame
+    {
+        // RGBA rows from the bottom up, as read
+        std::vector<unsigned char> pixels;
+        // Encoder scratch, kept with the frame so steady state capture does not allocate
+        std::vector<unsigned char> converted;
+        std::vector<unsigned char> compressed;
+        glm::ivec2 size = glm::ivec2(0);
+        int frame = 0;
+        // Order among the frames handed over, the Y4M stream is written in it
+        int sequence = 0;
+    };
+
+    Profiler &_profiler;
+    const CaptureFormat _format;
+    const std::string _path;
+    const int _frameRate;
+
+    Readback _readbacks[READBACK_BUFFERS];
+    // Oldest in flight once the ring is full
+    int _next = 0;
+    int _frame = 0;
+    int _sequence = 0;
+    std::atomic<int> _captured = 0;
+    std::atomic<int> _dropped = 0;
+
+    std::vector<std::unique_ptr<Frame>> _frames;
+    std::vector<Frame *> _freeFrames;
+    std::deque<Frame *> _queue;
+    std::vector<std::thread> _encoders;
+    std::mutex _mutex;
+    std::condition_variable _queued;
+    std::condition_variable _room;
+    bool _quit = false;
+
+    // Y4M stream, written by whichever encoder holds the next frame in sequence
+    std::mutex _streamMutex;
+    std::FILE *_stream = nullptr;
+    glm::ivec2 _streamSize = glm::ivec2(0);
+    int _nextWrite = 0;
+    std::condition_variable _written;
+
+    // Milliseconds, averaged
+    float _overhead = 0.0f;
+    std::atomic<float> _encodeTime = 0.0f;
+
+    // Oldest first, stops at the first one the GPU has not finished unless waiting
+    void collect(bool wait);
+    // Copies the mapped pixels into a free frame and queues it, dropped without one unless every frame is kept
+    void retire(Readback &readback);
+    void encoderLoop();
+    bool writePng(Frame &frame);
+    bool writeY4m(Frame &frame);
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+
+// Caps the main loop to a frame rate and measures its frame times. The limiter sleeps through most of the wait
+// and spins the end of it, sleeps alone overshoot by up to a scheduler tick
+class FramePacer
+{
+public:
+    static constexpr int HISTORY = 240;
+    // Frames averaged by the smoothed delta time
+    static constexpr int SMOOTHING = 8;
+    static constexpr int BINS = 32;
+    // Width of a histogram bin around the mean frame time
+    static constexpr float BIN_MILLISECONDS = 0.5f;
+    // Deltas are clamped to this after hitches so the simulation does not jump
+    static constexpr float MAX_DELTA_TIME = 0.1f;
+
+    FramePacer() = default;
+    FramePacer(const FramePacer &) = delete;
+    FramePacer &operator=(const FramePacer &) = delete;
+
+    // Frames per second, zero runs uncapped
+    int frameLimit = 0;
+    bool smoothDeltaTime = true;
+
+    // Waits for the next frame's slot, returns right away when uncapped or late
+    void wait();
+    // Measures the time since the previous call, at the start of each frame
+    void beginFrame();
+
+    // Smoothed unless smoothDeltaTime is off, in seconds
+    float getDeltaTime() const;
+    float getRawDeltaTime() const;
+
+    void imguiDraw();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point _lastFrame;
+    Clock::time_point _nextFrame;
+
+    float _rawDeltaTime = 0.0f;
+    float _smoothedDeltaTime = 0.0f;
+    float _recent[SMOOTHING] = {};
+
+    // Milliseconds, ring indexed by _frames
+    float _history[HISTORY] = {};
+    unsigned long long _frames = 0;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <optional>
+#include <vector>
+
+#include "imgui.h"
+
+#include "camera.h"
+#include "light.h"
+#include "materialRegistry.h"
+#include "renderer.h"
+
+// Everything the renderer needs from one simulated frame, copied out on the main thread so rendering never reads
+// live objects and the simulation can move on to the next frame meanwhile
+struct FramePacket
+{
+    FramePacket() = default;
+    FramePacket(const FramePacket &) = delete;
+    FramePacket &operator=(const FramePacket &) = delete;
+    ~FramePacket();
+
+    std::vector<DrawCommand> commands;
+    std::optional<Camera> camera;
+    // Point into the copies below, in the order of the game's lights
+    std::vector<Light *> lights;
+    // Palette entries changed since the previous packet, with the maps and flags drawing them needs
+    MaterialUpload materials;
+    glm::vec2 screenSize = glm::vec2(0.0f);
+    // First input event the frame reacted to, 0 when not measuring latency or without input
+    double inputTime = 0.0;
+    // A fence follows the swap, the input of the next frame waits for it
+    bool lowLatency = false;
+    // Pixel the pick pass reads around
+    std::optional<glm::ivec2> pickPixel;
+    // Draw lists copied out of ImGui, which reuses its own on the next frame
+    ImDrawData imguiData;
+
+    void copyLights(const std::vector<Light *> &source);
+    void copyImGuiData(const ImDrawData &data);
+    // Nothing drawn over the frame
+    void clearImGuiData();
+
+private:
+    std::vector<DirectionalLight> _directionalLights;
+    std::vector<PointLight> _pointLights;
+    std::vector<SpotLight> _spotLights;
+    // Kept between frames so copying them does not allocate once they are big enough
+    std::vector<ImDrawList *> _imguiLists;
+};
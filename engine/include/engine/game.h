@@ -1,73 +1,343 @@
 #pragma once
 
+#include <atomic>
+#include <cfloat>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 
-class Object;
+#include "frameArena.h"
+#include "frameCapture.h"
+#include "framePacer.h"
+#include "inputSystem.h"
+#include "inspector.h"
+#include "metricsExporter.h"
+#include "object.h"
+#include "objectPool.h"
+#include "renderer.h"
+#include "spatialIndex.h"
+
 class Camera;
+class JobSystem;
 class Light;
+class MaterialRegistry;
+class Profiler;
+struct FramePacket;
 
-struct MouseMove
+enum VsyncMode
 {
-    double prevXPos;
-    double prevYPos;
-
-    double xPos;
-    double yPos;
-
-    glm::vec2 delta;
+    VSYNC_OFF,
+    VSYNC_ON,
+    // Tears instead of waiting a whole refresh when a frame misses it, on when the driver does not support it
+    VSYNC_ADAPTIVE,
 };
 
-struct KeyInput
+struct GameSettings
 {
-    int key;
-    int scancode;
-    int action;
-    int mods;
+    RenderPath renderPath = RenderPath::FORWARD;
+    bool depthPrePass = false;
+    TransparencyMode transparencyMode = TransparencyMode::SORTED;
+    bool occlusionCulling = false;
+    bool softwareOcclusion = false;
+    bool gpuCulling = false;
+    // Renders the scene at the scale that keeps its GPU time under resolutionTarget milliseconds, then scales it
+    // up to the window
+    bool dynamicResolution = false;
+    float resolutionTarget = 16.0f;
+    float minResolutionScale = 0.5f;
+    float maxResolutionScale = 1.0f;
+    // 0 upscales bilinearly
+    float upscaleSharpness = 0.3f;
+    // The default framebuffer is never multisampled, MSAA goes through an offscreen target
+    AntiAliasingMode antiAliasing = AntiAliasingMode::AA_OFF;
+    int msaaSamples = 4;
+    // Zero uses every hardware thread
+    int threadCount = 0;
+    // Renders on its own thread from frame packets while the main thread simulates the next frame
+    bool renderThread = false;
+    // Packets the main thread may fill ahead of the one being rendered, 1 is double buffering
+    int renderLatency = 1;
+    // Reports every frame that still allocates from the heap once the game is warmed up
+    bool checkAllocations = false;
+    // Unaccelerated mouse motion while the cursor is disabled, when the platform supports it
+    bool rawMouseMotion = true;
+    // Waits for each frame with input to finish after the swap and shows the time since its first input event
+    bool measureInputLatency = false;
+    VsyncMode vsyncMode = VsyncMode::VSYNC_ON;
+    // Frames per second, zero runs uncapped
+    int frameLimit = 0;
+    // Delta time averaged over the last few frames instead of the raw gap between them
+    bool smoothDeltaTime = true;
+    // Waits for the GPU to finish the previous frame before polling input, nothing is queued behind it
+    bool lowLatency = false;
+    // Polls input again once the frame is built and lets the camera apply it right before its view is copied
+    bool lateLatch = false;
+    // Updates per second, run as many times a frame as the time elapsed needs with a fixed delta time, zero
+    // updates once per frame with the frame's delta time
+    int fixedUpdateRate = 0;
+    // Fixed updates a frame may run to catch up, lag past them is dropped and the game slows down instead
+    int maxFixedUpdates = 5;
+    // Renders transforms blended between the last two fixed updates
+    bool interpolateTransforms = true;
+    SpatialIndexType spatialIndex = SpatialIndexType::AABB_TREE;
+    // Selects what is drawn under the cursor from a pick pass read back a frame or two later, instead of a raycast
+    bool gpuPicking = false;
+    // Reads the pick pass back right away, stalling until the GPU is done
+    bool syncPicking = false;
+    // The window is never shown, for recording runs on machines without a display to look at
+    bool headless = false;
+    // Records every rendered frame from the start, without ImGui, to capturePath
+    bool capture = false;
+    CaptureFormat captureFormat = CaptureFormat::CAPTURE_PNG;
+    // A directory for PNG, a file for Y4M
+    std::string capturePath = "capture";
+    // Closes the game once this many frames were captured, zero records until it is closed
+    int captureFrames = 0;
+    // Slows the game down to what the encoders keep up with instead of dropping frames
+    bool captureEveryFrame = false;
+    // ImGui is skipped altogether while hidden, F1 toggles it
+    bool showImGui = true;
+    // ImGui rebuilds per second, the last one is drawn again in between, zero rebuilds every frame
+    int imguiRate = 0;
+    // Megabytes of tracked resources past which a warning is printed, zero is unbounded
+    int gpuMemoryBudget = 0;
+    int systemMemoryBudget = 0;
+    // Every tracked resource per owner is written there as JSON once the game closes, empty writes nothing
+    std::string resourceDumpPath;
+    // Serves metrics to scrapers on "unix:<path>", "<host>:<port>" or "<port>", empty does not listen
+    std::string metricsAddress;
+    // Appended to every metricsLogInterval frames, CSV when it ends with .csv and JSON lines otherwise
+    std::string metricsLogPath;
+    int metricsLogInterval = 60;
 };
 
 class Game
 {
 public:
-    Game();
+    Game(const GameSettings &settings = GameSettings());
     ~Game();
 
     void run();
     void clear();
 
-    void addObject(std::unique_ptr<Object> object);
+    // Objects join the notifications at the end of the frame, spawn and add only from the main thread outside
+    // of notifications sent concurrently
+    ObjectHandle addObject(std::unique_ptr<Object> object);
+    // Constructed in the pool of its type, setup(object) runs before START
+    template <typename T, typename Setup>
+    ObjectHandle spawn(Setup setup)
+    {
+        ObjectPool<T> &pool = getPool<T>();
+        T *object = pool.create();
+        setup(*object);
+        return registerObject(object, &pool);
+    }
+    template <typename T>
+    ObjectHandle spawn()
+    {
+        return spawn<T>([](T &) {});
+    }
+    // Destroyed at the end of the frame once unregistered from the lights and the active camera, safe from any
+    // notification. Meshes and other GL resources it holds must outlive packets still being rendered
+    void despawn(ObjectHandle handle);
+
+    // Null once the object is destroyed
+    Object *get(ObjectHandle handle) const;
+    template <typename T>
+    T *get(ObjectHandle handle) const
+    {
+        return dynamic_cast<T *>(get(handle));
+    }
+    int getObjectCount() const;
+
+    // Objects with bounds as of the end of the last update, the user data of the proxies are the objects
+    SpatialIndex &getSpatialIndex() const;
+    // Closest object along the ray, tested against its geometry when precise or its box otherwise
+    Object *raycast(const Ray &ray, float maxDistance = FLT_MAX, float *distance = nullptr, bool precise = true) const;
+    // Last object clicked, the ray goes through the cursor or the middle of the screen while it is disabled. Outlined
+    ObjectHandle getSelected() const;
     void setCursorMode(int value) const;
 
     float getTime() const;
+    // Fixed with fixed updates, then the time advances by it for every update
     float getDeltaTime() const;
-    const KeyInput &getKeyInput() const;
-    const MouseMove &getMouseMove() const;
+    // Between the last two fixed updates, 1 without fixed updates
+    float getInterpolation() const;
+    InputSystem &getInput() const;
     const glm::vec2 &getScreenSize() const;
+    MaterialRegistry &getMaterials() const;
+    Renderer &getRenderer() const;
+    Profiler &getProfiler() const;
+    JobSystem &getJobs() const;
+    // Main thread only, everything allocated in it is released when the next frame starts. The game takes its
+    // own per frame scratch from it too
+    FrameArena &getFrameArena();
 
     Camera *activeCamera = nullptr;
     std::vector<Light *> lights;
 
 private:
+    friend class Object;
+
     bool initialized = false;
     GLFWwindow *_window = nullptr;
     GLuint _whiteTexture;
+    std::unique_ptr<MaterialRegistry> _materials;
+    std::unique_ptr<Profiler> _profiler;
+    std::unique_ptr<JobSystem> _jobs;
+    std::unique_ptr<Renderer> _renderer;
+
+    FrameArena _frameArena;
+    bool _checkAllocations = false;
+
+    bool _measureInputLatency = false;
+    // Written by the render side, in milliseconds
+    std::atomic<float> _inputLatency = 0.0f;
+    std::atomic<float> _averageInputLatency = 0.0f;
+
+    FramePacer _pacer;
+
+    int _fixedUpdateRate = 0;
+    int _maxFixedUpdates = 5;
+    bool _interpolateTransforms = true;
+    double _accumulator = 0.0;
+    float _interpolation = 1.0f;
+    int _fixedUpdatesLastFrame = 0;
+    unsigned long long _droppedFixedUpdates = 0;
+
+    bool _lowLatency = false;
+    bool _lateLatch = false;
+    // Placed after the swap of a low latency frame, waited on by the thread owning the context
+    GLsync _frameFence = nullptr;
+
+    // Started and stopped by the thread owning the context, the settings are changed with the render mutex held
+    std::unique_ptr<FrameCapture> _capture;
+    bool _capturing = false;
+    CaptureFormat _captureFormat = CaptureFormat::CAPTURE_PNG;
+    std::string _capturePath;
+    int _captureFrames = 0;
+    int _captureFrameRate = 60;
+    bool _captureEveryFrame = false;
+
+    std::string _resourceDumpPath;
+
+    // Null unless metrics are served or logged, they are not recorded then
+    std::unique_ptr<MetricsExporter> _metrics;
+    int _metricsLogInterval = 60;
+
+    Inspector _inspector;
+    bool _imguiVisible = true;
+    int _imguiRate = 0;
+    double _lastImGuiBuild = 0.0;
+    // Objects joined or left since ImGui was last built
+    bool _objectsChanged = true;
+
+    // Changed from ImGui, applied by the thread owning the context
+    std::atomic<VsyncMode> _vsyncMode = VsyncMode::VSYNC_ON;
+    std::optional<VsyncMode> _appliedVsyncMode;
+    std::atomic<bool> _adaptiveVsyncSupported = true;
+
+    bool _useRenderThread = false;
+    int _renderLatency = 1;
+    // Used when rendering on the main thread
+    std::unique_ptr<FramePacket> _packet;
+    // Held while rendering a packet and while ImGui reads or edits what the render thread uses
+    std::mutex _renderMutex;
+    glm::vec2 _renderedSize;
 
     float _time = 0.0f;
     float _deltaTime = 0.0f;
-    KeyInput _keyInput = {0};
-    MouseMove _mouseMove = {0};
+    std::unique_ptr<InputSystem> _input;
     glm::vec2 _screenSize = glm::vec2(800.0f, 600.0f);
 
-    std::vector<std::unique_ptr<Object>> _objects;
+    struct ObjectSlot
+    {
+        Object *object = nullptr;
+        // Null for added objects, which are deleted
+        ObjectPoolBase *pool = nullptr;
+        uint32_t generation = 1;
+    };
+
+    std::unordered_map<std::type_index, std::unique_ptr<ObjectPoolBase>> _pools;
+    std::vector<ObjectSlot> _slots;
+    std::vector<uint32_t> _freeSlots;
+
+    // In the order they were added until objects are despawned, the last one then takes the place of each
+    std::vector<Object *> _objects;
+    // Objects updated from worker threads, the rest are updated in order on the main thread
+    std::vector<Object *> _concurrentUpdates;
+    std::vector<Object *> _serialUpdates;
+
+    // Applied by flushObjects() at the end of the frame
+    std::vector<Object *> _spawned;
+    std::mutex _despawnMutex;
+    std::vector<ObjectHandle> _despawned;
+    std::vector<ObjectHandle> _destroying;
+    int _spawnedLastFrame = 0;
+    int _despawnedLastFrame = 0;
+
+    std::unique_ptr<SpatialIndex> _spatialIndex;
+    std::vector<Object *> _indexed;
+    // Objects given bounds once they had joined, inserted by flushObjects()
+    std::vector<Object *> _indexPending;
+    ObjectHandle _selected;
+    // Negative when picked on the GPU
+    float _selectedDistance = 0.0f;
+    bool _gpuPicking = false;
+    // Framebuffer pixel sent with the next packet
+    std::optional<glm::ivec2> _pickRequest;
+
+    template <typename T>
+    ObjectPool<T> &getPool()
+    {
+        std::unique_ptr<ObjectPoolBase> &pool = _pools[std::type_index(typeid(T))];
+        if (!pool)
+            pool = std::make_unique<ObjectPool<T>>();
+        return static_cast<ObjectPool<T> &>(*pool);
+    }
+
+    ObjectHandle registerObject(Object *object, ObjectPoolBase *pool);
+    void flushObjects();
+    void indexObject(Object *object);
+    void updateSpatialIndex();
+    void pick();
+    // Pick pass id of the object, 0 once it is past the slots an id can address
+    uint32_t getPickId(const Object *object) const;
+    // Null for ids of destroyed objects
+    Object *getPicked(uint32_t id) const;
+    void destroyObject(ObjectSlot &slot);
+    // Moves the last object of the list into its place and updates its position
+    static void removeFrom(std::vector<Object *> &list, int Object::*position, Object *object);
+
+    void update();
+    void fixedUpdate();
+    void storePreviousTransforms();
+    // Swaps in the interpolated transforms while the frame is extracted, then back the simulated ones
+    void beginInterpolation();
+    void endInterpolation();
+    bool isInterpolating() const;
 
     void registerCallbacks();
-    void render() const;
-    void imguiRender() const;
+    // Main thread side, copies out everything the renderer needs for this frame
+    void extract(FramePacket &packet);
+    // Thread owning the GL context
+    void renderPacket(FramePacket &packet);
+    void applyVsyncMode();
+    void updateCapture();
+    void updateMetrics();
+    void waitForGpu();
+    // Skipped while hidden, and between rebuilds when throttled
+    void imguiUpdate(FramePacket &packet);
+    void imguiBuild();
 
     static void framebufferSizeCallback(GLFWwindow *window, int width, int height);
     static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
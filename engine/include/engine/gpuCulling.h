@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "materialRegistry.h"
+#include "mesh.h"
+#include "shader.h"
+
+class Camera;
+class FrameArena;
+class Profiler;
+struct DrawCommand;
+
+// Opaque commands grouped into instanced batches and culled on the GPU, against the frustum and the farthest depth
+// pyramid of the previous frame. Instance transforms and bounds live in a texture buffer, a vertex pass with the
+// rasterizer off writes one visibility per instance through transform feedback and culled instances collapse in
+// vertex.vs (GPU_CULLED), so the CPU issues one draw per batch and never reads the results back
+class GpuCulling
+{
+public:
+    // Model matrix columns, then world bounds min (w = material handle) and max, must match cull.vs and vertex.vs
+    static constexpr int INSTANCE_TEXELS = 6;
+
+    struct Batch
+    {
+        const Mesh *mesh;
+        const Shader *shader;
+        // Of the first instance, every instance has a material with the same maps and its own palette entry
+        MaterialHandle material;
+        int first;
+        int count;
+    };
+
+    GpuCulling(const GpuCulling &) = delete;
+    GpuCulling &operator=(const GpuCulling &) = delete;
+    GpuCulling(const MaterialRegistry &materials, Profiler &profiler, FrameArena &arena, const glm::vec2 &size);
+    ~GpuCulling();
+
+    bool occlusionTest = true;
+    // Reads the results back and checks them against the CPU frustum test, stalls the pipeline
+    bool validate = false;
+
+    // Batches the commands by shader, material maps and mesh and runs the culling pass
+    void cull(const std::vector<const DrawCommand *> &commands, const Camera &camera);
+    const std::vector<Batch> &getBatches() const;
+    // For shaders built with GPU_CULLED, the caller draws batch.count instances
+    void bind(const Shader &shader, const Batch &batch) const;
+
+    // From the scene's depth once the opaque pass is done, tested against next frame. Rebinds the scene framebuffer
+    void buildDepthPyramid(GLuint sceneFramebuffer);
+    void resize(const glm::vec2 &size);
+
+    void imguiDraw();
+
+private:
+    const MaterialRegistry &_materials;
+    Profiler &_profiler;
+    FrameArena &_arena;
+    glm::ivec2 _size;
+
+    std::unique_ptr<Shader> _cullShader;
+    std::unique_ptr<Shader> _pyramidShader;
+
+    std::vector<const DrawCommand *> _sorted;
+    std::vector<Batch> _batches;
+    std::vector<glm::vec4> _instanceData;
+    int _capacity = 0;
+
+    GLuint _emptyVao = 0;
+    GLuint _instanceBuffer = 0;
+    GLuint _instanceTexture = 0;
+    GLuint _visibilityBuffer = 0;
+    GLuint _visibilityTexture = 0;
+
+    // Copy of the scene depth and its farthest depth mip chain
+    GLuint _depthFramebuffer = 0;
+    GLuint _depthCopy = 0;
+    GLuint _pyramidFramebuffer = 0;
+    GLuint _pyramid = 0;
+    int _pyramidLevels = 0;
+    bool _pyramidValid = false;
+
+    void reserve(int instances);
+    void validateResults(const Camera &camera);
+
+    void createPyramid();
+    void destroyPyramid();
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include "spatialIndex.h"
+
+// Loose uniform grid hashed into a fixed number of buckets, a proxy lives in the cell holding its center so moving
+// it is a relink at most. Queries widen their range by the largest half extent inserted so far, and fall back to
+// scanning every proxy when the range covers more cells than there are proxies
+class HashGrid : public SpatialIndex
+{
+public:
+    HashGrid(const HashGrid &) = delete;
+    HashGrid &operator=(const HashGrid &) = delete;
+    // Buckets are rounded up to a power of two
+    HashGrid(float cellSize = 4.0f, int buckets = 1 << 16);
+
+    using SpatialIndex::insert;
+    int insert(const AABB &bounds, void *userData) override;
+    void update(int proxy, const AABB &bounds) override;
+    void remove(int proxy) override;
+    void clear() override;
+
+    void *getUserData(int proxy) const override;
+    int getProxyCount() const override;
+
+    void queryFrustum(const Frustum &frustum, std::vector<int> &proxies) const override;
+    void querySphere(const glm::vec3 &center, float radius, std::vector<int> &proxies) const override;
+    void findNearest(const glm::vec3 &point, int count, std::vector<int> &proxies) const override;
+    RayHit raycast(const Ray &ray, float maxDistance, const RayTest &test = nullptr) const override;
+    void raycast(const Ray *rays, int count, float maxDistance, RayHit *hits) const override;
+
+    void imguiDraw() override;
+
+private:
+    static constexpr int NULL_PROXY = -1;
+
+    struct Proxy
+    {
+        AABB bounds;
+        void *userData = nullptr;
+        glm::ivec3 cell = glm::ivec3(0);
+        // -1 once removed
+        int bucket = -1;
+        // In the bucket, next is the next free proxy once removed
+        int previous = NULL_PROXY;
+        int next = NULL_PROXY;
+    };
+
+    float _cellSize;
+    std::vector<int> _buckets;
+    std::vector<Proxy> _proxies;
+    int _freeList = NULL_PROXY;
+    int _proxyCount = 0;
+    // Never shrinks, proxies may reach this far out of their cell
+    glm::vec3 _maxExtents = glm::vec3(0.0f);
+    // Around every box inserted since the grid was last empty, rays are clipped to it
+    AABB _extent;
+
+    glm::ivec3 getCell(const glm::vec3 &position) const;
+    int getBucket(const glm::ivec3 &cell) const;
+    // Cells a query of the region visits
+    double getCellCount(const AABB &region) const;
+    void link(int proxy);
+    void unlink(int proxy);
+
+    // Calls visit(proxy) once for every proxy whose box may overlap the region
+    template <typename Visit>
+    void forEachCandidate(const AABB &region, Visit visit) const;
+    // Calls visit(proxy) for every proxy living in the cells from first to last
+    template <typename Visit>
+    void forEachInCells(const glm::ivec3 &first, const glm::ivec3 &last, Visit visit) const;
+};
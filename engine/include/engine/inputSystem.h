@@ -0,0 +1,137 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+enum InputEventType
+{
+    KEY_EVENT,
+    MOUSE_BUTTON_EVENT,
+    MOUSE_MOVE_EVENT,
+    SCROLL_EVENT,
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    // Seconds on the glfwGetTime() clock, taken when GLFW delivered the event
+    double time;
+    // Key or mouse button
+    int code;
+    int action;
+    int mods;
+    // Cursor position or scroll offset
+    glm::vec2 value;
+};
+
+// Whether any key bound to an action is held, and whether one went down or up since the previous update
+struct ActionState
+{
+    bool down = false;
+    bool pressed = false;
+    bool released = false;
+};
+
+// Collects the GLFW callbacks into a fixed ring of timestamped events and turns them into a state snapshot for
+// every update, so objects poll what they need in their update instead of being notified for every event. With
+// fixed updates a frame may run several updates or none, code running once per frame reads the frame's own edges
+class InputSystem
+{
+public:
+    static constexpr int CAPACITY = 256;
+    static constexpr int MAX_ACTIONS = 32;
+
+    InputSystem(const InputSystem &) = delete;
+    InputSystem &operator=(const InputSystem &) = delete;
+    InputSystem(GLFWwindow *window, bool rawMouseMotion);
+
+    // From the GLFW callbacks, the state stays right even when the ring overflows
+    void push(const InputEvent &event);
+    // Snapshots the events and presses that arrived since the previous frame, once per frame right after
+    // glfwPollEvents
+    void beginFrame();
+    // Snapshots what arrived since the previous update, before every update
+    void beginUpdate();
+    // Takes the motion that arrived since beginUpdate(), after polling again late in the frame, it is not part
+    // of the next update's delta
+    void latch();
+
+    // Disabled cursors use raw mouse motion when it is supported and asked for
+    void setCursorMode(int mode);
+    bool usesRawMouseMotion() const;
+    int getCursorMode() const;
+
+    // Action ids are shared by the whole game, several keys may be bound to one
+    void bind(int action, int key);
+    ActionState getAction(int action) const;
+
+    bool isKeyDown(int key) const;
+    // Since the previous update
+    bool wasKeyPressed(int key) const;
+    // Since the previous frame, whatever number of updates it ran
+    bool wasKeyPressedThisFrame(int key) const;
+    bool isMouseButtonDown(int button) const;
+    bool wasMouseButtonPressed(int button) const;
+    bool wasMouseButtonPressedThisFrame(int button) const;
+    glm::vec2 getMousePosition() const;
+    // Motion summed over the update's events
+    glm::vec2 getMouseDelta() const;
+    // Motion taken by latch() this frame
+    glm::vec2 getLatchedMouseDelta() const;
+    glm::vec2 getScroll() const;
+
+    // Events of this frame in arrival order, the oldest are lost past CAPACITY
+    int getEventCount() const;
+    const InputEvent &getEvent(int index) const;
+    // Time of the frame's first event, 0 without any
+    double getOldestEventTime() const;
+    int getDroppedCount() const;
+
+private:
+    struct Binding
+    {
+        int action;
+        int key;
+    };
+
+    GLFWwindow *_window;
+    bool _rawMouseMotion;
+    int _cursorMode = GLFW_CURSOR_NORMAL;
+
+    InputEvent _events[CAPACITY];
+    // Total pushed, the ring index is this modulo CAPACITY
+    unsigned long long _pushed = 0;
+    unsigned long long _frameBegin = 0;
+    unsigned long long _frameEnd = 0;
+    int _dropped = 0;
+
+    // Written by push(), the edges since the previous update and since the previous frame
+    bool _keys[GLFW_KEY_LAST + 1] = {};
+    bool _keysPressed[GLFW_KEY_LAST + 1] = {};
+    bool _keysReleased[GLFW_KEY_LAST + 1] = {};
+    bool _keysPressedSinceFrame[GLFW_KEY_LAST + 1] = {};
+    bool _buttons[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    bool _buttonsPressed[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    bool _buttonsPressedSinceFrame[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    glm::vec2 _position = glm::vec2(0.0f);
+    glm::vec2 _delta = glm::vec2(0.0f);
+    glm::vec2 _scroll = glm::vec2(0.0f);
+    bool _hasPosition = false;
+
+    // Snapshot of the update
+    bool _updateKeysPressed[GLFW_KEY_LAST + 1] = {};
+    bool _updateKeysReleased[GLFW_KEY_LAST + 1] = {};
+    bool _updateButtonsPressed[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    glm::vec2 _updateDelta = glm::vec2(0.0f);
+    glm::vec2 _updateScroll = glm::vec2(0.0f);
+
+    // Snapshot of the frame
+    bool _frameKeysPressed[GLFW_KEY_LAST + 1] = {};
+    bool _frameButtonsPressed[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    glm::vec2 _latchedDelta = glm::vec2(0.0f);
+
+    std::vector<Binding> _bindings;
+
+    void applyCursorMode();
+};
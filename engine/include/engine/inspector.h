@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "imgui.h"
+
+#include "object.h"
+
+// Lists the objects of the game through a clipper, only the rows in view are submitted whatever the object count.
+// Filtering by name and type is cached and refreshed a few times a second at most while objects come and go, and
+// only the selected object gets IMGUI_DRAW
+class Inspector
+{
+public:
+    Inspector(const Inspector &) = delete;
+    Inspector &operator=(const Inspector &) = delete;
+    Inspector() = default;
+
+    // Inside a window, objectsChanged tells that objects joined or left since the last call
+    void draw(Game &game, const std::vector<Object *> &objects, bool objectsChanged, ObjectHandle &selected);
+
+private:
+    // Seconds between refreshes caused by objects joining or leaving, filter edits refresh right away
+    static constexpr double REFRESH_INTERVAL = 0.25;
+
+    ImGuiTextFilter _filter;
+    // Into _types, -1 lists every type
+    int _type = -1;
+    std::vector<std::type_index> _types;
+    std::unordered_map<std::type_index, std::string> _typeNames;
+    // Objects passing the filter as of the last refresh, handles since some may be destroyed since
+    std::vector<ObjectHandle> _rows;
+    bool _dirty = true;
+    bool _stale = false;
+    double _lastRefresh = 0.0;
+
+    bool isFiltering() const;
+    void refresh(const std::vector<Object *> &objects);
+    const std::string &getTypeName(const Object &object);
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// Jobs of a group still to finish, jobs can wait on counters before they start
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    bool isDone() const;
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> _pending = 0;
+    // Jobs waiting on this counter, released when it reaches zero
+    std::mutex _mutex;
+    std::vector<Job *> _waiting;
+};
+
+// Fixed pool of workers with one deque each, a thread pushes and pops its own jobs at the back and idle threads
+// steal from the front of the others. Threads that wait on a counter run jobs meanwhile
+class JobSystem
+{
+public:
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    // Zero uses every hardware thread, the thread creating the system counts as one
+    JobSystem(int threadCount = 0);
+    ~JobSystem();
+
+    // Workers plus the creating thread
+    int getThreadCount() const;
+
+    // The counter, if any, is done once the job has run, the job only starts when every dependency is done
+    void run(std::function<void()> function, JobCounter *counter = nullptr, const std::vector<JobCounter *> &dependencies = {});
+    void wait(JobCounter &counter);
+
+    // Calls function(begin, end) over [0, count) in chunks of at most chunkSize and waits for all of them
+    template <typename Function>
+    void parallelFor(int count, int chunkSize, Function function)
+    {
+        chunkSize = std::max(chunkSize, 1);
+        if (count <= chunkSize || _queues.size() == 1)
+        {
+            function(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        for (int begin = 0; begin < count; begin += chunkSize)
+        {
+            int end = std::min(begin + chunkSize, count);
+            run([&function, begin, end]
+                { function(begin, end); },
+                &counter);
+        }
+        wait(counter);
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job *> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+
+    // Finished jobs kept for reuse, steady state submission does not allocate
+    std::mutex _poolMutex;
+    std::vector<Job *> _freeJobs;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+    std::atomic<int> _queued = 0;
+    std::atomic<bool> _quit = false;
+
+    Job *acquireJob(std::function<void()> function, JobCounter *counter);
+    void enqueue(Job *job);
+    Job *take(int index);
+    void execute(Job *job);
+    void finish(JobCounter &counter);
+    void workerLoop(int index);
+    int getQueueIndex() const;
+};
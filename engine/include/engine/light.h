@@ -18,7 +18,11 @@ public:
     glm::vec3 diffuse = glm::vec3(0.0f);
     glm::vec3 specular = glm::vec3(0.0f);
 
-    virtual void setUniforms(Shader &shader) const;
+    bool castsShadows = false;
+    // First tile of this light in the renderer's shadow atlas, -1 when it has none this frame
+    int shadowTile = -1;
+
+    virtual void setUniforms(const Shader &shader) const;
     static void resetCounters();
 };
 
@@ -28,7 +32,7 @@ public:
     // TODO: have some kind of light manager
     static int count;
 
-    void setUniforms(Shader &shader) const override;
+    void setUniforms(const Shader &shader) const override;
 };
 
 class PointLight : public Light
@@ -41,7 +45,10 @@ public:
     float linear = 0.09f;
     float quadratic = 0.6f;
 
-    void setUniforms(Shader &shader) const override;
+    // Distance where the brightest channel falls under 5/256
+    float getRange() const;
+
+    void setUniforms(const Shader &shader) const override;
 };
 
 class SpotLight : public PointLight
@@ -53,5 +60,5 @@ public:
     float cutOff = glm::radians(20.0f);
     float outerCutOff = glm::radians(45.0f);
 
-    void setUniforms(Shader &shader) const override;
+    void setUniforms(const Shader &shader) const override;
 };
\ No newline at end of file
@@ -4,7 +4,6 @@
 #include <memory>
 #include <string>
 
-#include "shader.h"
 #include "texture.h"
 
 struct Material
@@ -19,6 +18,4 @@ struct Material
     std::shared_ptr<Texture> diffuseMap = nullptr;
     std::shared_ptr<Texture> specularMap = nullptr;
     std::shared_ptr<Texture> emissionMap = nullptr;
-
-    void setUniforms(Shader &shader) const;
 };
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "material.h"
+#include "shader.h"
+
+// Index into the material palette, this is all a draw needs to carry
+using MaterialHandle = unsigned int;
+
+// GPU side layout of a material, must match MaterialData in the shaders (std140)
+struct MaterialData
+{
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular; // w = shininess
+    glm::vec4 emission;
+};
+
+// What drawing a material needs besides its palette entry
+struct MaterialState
+{
+    std::shared_ptr<Texture> diffuseMap;
+    std::shared_ptr<Texture> specularMap;
+    std::shared_ptr<Texture> emissionMap;
+    bool transparent = false;
+    bool alphaTest = false;
+};
+
+// Dirty range of the palette copied out for the thread that owns the GL context
+struct MaterialUpload
+{
+    unsigned int begin = 0;
+    std::vector<MaterialData> data;
+    std::vector<MaterialState> states;
+};
+
+// The main thread edits the palette, drawing only reads the copy of it the uploads brought to the thread that
+// owns the GL context, which may be a frame or more behind
+class MaterialRegistry
+{
+public:
+    // 256 * sizeof(MaterialData) is exactly the 16KB minimum UBO size guaranteed by GL 3.3
+    static constexpr unsigned int MAX_MATERIALS = 256;
+
+    MaterialRegistry(const MaterialRegistry &) = delete;
+    MaterialRegistry &operator=(const MaterialRegistry &) = delete;
+    MaterialRegistry(GLuint fallbackTexture);
+    ~MaterialRegistry();
+
+    // Returns the handle of an identical material if there is one, otherwise adds it to the palette
+    MaterialHandle intern(const Material &material);
+    // Changes every draw using this handle, only the changed range is uploaded on the next frame
+    void update(MaterialHandle handle, const Material &material);
+
+    const Material &get(MaterialHandle handle) const;
+    unsigned int size() const;
+
+    // Uploads the dirty range of the palette
+    void upload();
+    // Same in two steps, the upload may then happen on another thread
+    void takeUpload(MaterialUpload &upload);
+    void upload(const MaterialUpload &upload);
+
+    // The rest reads the last upload, for the thread that owns the GL context only
+
+    // Needs blending, either from the diffuse alpha or a diffuse map with partial alpha. Cutout maps stay opaque
+    // and are alpha tested
+    bool isTransparent(MaterialHandle handle) const;
+    // Has a diffuse map with holes that depth-only passes have to discard
+    bool needsAlphaTest(MaterialHandle handle) const;
+    // Binds the material maps and selects the palette entry for the next draw
+    void use(MaterialHandle handle, const Shader &shader) const;
+    // Maps only, for draws reading the palette index from their instance data
+    void bindMaps(MaterialHandle handle) const;
+    // Materials with the same maps may be drawn together, they only differ in their palette entries
+    bool hasSameMaps(MaterialHandle a, MaterialHandle b) const;
+    // Orders materials so the ones sharing maps are next to each other
+    bool isBeforeByMaps(MaterialHandle a, MaterialHandle b) const;
+
+private:
+    GLuint _ubo;
+    GLuint _fallbackTexture;
+
+    std::vector<Material> _materials;
+    std::vector<MaterialData> _data;
+    // Uploaded copy of the palette
+    std::vector<MaterialState> _states;
+
+    unsigned int _dirtyBegin = 0;
+    unsigned int _dirtyEnd = 0;
+
+    void bindMap(const Texture *texture, int unit) const;
+    void markDirty(MaterialHandle handle);
+    static MaterialData pack(const Material &material);
+    static MaterialState getState(const Material &material);
+    static bool isSame(const Material &a, const Material &b);
+};
@@ -8,6 +8,7 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 
+#include "bounds.h"
 #include "shader.h"
 #include "texture.h"
 
@@ -34,15 +35,32 @@ public:
 
     bool cullFaces = true;
 
-    void draw(const Shader &shader) const;
+    void draw(const Shader &shader, GLsizei instances = 1) const;
+
+    // In model space
+    const AABB &getBounds() const;
+    // CPU copy of the geometry, used by the software occlusion rasterizer
+    const std::vector<glm::vec3> &getPositions() const;
+    const std::vector<unsigned int> &getIndices() const;
+    // Closest triangle hit, model places the mesh in the space of the ray
+    bool raycast(const Ray &ray, const glm::mat4 &model, float maxDistance, float &distance) const;
+
+    // Buffers and textures
+    uint64_t getGpuBytes() const;
+    // The geometry copy
+    uint64_t getSystemBytes() const;
 
 private:
     unsigned int _indicesCount;
+    AABB _bounds;
+    std::vector<glm::vec3> _positions;
+    std::vector<unsigned int> _indices;
     std::vector<Texture> _textures;
 
     GLuint _vao;
     GLuint _ebo;
     GLuint _vbo;
+    uint64_t _bufferBytes = 0;
 };
 
 class Model
@@ -51,6 +69,11 @@ public:
     Model(const std::string &path);
     void draw(const Shader &shader) const;
 
+    const std::vector<std::unique_ptr<Mesh>> &getMeshes() const;
+    // Of every mesh, its resources are also tracked under the path
+    uint64_t getGpuBytes() const;
+    uint64_t getSystemBytes() const;
+
 private:
     // model data
     std::vector<std::unique_ptr<Mesh>> _meshes;
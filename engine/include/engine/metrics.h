@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MetricCounter;
+class MetricGauge;
+class MetricHistogram;
+
+// Registry of the counters, gauges and histograms exported by MetricsExporter. Off until enabled, every update then
+// returns after a single relaxed load. Names are expected to be string literals in the Prometheus naming style,
+// registering a name again returns the metric already registered under it
+class Metrics
+{
+public:
+    // Metric values flattened for logs, histograms as their count and sum
+    struct Sample
+    {
+        const char *name;
+        // Appended to the name
+        const char *suffix;
+        double value;
+    };
+
+    Metrics() = delete;
+
+    static void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+    static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    static MetricCounter &counter(const char *name, const char *help);
+    static MetricGauge &gauge(const char *name, const char *help);
+    // Upper bounds in increasing order, a last bucket takes everything above them
+    static MetricHistogram &histogram(const char *name, const char *help, const std::vector<double> &bounds);
+
+    // Prometheus text exposition format, appended
+    static void writePrometheus(std::string &text);
+    // In registration order, the vector is reused
+    static void getSamples(std::vector<Sample> &samples);
+
+private:
+    static inline std::atomic<bool> _enabled = false;
+};
+
+// Threads add to shards of their own so updates from the job system and the render thread never contend, threads
+// past the shard count share them
+static constexpr int METRIC_SHARDS = 16;
+
+// Only ever goes up
+class MetricCounter
+{
+public:
+    MetricCounter(const MetricCounter &) = delete;
+    MetricCounter &operator=(const MetricCounter &) = delete;
+    MetricCounter(const char *name, const char *help);
+
+    void add(uint64_t value = 1)
+    {
+        if (Metrics::isEnabled())
+            record(value);
+    }
+    uint64_t get() const;
+
+    const char *getName() const;
+    const char *getHelp() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value = 0;
+    };
+
+    const char *_name;
+    const char *_help;
+    Shard _shards[METRIC_SHARDS];
+
+    void record(uint64_t value);
+};
+
+// Last value set, for levels such as object counts and memory in use
+class MetricGauge
+{
+public:
+    MetricGauge(const MetricGauge &) = delete;
+    MetricGauge &operator=(const MetricGauge &) = delete;
+    MetricGauge(const char *name, const char *help);
+
+    void set(double value)
+    {
+        if (Metrics::isEnabled())
+            _value.store(value, std::memory_order_relaxed);
+    }
+    void add(double value)
+    {
+        if (Metrics::isEnabled())
+            _value.fetch_add(value, std::memory_order_relaxed);
+    }
+    double get() const;
+
+    const char *getName() const;
+    const char *getHelp() const;
+
+private:
+    const char *_name;
+    const char *_help;
+    std::atomic<double> _value = 0.0;
+};
+
+// Observations counted in fixed buckets, with their sum
+class MetricHistogram
+{
+public:
+    MetricHistogram(const MetricHistogram &) = delete;
+    MetricHistogram &operator=(const MetricHistogram &) = delete;
+    MetricHistogram(const char *name, const char *help, const std::vector<double> &bounds);
+
+    void observe(double value)
+    {
+        if (Metrics::isEnabled())
+            record(value);
+    }
+
+    const std::vector<double> &getBounds() const;
+    // Per bucket, not cumulative, the last one is above every bound
+    void getBuckets(std::vector<uint64_t> &buckets) const;
+    uint64_t getCount() const;
+    double getSum() const;
+
+    const char *getName() const;
+    const char *getHelp() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+        std::atomic<uint64_t> count = 0;
+        std::atomic<double> sum = 0.0;
+    };
+
+    const char *_name;
+    const char *_help;
+    std::vector<double> _bounds;
+    Shard _shards[METRIC_SHARDS];
+
+    void record(double value);
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+// Serves the metrics to scrapers in Prometheus text format from a thread of its own, and appends them to a log
+// Each connection gets the current values over HTTP/1.0 and is closed, so curl, a Prometheus scrape or a plain
+// nc all work. Enables the metrics while it exists
+class MetricsExporter
+{
+public:
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+    // Listens on "unix:<path>", "<host>:<port>" or "<port>" on the loopback interface, empty does not listen.
+    // The log is CSV when its path ends with .csv and JSON lines otherwise, empty does not log
+    MetricsExporter(const std::string &address, const std::string &logPath);
+    ~MetricsExporter();
+
+    // Appends every metric as of now to the log
+    void log(int frame, double time);
+
+private:
+    int _listener = -1;
+    std::string _socketPath;
+    std::thread _server;
+    std::atomic<bool> _quit = false;
+
+    std::FILE *_log = nullptr;
+    bool _csv = false;
+    // Metrics the last CSV header was written for, a new header follows when more were registered
+    int _loggedCount = -1;
+    std::vector<Metrics::Sample> _samples;
+
+    bool listen(const std::string &address);
+    void serve();
+};
@@ -2,10 +2,12 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <memory>
 #include <variant>
 #include <string>
 
+#include "bounds.h"
 #include "transform.h"
 
 class Game;
@@ -16,9 +18,19 @@ enum Notification
     UPDATE,
     DRAW,
     IMGUI_DRAW,
-    KEY_INPUT,
-    MOUSE_MOVE,
     SCREEN,
+    // Sent to the active camera only, once input was polled again right before its view is copied for rendering
+    LATE_UPDATE,
+};
+
+// Refers to an object without keeping it alive, Game::get returns null once it is destroyed even if another
+// object took its slot. The default handle never refers to anything
+struct ObjectHandle
+{
+    uint32_t index = 0;
+    uint32_t generation = 0;
+
+    bool operator==(const ObjectHandle &other) const = default;
 };
 
 class Object
@@ -31,11 +43,49 @@ public:
     Transform transform;
 
     Game &getGame() const;
+    ObjectHandle getHandle() const;
+    // Despawned this frame, it is destroyed at the end of the frame
+    bool isDespawned() const;
+    // With fixed updates, renders the current transform next frame instead of blending from the previous one,
+    // after teleporting
+    void resetInterpolation();
 
-    void init(Game &game);
+    // Box in model space, puts the object in the game's spatial index for scene queries. Main thread only, the
+    // index follows the transform once per frame after the updates
+    void setBounds(const AABB &bounds);
+    bool hasBounds() const;
+    // Distance along the ray where it hits the object, negative on a miss. The world box by default, objects
+    // override it to test their geometry
+    virtual float raycast(const Ray &ray, float maxDistance) const;
+
+    void init(Game &game, ObjectHandle handle);
     void notification(Notification type);
     virtual void onNotification(Notification type);
 
+    // Declares a notification this object handles touching nothing but its own state,
+    // the game may then send it from worker threads alongside other objects
+    void runConcurrently(Notification type);
+    bool runsConcurrently(Notification type) const;
+
 private:
+    friend class Game;
+
     Game *_game;
+    ObjectHandle _handle;
+    // Transform before the last fixed update, and the simulated one while an interpolated one is extracted
+    Transform _previousTransform;
+    Transform _simulatedTransform;
+    unsigned int _concurrentNotifications = 0;
+    bool _despawned = false;
+    // Positions in the game's lists, so despawning removes it from them in constant time
+    int _objectIndex = -1;
+    int _updateIndex = -1;
+    int _indexedIndex = -1;
+    // In the concurrent updates, kept as it joined them whatever it declares later
+    bool _concurrentUpdate = false;
+
+    AABB _bounds;
+    bool _hasBounds = false;
+    // In the spatial index, -1 until the game inserts it
+    int _proxy = -1;
 };
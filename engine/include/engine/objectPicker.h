@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "shader.h"
+
+class Camera;
+class Profiler;
+struct DrawCommand;
+
+struct PickResult
+{
+    // Pick id of the command under the pixel, 0 for none
+    uint32_t id = 0;
+    glm::ivec2 pixel = glm::ivec2(0);
+    // Rendered frames between the request and the result
+    int latency = 0;
+};
+
+// Draws the pick id of every command into an integer target, scissored to a few pixels around the requested one,
+// and reads them back. Asynchronously through a ring of pixel buffers with a fence each, the result is taken once
+// the GPU is done a frame or two later, or synchronously with glReadPixels, which waits for the whole frame
+class ObjectPicker
+{
+public:
+    // Pixels read around the requested one
+    static constexpr int REGION_SIZE = 7;
+
+    ObjectPicker(const ObjectPicker &) = delete;
+    ObjectPicker &operator=(const ObjectPicker &) = delete;
+    ObjectPicker(Profiler &profiler, const glm::vec2 &size);
+    ~ObjectPicker();
+
+    bool synchronous = false;
+
+    // In framebuffer pixels from the bottom left, drawn with the next render()
+    void request(const glm::ivec2 &pixel);
+    // Collects finished readbacks, then draws and reads the pending request if any
+    void render(const Camera &camera, const std::vector<DrawCommand> &commands);
+    // Any thread, the latest result not taken yet
+    bool takeResult(PickResult &result);
+    void resize(const glm::vec2 &size);
+
+    void imguiDraw();
+
+private:
+    static constexpr int READBACK_BUFFERS = 3;
+
+    struct Readback
+    {
+        GLuint buffer = 0;
+        // Null while the buffer is free
+        GLsync fence = nullptr;
+        glm::ivec2 pixel = glm::ivec2(0);
+        glm::ivec2 origin = glm::ivec2(0);
+        glm::ivec2 size = glm::ivec2(0);
+        unsigned int frame = 0;
+    };
+
+    Profiler &_profiler;
+    glm::ivec2 _size;
+    std::unique_ptr<Shader> _shader;
+
+    GLuint _framebuffer = 0;
+    GLuint _ids = 0;
+    GLuint _depth = 0;
+
+    Readback _readbacks[READBACK_BUFFERS];
+    std::optional<glm::ivec2> _request;
+    unsigned int _frame = 0;
+
+    std::mutex _resultMutex;
+    std::optional<PickResult> _result;
+
+    // Milliseconds the CPU waited on the last readback of each kind, and requests dropped with every buffer busy
+    float _syncStall = 0.0f;
+    float _asyncStall = 0.0f;
+    int _lastLatency = 0;
+    int _dropped = 0;
+
+    void draw(const Camera &camera, const std::vector<DrawCommand> &commands, const glm::ivec2 &origin, const glm::ivec2 &size);
+    void collect();
+    // Id at the pixel, or the nearest one in the region when it is empty so thin geometry is forgiving to click
+    void resolve(const uint32_t *ids, const Readback &readback);
+    void createTargets();
+    void destroyTargets();
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+class Object;
+
+class ObjectPoolBase
+{
+public:
+    virtual ~ObjectPoolBase() = default;
+
+    virtual void destroy(Object *object) = 0;
+    virtual int getLiveCount() const = 0;
+    virtual int getCapacity() const = 0;
+};
+
+// Storage for one type of object in fixed size blocks, freed slots are reused before another block is allocated
+// so objects never move and memory stays at the peak count however many come and go
+template <typename T>
+class ObjectPool : public ObjectPoolBase
+{
+public:
+    static constexpr int BLOCK_SIZE = 256;
+
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    T *create()
+    {
+        if (_free.empty())
+            grow();
+
+        Slot *slot = _free.back();
+        _free.pop_back();
+        _live++;
+
+        return new (slot->storage) T();
+    }
+
+    // Only for objects created by this pool
+    void destroy(Object *object) override
+    {
+        T *typed = static_cast<T *>(object);
+        typed->~T();
+
+        _free.push_back(reinterpret_cast<Slot *>(typed));
+        _live--;
+    }
+
+    int getLiveCount() const override { return _live; }
+    int getCapacity() const override { return _blocks.size() * BLOCK_SIZE; }
+
+private:
+    struct Slot
+    {
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> _blocks;
+    std::vector<Slot *> _free;
+    int _live = 0;
+
+    void grow()
+    {
+        _blocks.push_back(std::make_unique<Slot[]>(BLOCK_SIZE));
+
+        // Reversed so the block fills from its start
+        Slot *block = _blocks.back().get();
+        for (int i = BLOCK_SIZE - 1; i >= 0; i--)
+            _free.push_back(&block[i]);
+    }
+};
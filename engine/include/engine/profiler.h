@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "allocationTracker.h"
+
+// Ring of queries around a range of GPU work, results are read a few frames late so it never stalls
+class GpuQuery
+{
+public:
+    GpuQuery(const GpuQuery &) = delete;
+    GpuQuery &operator=(const GpuQuery &) = delete;
+    GpuQuery(GLenum target);
+    ~GpuQuery();
+
+    void begin();
+    void end();
+
+    // Latest available result
+    GLuint64 getResult() const;
+
+private:
+    static constexpr int LATENCY = 4;
+
+    GLenum _target;
+    GLuint _queries[LATENCY];
+    bool _pending[LATENCY] = {};
+    int _current = 0;
+    bool _active = false;
+    GLuint64 _result = 0;
+
+    void collect();
+};
+
+class GpuTimer : public GpuQuery
+{
+public:
+    GpuTimer();
+
+    float getMilliseconds() const;
+};
+
+// Named CPU and GPU timings plus counters, shown in the profiler overlay
+// Names are expected to be string literals, they are compared by pointer first
+// Safe to use from the main and render threads, CPU scopes nest per thread
+// CPU scopes are also allocation tracking scopes, the overlay lists the heap allocations of each
+class Profiler
+{
+public:
+    // Counters and allocation counts are per frame, they are cleared here
+    void beginFrame();
+
+    void beginGpu(const char *name);
+    void endGpu();
+
+    void beginCpu(const char *name);
+    void endCpu();
+
+    void setCounter(const char *name, double value);
+    void addCounter(const char *name, double value);
+
+    float getGpuMilliseconds(const char *name) const;
+    float getCpuMilliseconds(const char *name) const;
+    double getCounter(const char *name) const;
+
+    void imguiDraw() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct GpuScope
+    {
+        const char *name;
+        std::unique_ptr<GpuTimer> timer;
+    };
+
+    struct CpuScope
+    {
+        const char *name;
+        float milliseconds = 0.0f;
+    };
+
+    struct OpenCpuScope
+    {
+        int index;
+        Clock::time_point start;
+    };
+
+    struct Counter
+    {
+        const char *name;
+        double value = 0.0;
+    };
+
+    std::vector<GpuScope> _gpuScopes;
+    std::vector<CpuScope> _cpuScopes;
+    std::vector<Counter> _counters;
+
+    std::vector<AllocationTracker::Stats> _allocations;
+
+    GpuTimer *_activeGpu = nullptr;
+    std::unordered_map<std::thread::id, std::vector<OpenCpuScope>> _cpuStacks;
+
+    mutable std::mutex _mutex;
+
+    template <typename T>
+    static int find(const std::vector<T> &items, const char *name);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "framePacket.h"
+
+// Owns the GL context while it runs and renders the packets the main thread hands over
+// The main thread may fill up to latency packets ahead of the one being rendered, 1 is double buffering
+class RenderThread
+{
+public:
+    RenderThread(const RenderThread &) = delete;
+    RenderThread &operator=(const RenderThread &) = delete;
+    // The context must not be current on any thread
+    RenderThread(GLFWwindow *window, int latency, std::function<void(FramePacket &)> render);
+    // Renders what was submitted, then makes the context current on the calling thread again
+    ~RenderThread();
+
+    // Next packet to fill, waits while the render thread is too far behind
+    FramePacket &acquire();
+    void submit();
+    // Until every submitted packet is rendered
+    void waitIdle();
+
+private:
+    GLFWwindow *_window;
+    std::function<void(FramePacket &)> _render;
+    std::vector<std::unique_ptr<FramePacket>> _packets;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    unsigned long long _submitted = 0;
+    unsigned long long _rendered = 0;
+    bool _quit = false;
+
+    std::thread _thread;
+
+    void loop();
+};
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "frameArena.h"
+#include "gpuCulling.h"
+#include "materialRegistry.h"
+#include "mesh.h"
+#include "objectPicker.h"
+#include "resolutionController.h"
+#include "shader.h"
+#include "shadowAtlas.h"
+#include "softwareOcclusion.h"
+#include "streamBuffer.h"
+
+class Camera;
+class JobSystem;
+class Light;
+class Object;
+class Profiler;
+class GpuQuery;
+
+enum RenderPath
+{
+    FORWARD,
+    DEFERRED,
+};
+
+enum TransparencyMode
+{
+    // Back to front per draw
+    SORTED,
+    // Order independent, one pass whatever the count
+    WEIGHTED_BLENDED,
+};
+
+enum AntiAliasingMode
+{
+    AA_OFF,
+    // Multisampled scene target resolved once the scene is done, forward path only as the G-buffer has one sample
+    AA_MSAA,
+    // Post pass over the finished scene, blends across the edges found in its luma
+    AA_FXAA,
+};
+
+struct DrawCommand
+{
+    const Mesh *mesh = nullptr;
+    // Only used by forward passes, the deferred path draws opaque meshes with its G-buffer shader
+    const Shader *shader = nullptr;
+    MaterialHandle material = 0;
+    glm::mat4 model = glm::mat4(1.0f);
+
+    // Drawn with the selection outline
+    bool outlined = false;
+    // Written to the pick pass, 0 is never picked
+    uint32_t pickId = 0;
+
+    bool castsShadows = true;
+    // Never moves, shadow maps keep it cached
+    bool isStatic = false;
+    // Rasterized into the software occlusion buffer, meant for large simple meshes
+    bool isOccluder = false;
+
+    // Opaque draws with the same owner are occlusion tested together as one object, null opts out
+    const Object *owner = nullptr;
+};
+
+// Per instance data of a light volume, must match the attributes in lightVolume.vs
+struct LightInstance
+{
+    glm::vec4 position;    // w = volume radius
+    glm::vec4 direction;   // w = cos(cutOff)
+    glm::vec4 ambient;     // w = cos(outerCutOff)
+    glm::vec4 diffuse;     // w = cone base radius over length
+    glm::vec4 specular;
+    glm::vec4 attenuation; // constant, linear, quadratic, first shadow tile
+};
+
+class Renderer
+{
+public:
+    Renderer(const Renderer &) = delete;
+    Renderer &operator=(const Renderer &) = delete;
+    Renderer(RenderPath path, const MaterialRegistry &materials, Profiler &profiler, JobSystem &jobs, const glm::vec2 &size);
+    ~Renderer();
+
+    const RenderPath path;
+    // Lays down depth first so the lighting shaders only run once per visible pixel
+    bool depthPrePass = false;
+    TransparencyMode transparencyMode = TransparencyMode::SORTED;
+    bool occlusionCulling = false;
+    // Culls on the CPU against the occluder commands before anything reaches the GPU
+    bool softwareOcclusion = false;
+    // Opaque commands drawn in instanced batches culled on the GPU, replaces occlusion culling
+    bool gpuCulling = false;
+
+    glm::vec3 outlineColor = glm::vec3(0.04f, 0.28f, 0.26f);
+    // In pixels
+    float outlineWidth = 4.0f;
+    // Of the pass scaling a dynamic resolution scene up to the window, 0 is bilinear
+    float upscaleSharpness = 0.3f;
+    AntiAliasingMode antiAliasing = AntiAliasingMode::AA_OFF;
+    // Clamped to what the driver supports
+    int msaaSamples = 4;
+
+    // Queues a draw for this frame, extract() hands the queued commands over to render()
+    void submit(const DrawCommand &command);
+    // Given to the commands submitted from now on without a pick id of their own
+    void setPickId(uint32_t id);
+    void extract(std::vector<DrawCommand> &commands);
+    // Of the window, the scene renders at the size the resolution controller scales it to
+    void resize(const glm::vec2 &size);
+    // Empties commands, keeping its capacity
+    void render(const Camera &camera, const std::vector<Light *> &lights, std::vector<DrawCommand> &commands);
+
+    // In window pixels from the bottom left, mapped to the scene's resolution and drawn with the next render()
+    void requestPick(const glm::ivec2 &pixel);
+    ObjectPicker &getPicker() const;
+    ResolutionController &getResolution() const;
+
+    void imguiDraw();
+
+private:
+    struct LightVolume
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLuint instances = 0;
+        GLsizei indicesCount = 0;
+    };
+
+    struct OcclusionGroup
+    {
+        // Written on alternate frames, each one is read back the frame after
+        GLuint queries[2] = {};
+        bool pending[2] = {};
+        bool visible = true;
+        bool cameraInside = false;
+        unsigned int lastFrame = 0;
+
+        AABB bounds;
+        std::vector<const DrawCommand *> commands;
+    };
+
+    const MaterialRegistry &_materials;
+    Profiler &_profiler;
+    // Rendered at, the window's size unless the resolution is dynamic
+    glm::ivec2 _size;
+    glm::ivec2 _outputSize;
+    // Transient data of the frame being rendered, reset when render() starts
+    FrameArena _frameArena;
+
+    std::vector<DrawCommand> _submitted;
+    uint32_t _pickId = 0;
+    std::vector<DrawCommand> _commands;
+    std::vector<const DrawCommand *> _opaque;
+    std::vector<const DrawCommand *> _transparent;
+    std::vector<float> _viewDepths;
+    // Back to front order of _transparent, kept between frames so sorting is nearly free when little moves
+    std::vector<int> _transparentOrder;
+    std::vector<const Shader *> _preparedShaders;
+
+    // Occlusion culling
+    unsigned int _frame = 0;
+    std::unordered_map<const Object *, OcclusionGroup> _occlusionGroups;
+    std::vector<OcclusionGroup *> _frameGroups;
+    std::vector<bool> _hidden;
+    GLuint _proxyVao = 0;
+    GLuint _proxyVbo = 0;
+    GLuint _proxyEbo = 0;
+
+    std::unique_ptr<SoftwareOcclusion> _softwareOcclusion;
+    std::unique_ptr<GpuCulling> _gpuCulling;
+    std::vector<bool> _culled;
+
+    std::unique_ptr<ShadowAtlas> _shadows;
+    std::unique_ptr<ObjectPicker> _picker;
+    std::optional<glm::ivec2> _pickRequest;
+    // Triple buffered per frame data, light volume instances for now
+    std::unique_ptr<StreamBuffer> _stream;
+
+    // Depth pre-pass
+    std::unique_ptr<Shader> _depthShader;
+    std::unique_ptr<GpuQuery> _shadedSamples;
+
+    // Outlines, seeds are jump flooded between the two targets
+    std::unique_ptr<Shader> _outlineSeedShader;
+    std::unique_ptr<Shader> _jumpFloodShader;
+    std::unique_ptr<Shader> _outlineShader;
+
+    GLuint _outlineFramebuffers[2] = {};
+    GLuint _outlineSeeds[2] = {};
+
+    // Weighted blended transparency
+    std::unique_ptr<Shader> _oitCompositeShader;
+
+    GLuint _oitFramebuffer = 0;
+    GLuint _oitAccumulation = 0;
+    GLuint _oitWeights = 0;
+    GLuint _oitDepth = 0;
+
+    // Scene target, used under dynamic resolution or anti-aliasing and presented to the default framebuffer
+    std::unique_ptr<ResolutionController> _resolution;
+    std::unique_ptr<Shader> _upscaleShader;
+    std::unique_ptr<Shader> _fxaaShader;
+    GLint _maxSamples = 0;
+
+    GLuint _sceneFramebuffer = 0;
+    // A renderbuffer when multisampled, a texture otherwise
+    GLuint _sceneColor = 0;
+    GLuint _sceneDepth = 0;
+    int _sceneSamples = 0;
+    // MSAA resolve, or FXAA output when it still has to be scaled up, at the render size
+    GLuint _resolveFramebuffer = 0;
+    GLuint _resolveColor = 0;
+
+    // GPU time of the whole frame in each mode, averaged while it is on
+    float _antiAliasingMilliseconds[AntiAliasingMode::AA_FXAA + 1] = {};
+    AntiAliasingMode _measuredAntiAliasing = AntiAliasingMode::AA_OFF;
+    int _antiAliasingFrames = 0;
+
+    // Deferred path
+    std::unique_ptr<Shader> _gBufferShader;
+    std::unique_ptr<Shader> _directionalShader;
+    std::unique_ptr<Shader> _lightVolumeShader;
+
+    GLuint _gBuffer = 0;
+    GLuint _gAlbedo = 0;
+    GLuint _gSpecular = 0;
+    GLuint _gNormal = 0;
+    GLuint _gEmission = 0;
+    GLuint _gDepth = 0;
+
+    GLuint _emptyVao = 0;
+    LightVolume _sphere;
+    LightVolume _cone;
+    std::vector<LightInstance> _pointInstances;
+    std::vector<LightInstance> _spotInstances;
+
+    void cullSoftwareOcclusion(const Camera &camera);
+    void sortCommands(const Camera &camera);
+    void updateOcclusion(const Camera &camera);
+    bool isHidden(const DrawCommand *command) const;
+    void renderForward(const Camera &camera, const std::vector<Light *> &lights);
+    void renderDeferred(const Camera &camera, const std::vector<Light *> &lights);
+
+    // Visible opaque commands, then occlusion tests and the commands hidden last frame under conditional rendering
+    template <typename DrawFunction>
+    void drawOpaque(const Camera &camera, DrawFunction draw);
+    void testOcclusion(const Camera &camera);
+    // Same for the GPU culled batches
+    template <typename BatchFunction>
+    void drawBatches(const Camera &camera, BatchFunction draw);
+
+    void drawDepthPrePass(const Camera &camera);
+    void endDepthPrePass();
+    const Shader &getMainPassShader(const Shader &shader) const;
+
+    void prepareShader(const Shader &shader, const Camera &camera, const std::vector<Light *> &lights);
+    void drawForward(const DrawCommand &command, const Shader &shader, const Camera &camera, const std::vector<Light *> &lights);
+    void drawTransparent(const Camera &camera, const std::vector<Light *> &lights);
+    void drawWeightedBlended(const Camera &camera, const std::vector<Light *> &lights);
+    void drawOutlines(const Camera &camera);
+    void drawLightVolumes(const LightVolume &volume, const std::vector<LightInstance> &instances, bool isSpot);
+    void presentScene();
+    void upscale(GLuint source);
+    void measureAntiAliasing();
+
+    void resizeTargets(const glm::ivec2 &size);
+    // Samples the scene target should have for the current mode
+    int getSceneSamples() const;
+    void createSceneTarget();
+    void destroySceneTarget();
+    void createResolveTarget();
+
+    void createOutlineTargets();
+    void destroyOutlineTargets();
+    void createOitTargets();
+    void destroyOitTargets();
+    void createGBuffer();
+    void destroyGBuffer();
+    void createLightVolume(LightVolume &volume, const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices);
+    void destroyLightVolume(LightVolume &volume);
+    // With the volume's vertex array bound
+    static void setLightInstanceAttributes(GLuint buffer, GLintptr offset);
+};
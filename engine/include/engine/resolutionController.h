@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Picks the resolution scale of the scene from its GPU time, measured with timestamp queries around the frame's
+// passes (elapsed time queries cannot nest with the profiler's). GPU cost roughly follows the pixel count, so the
+// scale that would just fit the budget is the current one times the square root of budget over time. That estimate
+// is smoothed and the scale only moves in steps once the last change shows up in the timings, since every change
+// means recreating the render targets
+class ResolutionController
+{
+public:
+    // Scales are multiples of this
+    static constexpr float SCALE_STEP = 0.05f;
+
+    ResolutionController(const ResolutionController &) = delete;
+    ResolutionController &operator=(const ResolutionController &) = delete;
+    ResolutionController();
+    ~ResolutionController();
+
+    bool enabled = false;
+    // GPU time of the scene aimed for, the scale is chosen to leave a little headroom under it
+    float targetMilliseconds = 16.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+
+    // Around every GPU pass of the frame, timings are measured whether enabled or not so the budget can be compared
+    void beginFrame();
+    void endFrame();
+
+    // Full size while disabled
+    glm::ivec2 getRenderSize(const glm::ivec2 &outputSize) const;
+    float getScale() const;
+    // Of the last measured frame
+    float getGpuMilliseconds() const;
+    float getWithinBudget() const;
+    void resetStatistics();
+
+    void imguiDraw();
+
+private:
+    static constexpr int LATENCY = 4;
+
+    // Start and end of a frame, and the scale it was rendered at
+    GLuint _queries[LATENCY][2] = {};
+    float _frameScales[LATENCY] = {};
+    bool _pending[LATENCY] = {};
+    int _current = 0;
+    bool _active = false;
+
+    float _scale = 1.0f;
+    // Smoothed estimate the scale steps towards
+    float _idealScale = 1.0f;
+    int _framesSinceChange = 0;
+
+    float _gpuMilliseconds = 0.0f;
+    float _averageMilliseconds = 0.0f;
+    float _worstMilliseconds = 0.0f;
+    int _measuredFrames = 0;
+    int _framesWithinBudget = 0;
+    int _scaleChanges = 0;
+
+    void collect();
+    void update(float milliseconds, float frameScale);
+};
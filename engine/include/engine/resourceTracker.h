@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum ResourceCategory
+{
+    // Vertex and index buffers of meshes
+    RESOURCE_GEOMETRY,
+    // Images loaded from disk
+    RESOURCE_TEXTURE,
+    // Textures and renderbuffers drawn into, sized after the screen or fixed
+    RESOURCE_RENDER_TARGET,
+    // Uniform, instance, streaming and readback buffers
+    RESOURCE_BUFFER,
+    // Linked programs, zero bytes when the driver cannot tell their size
+    RESOURCE_PROGRAM,
+    // System memory from here on
+    // Copies of mesh geometry kept for raycasts and the software rasterizer
+    RESOURCE_GEOMETRY_COPY,
+    RESOURCE_CATEGORY_COUNT,
+};
+
+// What the id of a resource is, GL names of different kinds may be equal
+enum ResourceKind
+{
+    RESOURCE_GL_BUFFER,
+    RESOURCE_GL_TEXTURE,
+    RESOURCE_GL_RENDERBUFFER,
+    RESOURCE_GL_PROGRAM,
+    // The address of what holds the memory
+    RESOURCE_HOST,
+};
+
+// Bytes held by engine resources, per category and per owner, the asset path or engine subsystem they belong to
+// Tracked by hand next to the calls that allocate or free them, from any thread. Sizing a resource again replaces
+// its previous size without allocating, so it is fine for buffers respecified every frame
+// A budget per category and for the GPU and system memory totals warns once every time usage crosses it
+class ResourceTracker
+{
+public:
+    struct Usage
+    {
+        uint64_t bytes;
+        uint64_t peak;
+        int count;
+        // Zero when unbounded
+        uint64_t budget;
+    };
+
+    ResourceTracker() = delete;
+
+    // Creates the entry or resizes it, the owner is only read when it is created
+    static void track(ResourceKind kind, uintptr_t id, ResourceCategory category, const char *owner, uint64_t bytes);
+    // Owned by the innermost owner scope open on the calling thread
+    static void track(ResourceKind kind, uintptr_t id, ResourceCategory category, uint64_t bytes);
+    // Ids never tracked are ignored, 0 included
+    static void release(ResourceKind kind, uintptr_t id);
+
+    // Resources tracked without an owner inside belong to it, such as the meshes of a model being loaded
+    static void beginOwner(const std::string &owner);
+    static void endOwner();
+
+    static Usage getUsage(ResourceCategory category);
+    static Usage getGpuUsage();
+    static Usage getSystemUsage();
+    // Across every category
+    static uint64_t getOwnerBytes(const std::string &owner);
+
+    static void setBudget(ResourceCategory category, uint64_t bytes);
+    static void setGpuBudget(uint64_t bytes);
+    static void setSystemBudget(uint64_t bytes);
+
+    // Every owner with its bytes per category and its resources, biggest first
+    static bool dumpJson(const std::string &path);
+
+    // As the driver most likely lays it out, 3 byte texels padded to 4
+    static uint64_t getTextureBytes(GLenum internalFormat, int width, int height, int levels = 1);
+    // Down to 1x1
+    static int getMipCount(int width, int height);
+
+    static void imguiDraw();
+};
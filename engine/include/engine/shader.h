@@ -6,29 +6,64 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Binding points of the uniform blocks shared by every shader
+enum UniformBlock
+{
+    MATERIALS_BLOCK = 0,
+    SHADOWS_BLOCK = 1,
+};
+
 class Shader
 {
 public:
     Shader() = delete;
     Shader(const Shader &) = delete;
     Shader &operator=(const Shader &) = delete;
-    Shader(const char *vertexPath, const char *fragmentPath);
+    // Programs capturing transform feedback may leave the fragment stage out with a null fragmentPath
+    Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines = {},
+           const std::vector<std::string> &feedbackVaryings = {});
     ~Shader();
 
     void use() const;
+    // Same sources compiled with one more #define, built on first use
+    const Shader &getVariant(const char *define) const;
 
-    void setUniform(const std::string &name, bool value) const;
-    void setUniform(const std::string &name, int value) const;
-    void setUniform(const std::string &name, float value) const;
-    void setUniform(const std::string &name, float x, float y, float z) const;
-    void setUniform(const std::string &name, const glm::vec3 &val) const;
-    void setUniform(const std::string &name, const glm::vec4 &val) const;
-    void setUniform(const std::string &name, float x, float y, float z, float w) const;
-    void setUniform(const std::string &name, const glm::mat4 &matrix) const;
+    void setUniform(const char *name, bool value) const;
+    void setUniform(const char *name, int value) const;
+    void setUniform(const char *name, unsigned int value) const;
+    void setUniform(const char *name, float value) const;
+    void setUniform(const char *name, const glm::vec2 &val) const;
+    void setUniform(const char *name, float x, float y, float z) const;
+    void setUniform(const char *name, const glm::vec3 &val) const;
+    void setUniform(const char *name, const glm::vec4 &val) const;
+    void setUniform(const char *name, float x, float y, float z, float w) const;
+    void setUniform(const char *name, const glm::mat4 &matrix) const;
 
 private:
     GLuint _id;
+
+    std::string _vertexPath;
+    std::string _fragmentPath;
+    std::vector<std::string> _defines;
+    std::vector<std::string> _feedbackVaryings;
+    mutable std::vector<std::pair<std::string, std::unique_ptr<Shader>>> _variants;
+
+    // Looked up without allocating, names may be temporaries such as the light array elements
+    struct NameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+    };
+    mutable std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> _locations;
+
+    void bindEngineInterface() const;
+    // Asks the driver once per name, uniforms missing from the program stay -1 like glGetUniformLocation
+    GLint getLocation(const char *name) const;
 };
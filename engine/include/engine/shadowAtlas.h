@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "materialRegistry.h"
+#include "shader.h"
+
+class Camera;
+class Light;
+class Profiler;
+struct DrawCommand;
+
+// Shadow maps of every shadow casting light packed as tiles of one depth texture
+// Directional lights take one tile per cascade, point lights one per cube face and spot lights one
+// Static casters are rendered into a cache atlas that is only redrawn when the tile's light or its static casters change,
+// dynamic casters are drawn over a copy of it when they change
+class ShadowAtlas
+{
+public:
+    static constexpr int SIZE = 4096;
+    static constexpr int TILE_SIZE = 512;
+    static constexpr int TILES_PER_ROW = SIZE / TILE_SIZE;
+    static constexpr int MAX_TILES = TILES_PER_ROW * TILES_PER_ROW;
+    static constexpr int MAX_CASCADES = 4;
+
+    ShadowAtlas(const ShadowAtlas &) = delete;
+    ShadowAtlas &operator=(const ShadowAtlas &) = delete;
+    ShadowAtlas(const MaterialRegistry &materials, Profiler &profiler);
+    ~ShadowAtlas();
+
+    int cascadeCount = 3;
+    // Directional shadows stop at this view depth
+    float shadowDistance = 50.0f;
+    bool cacheStatic = true;
+
+    // Assigns tiles to the lights, redraws the ones that changed and uploads the Shadows block
+    // Leaves the viewport and framebuffer to the caller
+    void render(const Camera &camera, const std::vector<Light *> &lights, const std::vector<DrawCommand> &commands);
+    void bind() const;
+
+    void imguiDraw();
+
+private:
+    // Must match the Shadows block in the shaders (std140)
+    struct ShadowData
+    {
+        glm::mat4 matrices[MAX_TILES]; // world to atlas uv and depth
+        glm::vec4 tiles[MAX_TILES];    // xy = min uv, zw = max uv, inset by half a texel
+        glm::vec4 cascadeSplits;       // view depth where each cascade ends
+    };
+
+    struct Tile
+    {
+        glm::mat4 viewProjection;
+        bool isDirectional;
+    };
+
+    struct TileCache
+    {
+        uint64_t staticHash = 0;
+        uint64_t dynamicHash = 0;
+    };
+
+    const MaterialRegistry &_materials;
+    Profiler &_profiler;
+
+    std::unique_ptr<Shader> _depthShader;
+
+    GLuint _ubo = 0;
+    // Live atlas sampled by the lighting shaders, cache atlas only holds static casters
+    GLuint _framebuffer = 0;
+    GLuint _atlas = 0;
+    GLuint _cacheFramebuffer = 0;
+    GLuint _cacheAtlas = 0;
+
+    ShadowData _data = {};
+    std::vector<Tile> _tiles;
+    TileCache _cache[MAX_TILES];
+    std::vector<const DrawCommand *> _staticCasters;
+    std::vector<const DrawCommand *> _dynamicCasters;
+
+    bool allocateTiles(Light &light, int count);
+    void addCascades(const Camera &camera, const glm::vec3 &direction);
+    void renderTile(int index, const std::vector<DrawCommand> &commands);
+    void drawCasters(const std::vector<const DrawCommand *> &casters, const glm::mat4 &viewProjection);
+
+    void createAtlas();
+    void destroyAtlas();
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "bounds.h"
+
+class JobSystem;
+class Mesh;
+class Profiler;
+
+// Low resolution depth buffer rasterized on the CPU from a few large occluders, objects whose screen rectangle
+// lies behind it are culled before reaching the GPU, so unlike occlusion queries there is no readback latency
+// Rows of tiles are split in bands rasterized as separate jobs, each tile keeps its farthest depth for the tests
+class SoftwareOcclusion
+{
+public:
+    static constexpr int WIDTH = 320;
+    static constexpr int HEIGHT = 192;
+    static constexpr int TILE_WIDTH = 8;
+    static constexpr int TILE_HEIGHT = 4;
+    static constexpr int TILES_X = WIDTH / TILE_WIDTH;
+    static constexpr int TILES_Y = HEIGHT / TILE_HEIGHT;
+    static constexpr int BANDS = 8;
+
+    SoftwareOcclusion(const SoftwareOcclusion &) = delete;
+    SoftwareOcclusion &operator=(const SoftwareOcclusion &) = delete;
+    SoftwareOcclusion(Profiler &profiler, JobSystem &jobs);
+
+    // Occluders are only referenced until the next rasterize()
+    void addOccluder(const Mesh &mesh, const glm::mat4 &model);
+    void rasterize(const glm::mat4 &viewProjection);
+    // Conservative, false only when the whole box is behind the occluders
+    bool isVisible(const AABB &bounds) const;
+
+    // Triangles left after near clipping in the last rasterize()
+    int getTriangleCount() const;
+
+private:
+    struct Occluder
+    {
+        const Mesh *mesh;
+        glm::mat4 model;
+    };
+
+    // Edge functions and depth plane in pixels, inside is where all three edges are positive
+    struct Triangle
+    {
+        glm::vec3 edges[3]; // x * a + y * b + c
+        glm::vec3 depth;    // same form
+        glm::ivec2 min;
+        glm::ivec2 max;
+    };
+
+    Profiler &_profiler;
+    JobSystem &_jobs;
+    glm::mat4 _viewProjection = glm::mat4(1.0f);
+
+    std::vector<Occluder> _occluders;
+    std::vector<Triangle> _triangles;
+    std::vector<glm::vec4> _clipPositions;
+    std::vector<float> _depth;
+    std::vector<float> _tileMax;
+
+    void setupTriangles();
+    void addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    void rasterizeBand(int band);
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "bounds.h"
+
+enum SpatialIndexType
+{
+    // Balanced for any distribution, queries visit few nodes
+    AABB_TREE,
+    // Cheapest to update, suits many similar sized objects spread evenly
+    HASH_GRID,
+};
+
+struct RayHit
+{
+    // -1 on a miss
+    int proxy = -1;
+    float distance = 0.0f;
+};
+
+// Boxes with user data the scene can be queried through, proxies are ids that stay valid until removed.
+// Queries are const and may run from several threads, updates may not run alongside them
+class SpatialIndex
+{
+public:
+    // Called for each proxy whose box the ray enters before the current closest hit with the distance to its box,
+    // returns the distance of the hit on what the proxy stands for or a negative value for a miss
+    using RayTest = std::function<float(int proxy, float boxDistance)>;
+
+    virtual ~SpatialIndex() = default;
+
+    virtual int insert(const AABB &bounds, void *userData) = 0;
+    // Many at once, the proxies are written to proxies[i]
+    virtual void insert(int count, const AABB *bounds, void *const *userData, int *proxies);
+    // Cheap while the box does not move much
+    virtual void update(int proxy, const AABB &bounds) = 0;
+    virtual void remove(int proxy) = 0;
+    virtual void clear() = 0;
+    // Builds the whole structure again from the current boxes
+    virtual void rebuild() {}
+
+    virtual void *getUserData(int proxy) const = 0;
+    virtual int getProxyCount() const = 0;
+
+    // Results replace the contents of proxies
+    virtual void queryFrustum(const Frustum &frustum, std::vector<int> &proxies) const = 0;
+    virtual void querySphere(const glm::vec3 &center, float radius, std::vector<int> &proxies) const = 0;
+    // Up to count proxies nearest to the point by box distance, nearest first
+    virtual void findNearest(const glm::vec3 &point, int count, std::vector<int> &proxies) const = 0;
+    // Closest hit, against the boxes unless a test is given
+    virtual RayHit raycast(const Ray &ray, float maxDistance, const RayTest &test = nullptr) const = 0;
+    // Box hits only, hits[i] is for rays[i]
+    virtual void raycast(const Ray *rays, int count, float maxDistance, RayHit *hits) const = 0;
+
+    virtual void imguiDraw() = 0;
+};
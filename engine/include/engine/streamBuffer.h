@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+
+class Profiler;
+
+// Buffer written by the CPU every frame, split in regions used in turn so the GPU can still read the previous
+// frames' data. A fence guards each region, the CPU only waits when it laps a region the GPU has not finished with
+// Persistently and coherently mapped when GL_ARB_buffer_storage is available, otherwise each allocation maps its
+// range unsynchronized until commit(), which stays within GL 3.3 since draws cannot read a mapped buffer there
+class StreamBuffer
+{
+public:
+    static constexpr int REGIONS = 3;
+
+    struct Allocation
+    {
+        void *data = nullptr;
+        GLintptr offset = 0;
+    };
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+    // Usable as any kind of buffer, it is only ever bound to GL_COPY_WRITE_BUFFER here
+    StreamBuffer(Profiler &profiler, GLsizeiptr regionSize);
+    ~StreamBuffer();
+
+    void beginFrame();
+    // Null data when the region is full, only one allocation may be open at a time
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+    // Ends the writes to the last allocation, it may be drawn from afterwards
+    void commit();
+    // allocate() and commit() in one, offset of the copy in the buffer or -1 when it did not fit
+    GLintptr write(const void *data, GLsizeiptr size, GLsizeiptr alignment = 16);
+    void endFrame();
+
+    GLuint getBuffer() const;
+    bool isPersistent() const;
+    GLsizeiptr getRegionSize() const;
+
+private:
+    Profiler &_profiler;
+    const GLsizeiptr _regionSize;
+
+    GLuint _buffer = 0;
+    bool _persistent = false;
+    // Whole buffer when persistent, the open allocation otherwise
+    char *_mapped = nullptr;
+
+    GLsync _fences[REGIONS] = {};
+    int _region = 0;
+    GLsizeiptr _used = 0;
+    bool _inFrame = false;
+
+    GLintptr getRegionOffset() const;
+};
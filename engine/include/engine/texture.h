@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cstdint>
 #include <string>
 
 enum TextureType
@@ -10,6 +11,28 @@ enum TextureType
     EMISSION,
 };
 
+// Texture units the material maps are bound to, sampler uniforms are set to these at link time
+enum TextureUnit
+{
+    DIFFUSE_MAP_UNIT = 1,
+    SPECULAR_MAP_UNIT = 2,
+    EMISSION_MAP_UNIT = 3,
+    GBUFFER_ALBEDO_UNIT = 4,
+    GBUFFER_SPECULAR_UNIT = 5,
+    GBUFFER_NORMAL_UNIT = 6,
+    GBUFFER_EMISSION_UNIT = 7,
+    GBUFFER_DEPTH_UNIT = 8,
+    OUTLINE_SEED_UNIT = 9,
+    OIT_ACCUMULATION_UNIT = 10,
+    OIT_WEIGHT_UNIT = 11,
+    FALLBACK_UNIT = 12,
+    SHADOW_ATLAS_UNIT = 13,
+    INSTANCE_DATA_UNIT = 14,
+    INSTANCE_VISIBILITY_UNIT = 15,
+    DEPTH_PYRAMID_UNIT = 16,
+    SCENE_COLOR_UNIT = 17,
+};
+
 class Texture
 {
 public:
@@ -23,8 +46,22 @@ public:
 
     TextureType type;
 
+    // Binds to the unit, skipped for the material map units when it is already bound there
     void use(int index) const;
+    // Same for any texture, materials without a map bind a fallback. Unit 0 is active again afterwards
+    static void bind(int index, GLuint id);
+    // Forgets what the map units hold, for when something may have bound to them directly
+    static void resetBindings();
+    // Has texels the alpha test discards
+    bool hasCutout() const;
+    // Has texels in between opaque and discarded, beyond the edges of cutouts, and needs blending
+    bool hasPartialAlpha() const;
+    // Mip chain included
+    uint64_t getBytes() const;
 
 private:
     GLuint _id;
+    bool _hasCutout = false;
+    bool _hasPartialAlpha = false;
+    uint64_t _bytes = 0;
 };
@@ -15,6 +15,8 @@ public:
     glm::vec3 eulerAngles;
 
     glm::mat4 getMatrix() const;
+    // Blends position and scale linearly and rotation spherically, t = 0 gives from
+    static Transform interpolate(const Transform &from, const Transform &to, float t);
 
     glm::vec3 forward() const;
     glm::vec3 up() const;
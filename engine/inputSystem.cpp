@@ -0,0 +1,190 @@
+#include <engine/inputSystem.h>
+
+#include <algorithm>
+#include <cstring>
+
+InputSystem::InputSystem(GLFWwindow *window, bool rawMouseMotion)
+    : _window(window), _rawMouseMotion(rawMouseMotion && glfwRawMouseMotionSupported())
+{
+    _bindings.reserve(MAX_ACTIONS);
+}
+
+void InputSystem::push(const InputEvent &event)
+{
+    if (_pushed - _frameEnd >= CAPACITY)
+        _dropped++;
+    _events[_pushed % CAPACITY] = event;
+    _pushed++;
+
+    switch (event.type)
+    {
+    case KEY_EVENT:
+        if (event.code < 0 || event.code > GLFW_KEY_LAST)
+            break;
+        if (event.action == GLFW_PRESS)
+        {
+            _keys[event.code] = true;
+            _keysPressed[event.code] = true;
+            _keysPressedSinceFrame[event.code] = true;
+        }
+        else if (event.action == GLFW_RELEASE)
+        {
+            _keys[event.code] = false;
+            _keysReleased[event.code] = true;
+        }
+        break;
+
+    case MOUSE_BUTTON_EVENT:
+        if (event.code < 0 || event.code > GLFW_MOUSE_BUTTON_LAST)
+            break;
+        _buttons[event.code] = event.action == GLFW_PRESS;
+        _buttonsPressed[event.code] |= event.action == GLFW_PRESS;
+        _buttonsPressedSinceFrame[event.code] |= event.action == GLFW_PRESS;
+        break;
+
+    case MOUSE_MOVE_EVENT:
+        // The first position after a cursor mode change would be a jump
+        if (_hasPosition)
+            _delta += event.value - _position;
+        _position = event.value;
+        _hasPosition = true;
+        break;
+
+    case SCROLL_EVENT:
+        _scroll += event.value;
+        break;
+    }
+}
+
+void InputSystem::beginFrame()
+{
+    _frameBegin = std::max(_frameEnd, _pushed > CAPACITY ? _pushed - CAPACITY : 0ull);
+    _frameEnd = _pushed;
+
+    std::memcpy(_frameKeysPressed, _keysPressedSinceFrame, sizeof(_keysPressedSinceFrame));
+    std::memcpy(_frameButtonsPressed, _buttonsPressedSinceFrame, sizeof(_buttonsPressedSinceFrame));
+    _latchedDelta = glm::vec2(0.0f);
+
+    std::memset(_keysPressedSinceFrame, 0, sizeof(_keysPressedSinceFrame));
+    std::memset(_buttonsPressedSinceFrame, 0, sizeof(_buttonsPressedSinceFrame));
+}
+
+void InputSystem::beginUpdate()
+{
+    std::memcpy(_updateKeysPressed, _keysPressed, sizeof(_keysPressed));
+    std::memcpy(_updateKeysReleased, _keysReleased, sizeof(_keysReleased));
+    std::memcpy(_updateButtonsPressed, _buttonsPressed, sizeof(_buttonsPressed));
+    _updateDelta = _delta;
+    _updateScroll = _scroll;
+
+    std::memset(_keysPressed, 0, sizeof(_keysPressed));
+    std::memset(_keysReleased, 0, sizeof(_keysReleased));
+    std::memset(_buttonsPressed, 0, sizeof(_buttonsPressed));
+    _delta = glm::vec2(0.0f);
+    _scroll = glm::vec2(0.0f);
+}
+
+void InputSystem::latch()
+{
+    _latchedDelta += _delta;
+    _delta = glm::vec2(0.0f);
+}
+
+void InputSystem::setCursorMode(int mode)
+{
+    _cursorMode = mode;
+    _hasPosition = false;
+    applyCursorMode();
+}
+
+bool InputSystem::usesRawMouseMotion() const
+{
+    return _rawMouseMotion && _cursorMode == GLFW_CURSOR_DISABLED;
+}
+
+int InputSystem::getCursorMode() const { return _cursorMode; }
+
+void InputSystem::applyCursorMode()
+{
+    glfwSetInputMode(_window, GLFW_CURSOR, _cursorMode);
+
+    // Only has an effect while the cursor is disabled
+    if (_rawMouseMotion)
+        glfwSetInputMode(_window, GLFW_RAW_MOUSE_MOTION, _cursorMode == GLFW_CURSOR_DISABLED ? GLFW_TRUE : GLFW_FALSE);
+}
+
+void InputSystem::bind(int action, int key)
+{
+    if (action < 0 || action >= MAX_ACTIONS)
+        return;
+
+    _bindings.push_back({action, key});
+}
+
+ActionState InputSystem::getAction(int action) const
+{
+    ActionState state;
+    for (const Binding &binding : _bindings)
+    {
+        if (binding.action != action || binding.key < 0 || binding.key > GLFW_KEY_LAST)
+            continue;
+
+        state.down |= _keys[binding.key];
+        state.pressed |= _updateKeysPressed[binding.key];
+        state.released |= _updateKeysReleased[binding.key];
+    }
+
+    return state;
+}
+
+bool InputSystem::isKeyDown(int key) const
+{
+    return key >= 0 && key <= GLFW_KEY_LAST && _keys[key];
+}
+
+bool InputSystem::wasKeyPressed(int key) const
+{
+    return key >= 0 && key <= GLFW_KEY_LAST && _updateKeysPressed[key];
+}
+
+bool InputSystem::wasKeyPressedThisFrame(int key) const
+{
+    return key >= 0 && key <= GLFW_KEY_LAST && _frameKeysPressed[key];
+}
+
+bool InputSystem::isMouseButtonDown(int button) const
+{
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST && _buttons[button];
+}
+
+bool InputSystem::wasMouseButtonPressed(int button) const
+{
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST && _updateButtonsPressed[button];
+}
+
+bool InputSystem::wasMouseButtonPressedThisFrame(int button) const
+{
+    return button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST && _frameButtonsPressed[button];
+}
+
+glm::vec2 InputSystem::getMousePosition() const { return _position; }
+glm::vec2 InputSystem::getMouseDelta() const { return _updateDelta; }
+glm::vec2 InputSystem::getLatchedMouseDelta() const { return _latchedDelta; }
+glm::vec2 InputSystem::getScroll() const { return _updateScroll; }
+
+int InputSystem::getEventCount() const
+{
+    return _frameEnd - _frameBegin;
+}
+
+const InputEvent &InputSystem::getEvent(int index) const
+{
+    return _events[(_frameBegin + index) % CAPACITY];
+}
+
+double InputSystem::getOldestEventTime() const
+{
+    return getEventCount() > 0 ? getEvent(0).time : 0.0;
+}
+
+int InputSystem::getDroppedCount() const { return _dropped; }
@@ -0,0 +1,133 @@
+#include <engine/inspector.h>
+#include <engine/game.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+// Rows shown at once, the list scrolls past them
+static constexpr float VISIBLE_ROWS = 16.0f;
+
+void Inspector::draw(Game &game, const std::vector<Object *> &objects, bool objectsChanged, ObjectHandle &selected)
+{
+    _stale = _stale || objectsChanged;
+    if (_filter.Draw("Search"))
+        _dirty = true;
+
+    std::vector<const char *> typeNames = {"All types"};
+    for (const std::type_index &type : _types)
+        typeNames.push_back(_typeNames[type].c_str());
+    int type = _type + 1;
+    if (ImGui::Combo("Type", &type, typeNames.data(), typeNames.size()))
+    {
+        _type = type - 1;
+        _dirty = true;
+    }
+
+    double now = ImGui::GetTime();
+    if (_dirty || (_stale && now - _lastRefresh >= REFRESH_INTERVAL))
+    {
+        refresh(objects);
+        _lastRefresh = now;
+    }
+
+    bool filtering = isFiltering();
+    int count = filtering ? _rows.size() : objects.size();
+    ImGui::Text("%d of %d objects", count, (int)objects.size());
+
+    if (ImGui::BeginChild("Objects", ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * VISIBLE_ROWS)))
+    {
+        ImGuiListClipper clipper;
+        clipper.Begin(count);
+        while (clipper.Step())
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++)
+            {
+                Object *object = filtering ? game.get(_rows[i]) : objects[i];
+                if (!object)
+                {
+                    ImGui::TextDisabled("Destroyed");
+                    continue;
+                }
+
+                ObjectHandle handle = object->getHandle();
+                ImGui::PushID((int)handle.index);
+                if (ImGui::Selectable(object->objectName.c_str(), handle == selected))
+                    selected = handle;
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", getTypeName(*object).c_str());
+                ImGui::PopID();
+            }
+        clipper.End();
+    }
+    ImGui::EndChild();
+
+    if (Object *object = game.get(selected))
+    {
+        ImGui::SeparatorText("Selected");
+        ImGui::Text("%s, slot %u generation %u", getTypeName(*object).c_str(), selected.index, selected.generation);
+        ImGui::SetNextItemOpen(true, ImGuiCond_Appearing);
+        object->notification(Notification::IMGUI_DRAW);
+    }
+}
+
+bool Inspector::isFiltering() const
+{
+    return _filter.IsActive() || _type >= 0;
+}
+
+void Inspector::refresh(const std::vector<Object *> &objects)
+{
+    _dirty = false;
+    _stale = false;
+
+    std::optional<std::type_index> filterType;
+    if (_type >= 0)
+        filterType = _types[_type];
+
+    _types.clear();
+    _rows.clear();
+    for (Object *object : objects)
+    {
+        std::type_index type = typeid(*object);
+        if (std::find(_types.begin(), _types.end(), type) == _types.end())
+        {
+            _types.push_back(type);
+            getTypeName(*object);
+        }
+
+        if ((!filterType || type == *filterType) && _filter.PassFilter(object->objectName.c_str()))
+            _rows.push_back(object->getHandle());
+    }
+
+    // The type picked stays even once its objects are all gone
+    _type = -1;
+    if (filterType)
+    {
+        auto found = std::find(_types.begin(), _types.end(), *filterType);
+        if (found == _types.end())
+            found = _types.insert(_types.end(), *filterType);
+        _type = found - _types.begin();
+    }
+}
+
+const std::string &Inspector::getTypeName(const Object &object)
+{
+    std::type_index type = typeid(object);
+    auto found = _typeNames.find(type);
+    if (found != _typeNames.end())
+        return found->second;
+
+    std::string name = type.name();
+#ifdef __GNUG__
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    if (status == 0 && demangled)
+        name = demangled;
+    std::free(demangled);
+#endif
+    return _typeNames.emplace(type, name).first->second;
+}
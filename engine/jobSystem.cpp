@@ -0,0 +1,203 @@
+#include <engine/jobSystem.h>
+
+struct Job
+{
+    std::function<void()> function;
+    JobCounter *counter = nullptr;
+    // Dependencies not done yet, plus one while the job is being submitted
+    std::atomic<int> unresolved = 1;
+};
+
+// Queue of the running thread, threads outside the pool share the first one
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local int currentQueue = 0;
+
+bool JobCounter::isDone() const
+{
+    return _pending.load() == 0;
+}
+
+JobSystem::JobSystem(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+    for (int i = 0; i < threadCount; i++)
+        _queues.push_back(std::make_unique<Queue>());
+
+    for (int i = 1; i < threadCount; i++)
+        _workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+
+    for (std::thread &worker : _workers)
+        worker.join();
+
+    for (Job *job : _freeJobs)
+        delete job;
+}
+
+int JobSystem::getThreadCount() const { return _queues.size(); }
+
+void JobSystem::run(std::function<void()> function, JobCounter *counter, const std::vector<JobCounter *> &dependencies)
+{
+    Job *job = acquireJob(std::move(function), counter);
+    if (counter)
+        counter->_pending++;
+
+    for (JobCounter *dependency : dependencies)
+    {
+        std::lock_guard<std::mutex> lock(dependency->_mutex);
+        if (dependency->_pending == 0)
+            continue;
+
+        job->unresolved++;
+        dependency->_waiting.push_back(job);
+    }
+
+    if (--job->unresolved == 0)
+        enqueue(job);
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    while (!counter.isDone())
+    {
+        if (Job *job = take(getQueueIndex()))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last job may still be releasing its dependents, the counter must outlive that
+    std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+Job *JobSystem::acquireJob(std::function<void()> function, JobCounter *counter)
+{
+    Job *job = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        if (!_freeJobs.empty())
+        {
+            job = _freeJobs.back();
+            _freeJobs.pop_back();
+        }
+    }
+
+    if (!job)
+        return new Job{std::move(function), counter};
+
+    job->function = std::move(function);
+    job->counter = counter;
+    job->unresolved = 1;
+    return job;
+}
+
+void JobSystem::enqueue(Job *job)
+{
+    Queue &queue = *_queues[getQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    _queued++;
+
+    // Taking the lock orders this with a worker about to sleep, otherwise the wake up could be lost
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wake.notify_one();
+}
+
+Job *JobSystem::take(int index)
+{
+    // Own jobs newest first while they are still in cache, others' oldest first
+    for (int i = 0; i < _queues.size(); i++)
+    {
+        Queue &queue = *_queues[(index + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+
+        Job *job;
+        if (i == 0)
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+
+        _queued--;
+        return job;
+    }
+
+    return nullptr;
+}
+
+void JobSystem::execute(Job *job)
+{
+    job->function();
+
+    // Captures are released before the counter tells anyone they are done
+    job->function = nullptr;
+    JobCounter *counter = job->counter;
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        _freeJobs.push_back(job);
+    }
+
+    if (counter)
+        finish(*counter);
+}
+
+void JobSystem::finish(JobCounter &counter)
+{
+    std::vector<Job *> released;
+    {
+        std::lock_guard<std::mutex> lock(counter._mutex);
+        if (--counter._pending != 0)
+            return;
+
+        released.swap(counter._waiting);
+    }
+
+    for (Job *job : released)
+        if (--job->unresolved == 0)
+            enqueue(job);
+}
+
+void JobSystem::workerLoop(int index)
+{
+    currentSystem = this;
+    currentQueue = index;
+
+    while (!_quit)
+    {
+        if (Job *job = take(index))
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this]
+                   { return _quit || _queued > 0; });
+    }
+}
+
+int JobSystem::getQueueIndex() const
+{
+    return currentSystem == this ? currentQueue : 0;
+}
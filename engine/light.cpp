@@ -1,7 +1,32 @@
 #include <engine/light.h>
 #include <engine/game.h>
+#include <cmath>
 #include <format>
 
+// Point and spot lights further than this are never given a bigger range
+static constexpr float MAX_LIGHT_RANGE = 100.0f;
+
+// Builds "array[index].member" in place, setting light uniforms never touches the heap
+class UniformName
+{
+public:
+    UniformName(const char *array, int index)
+    {
+        _prefixLength = std::format_to_n(_buffer, sizeof(_buffer) - 1, "{}[{}].", array, index).out - _buffer;
+    }
+
+    const char *operator()(const char *member)
+    {
+        char *end = std::format_to_n(_buffer + _prefixLength, sizeof(_buffer) - 1 - _prefixLength, "{}", member).out;
+        *end = '\0';
+        return _buffer;
+    }
+
+private:
+    char _buffer[64];
+    int _prefixLength;
+};
+
 void Light::onNotification(Notification type)
 {
     switch (type)
@@ -13,60 +38,86 @@ void Light::onNotification(Notification type)
     }
 }
 
-void Light::setUniforms(Shader &shader) const
+void Light::setUniforms(const Shader &shader) const
 {
 }
 
-void DirectionalLight::setUniforms(Shader &shader) const
+void DirectionalLight::setUniforms(const Shader &shader) const
 {
-    std::string prefix = std::format("directionalLights[{}]", count);
+    UniformName name("directionalLights", count);
 
-    shader.setUniform(prefix + ".direction", transform.rotation * glm::vec3(0.0f, 0.0f, 1.0f));
-    shader.setUniform(prefix + ".ambient", ambient);
-    shader.setUniform(prefix + ".diffuse", diffuse);
-    shader.setUniform(prefix + ".specular", specular);
+    shader.setUniform(name("direction"), transform.rotation * glm::vec3(0.0f, 0.0f, 1.0f));
+    shader.setUniform(name("ambient"), ambient);
+    shader.setUniform(name("diffuse"), diffuse);
+    shader.setUniform(name("specular"), specular);
+    shader.setUniform(name("shadowTile"), shadowTile);
 
     count++;
     shader.setUniform("directionalLightsCount", count);
 }
 
-void PointLight::setUniforms(Shader &shader) const
+void PointLight::setUniforms(const Shader &shader) const
 {
+    UniformName name("pointLights", count);
 
-    std::string prefix = std::format("pointLights[{}]", count);
-
-    shader.setUniform(prefix + ".position", transform.position);
-    shader.setUniform(prefix + ".ambient", ambient);
-    shader.setUniform(prefix + ".diffuse", diffuse);
-    shader.setUniform(prefix + ".specular", specular);
-    shader.setUniform(prefix + ".constant", constant);
-    shader.setUniform(prefix + ".linear", linear);
-    shader.setUniform(prefix + ".quadratic", quadratic);
+    shader.setUniform(name("position"), transform.position);
+    shader.setUniform(name("ambient"), ambient);
+    shader.setUniform(name("diffuse"), diffuse);
+    shader.setUniform(name("specular"), specular);
+    shader.setUniform(name("shadowTile"), shadowTile);
+    shader.setUniform(name("constant"), constant);
+    shader.setUniform(name("linear"), linear);
+    shader.setUniform(name("quadratic"), quadratic);
 
     count++;
     shader.setUniform("pointLightsCount", count);
 }
 
-void SpotLight::setUniforms(Shader &shader) const
+void SpotLight::setUniforms(const Shader &shader) const
 {
+    UniformName name("spotLights", count);
 
-    std::string prefix = std::format("spotLights[{}]", count);
-
-    shader.setUniform(prefix + ".position", transform.position);
-    shader.setUniform(prefix + ".direction", transform.rotation * glm::vec3(0.0f, 0.0f, 1.0f));
-    shader.setUniform(prefix + ".cutOff", glm::cos(cutOff));
-    shader.setUniform(prefix + ".outerCutOff", glm::cos(outerCutOff));
-    shader.setUniform(prefix + ".ambient", ambient);
-    shader.setUniform(prefix + ".diffuse", diffuse);
-    shader.setUniform(prefix + ".specular", specular);
-    shader.setUniform(prefix + ".constant", constant);
-    shader.setUniform(prefix + ".linear", linear);
-    shader.setUniform(prefix + ".quadratic", quadratic);
+    shader.setUniform(name("position"), transform.position);
+    shader.setUniform(name("direction"), transform.rotation * glm::vec3(0.0f, 0.0f, 1.0f));
+    shader.setUniform(name("cutOff"), glm::cos(cutOff));
+    shader.setUniform(name("outerCutOff"), glm::cos(outerCutOff));
+    shader.setUniform(name("ambient"), ambient);
+    shader.setUniform(name("diffuse"), diffuse);
+    shader.setUniform(name("specular"), specular);
+    shader.setUniform(name("shadowTile"), shadowTile);
+    shader.setUniform(name("constant"), constant);
+    shader.setUniform(name("linear"), linear);
+    shader.setUniform(name("quadratic"), quadratic);
 
     count++;
     shader.setUniform("spotLightsCount", count);
 }
 
+float PointLight::getRange() const
+{
+    float brightest = 0.0f;
+    for (const glm::vec3 &color : {ambient, diffuse, specular})
+        brightest = glm::max(brightest, glm::max(color.x, glm::max(color.y, color.z)));
+
+    float threshold = brightest * 256.0f / 5.0f;
+    float shifted = constant - threshold;
+
+    if (quadratic > 0.0f)
+    {
+        float discriminant = linear * linear - 4.0f * quadratic * shifted;
+        if (discriminant < 0.0f)
+            return 0.0f;
+
+        float range = (-linear + std::sqrt(discriminant)) / (2.0f * quadratic);
+        return glm::clamp(range, 0.0f, MAX_LIGHT_RANGE);
+    }
+
+    if (linear > 0.0f)
+        return glm::clamp(-shifted / linear, 0.0f, MAX_LIGHT_RANGE);
+
+    return MAX_LIGHT_RANGE;
+}
+
 int PointLight::count = 0;
 int DirectionalLight::count = 0;
 int SpotLight::count = 0;
@@ -0,0 +1,188 @@
+#include <engine/materialRegistry.h>
+#include <engine/resourceTracker.h>
+
+#include <algorithm>
+#include <iostream>
+#include <tuple>
+
+MaterialRegistry::MaterialRegistry(GLuint fallbackTexture) : _fallbackTexture(fallbackTexture)
+{
+    _materials.reserve(MAX_MATERIALS);
+    _data.reserve(MAX_MATERIALS);
+    _states.reserve(MAX_MATERIALS);
+
+    glGenBuffers(1, &_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _ubo, RESOURCE_BUFFER, "Materials", MAX_MATERIALS * sizeof(MaterialData));
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, UniformBlock::MATERIALS_BLOCK, _ubo);
+
+    // Handle 0 is always the default material
+    intern(Material{});
+}
+
+MaterialRegistry::~MaterialRegistry()
+{
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _ubo);
+    glDeleteBuffers(1, &_ubo);
+}
+
+MaterialHandle MaterialRegistry::intern(const Material &material)
+{
+    // The palette is small, a linear scan is enough
+    for (MaterialHandle i = 0; i < _materials.size(); i++)
+        if (isSame(_materials[i], material))
+            return i;
+
+    if (_materials.size() >= MAX_MATERIALS)
+    {
+        std::cout << "ERROR::MATERIAL_REGISTRY::FULL " << material.name << std::endl;
+        return 0;
+    }
+
+    MaterialHandle handle = _materials.size();
+    _materials.push_back(material);
+    _data.push_back(pack(material));
+    markDirty(handle);
+
+    return handle;
+}
+
+void MaterialRegistry::update(MaterialHandle handle, const Material &material)
+{
+    _materials[handle] = material;
+    _data[handle] = pack(material);
+    markDirty(handle);
+}
+
+const Material &MaterialRegistry::get(MaterialHandle handle) const { return _materials[handle]; }
+unsigned int MaterialRegistry::size() const { return _materials.size(); }
+
+bool MaterialRegistry::isTransparent(MaterialHandle handle) const { return _states[handle].transparent; }
+bool MaterialRegistry::needsAlphaTest(MaterialHandle handle) const { return _states[handle].alphaTest; }
+
+void MaterialRegistry::upload()
+{
+    MaterialUpload pending;
+    takeUpload(pending);
+    upload(pending);
+}
+
+void MaterialRegistry::takeUpload(MaterialUpload &upload)
+{
+    upload.begin = _dirtyBegin;
+    upload.data.assign(_data.begin() + _dirtyBegin, _data.begin() + _dirtyEnd);
+    upload.states.clear();
+    for (unsigned int i = _dirtyBegin; i < _dirtyEnd; i++)
+        upload.states.push_back(getState(_materials[i]));
+
+    _dirtyBegin = _dirtyEnd = 0;
+}
+
+void MaterialRegistry::upload(const MaterialUpload &upload)
+{
+    if (upload.data.empty())
+        return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER,
+                    upload.begin * sizeof(MaterialData),
+                    upload.data.size() * sizeof(MaterialData),
+                    upload.data.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    if (_states.size() < upload.begin + upload.states.size())
+        _states.resize(upload.begin + upload.states.size());
+    std::copy(upload.states.begin(), upload.states.end(), _states.begin() + upload.begin);
+}
+
+void MaterialRegistry::use(MaterialHandle handle, const Shader &shader) const
+{
+    bindMaps(handle);
+    shader.setUniform("materialIndex", (int)handle);
+}
+
+void MaterialRegistry::bindMaps(MaterialHandle handle) const
+{
+    const MaterialState &material = _states[handle];
+
+    // Sampler uniforms are fixed to their units at link time, only the bindings change, and not at all when the
+    // previous draw used the same maps
+    bindMap(material.diffuseMap.get(), TextureUnit::DIFFUSE_MAP_UNIT);
+    bindMap(material.specularMap.get(), TextureUnit::SPECULAR_MAP_UNIT);
+    bindMap(material.emissionMap.get(), TextureUnit::EMISSION_MAP_UNIT);
+}
+
+bool MaterialRegistry::hasSameMaps(MaterialHandle a, MaterialHandle b) const
+{
+    const MaterialState &first = _states[a];
+    const MaterialState &second = _states[b];
+    return first.diffuseMap == second.diffuseMap && first.specularMap == second.specularMap &&
+           first.emissionMap == second.emissionMap;
+}
+
+bool MaterialRegistry::isBeforeByMaps(MaterialHandle a, MaterialHandle b) const
+{
+    const MaterialState &first = _states[a];
+    const MaterialState &second = _states[b];
+    return std::tie(first.diffuseMap, first.specularMap, first.emissionMap) <
+           std::tie(second.diffuseMap, second.specularMap, second.emissionMap);
+}
+
+void MaterialRegistry::bindMap(const Texture *texture, int unit) const
+{
+    if (texture)
+        texture->use(unit);
+    else
+        Texture::bind(unit, _fallbackTexture);
+}
+
+void MaterialRegistry::markDirty(MaterialHandle handle)
+{
+    if (_dirtyBegin == _dirtyEnd)
+    {
+        _dirtyBegin = handle;
+        _dirtyEnd = handle + 1;
+        return;
+    }
+
+    _dirtyBegin = std::min(_dirtyBegin, handle);
+    _dirtyEnd = std::max(_dirtyEnd, handle + 1);
+}
+
+MaterialData MaterialRegistry::pack(const Material &material)
+{
+    return {
+        .ambient = glm::vec4(material.ambient, 1.0f),
+        .diffuse = material.diffuse,
+        .specular = glm::vec4(material.specular, material.shininess),
+        .emission = glm::vec4(material.emission, 1.0f),
+    };
+}
+
+MaterialState MaterialRegistry::getState(const Material &material)
+{
+    const Texture *diffuseMap = material.diffuseMap.get();
+    return {
+        .diffuseMap = material.diffuseMap,
+        .specularMap = material.specularMap,
+        .emissionMap = material.emissionMap,
+        .transparent = material.diffuse.a < 1.0f || (diffuseMap && diffuseMap->hasPartialAlpha()),
+        .alphaTest = diffuseMap && (diffuseMap->hasCutout() || diffuseMap->hasPartialAlpha()),
+    };
+}
+
+bool MaterialRegistry::isSame(const Material &a, const Material &b)
+{
+    // The name is only for the editor, it does not make a material different on the GPU
+    return a.ambient == b.ambient &&
+           a.diffuse == b.diffuse &&
+           a.specular == b.specular &&
+           a.emission == b.emission &&
+           a.shininess == b.shininess &&
+           a.diffuseMap == b.diffuseMap &&
+           a.specularMap == b.specularMap &&
+           a.emissionMap == b.emissionMap;
+}
@@ -1,5 +1,8 @@
 #include <engine/mesh.h>
+#include <engine/metrics.h>
+#include <engine/resourceTracker.h>
 #include <assimp/postprocess.h>
+#include <chrono>
 
 Mesh::Mesh(const std::vector<Vertex> &vertices,
            const std::vector<unsigned int> &indices,
@@ -10,6 +13,18 @@ Mesh::Mesh(const std::vector<Vertex> &vertices,
 Mesh::Mesh(const std::vector<Vertex> &vertices,
            const std::vector<unsigned int> &indices)
 {
+    if (!vertices.empty())
+        _bounds = {vertices[0].position, vertices[0].position};
+
+    _positions.reserve(vertices.size());
+    for (const Vertex &vertex : vertices)
+    {
+        _bounds.min = glm::min(_bounds.min, vertex.position);
+        _bounds.max = glm::max(_bounds.max, vertex.position);
+        _positions.push_back(vertex.position);
+    }
+    _indices = indices;
+
     glGenVertexArrays(1, &_vao);
     glGenBuffers(1, &_vbo);
     glGenBuffers(1, &_ebo);
@@ -40,16 +55,79 @@ Mesh::Mesh(const std::vector<Vertex> &vertices,
     glEnableVertexAttribArray(2);
 
     glBindVertexArray(0);
+
+    GLsizeiptr vertexBytes = vertices.size() * sizeof(Vertex);
+    GLsizeiptr indexBytes = _indicesCount * sizeof(unsigned int);
+    _bufferBytes = vertexBytes + indexBytes;
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _vbo, RESOURCE_GEOMETRY, vertexBytes);
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _ebo, RESOURCE_GEOMETRY, indexBytes);
+    ResourceTracker::track(RESOURCE_HOST, (uintptr_t)this, RESOURCE_GEOMETRY_COPY, getSystemBytes());
 }
 
 Mesh::~Mesh()
 {
+    ResourceTracker::release(RESOURCE_HOST, (uintptr_t)this);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _ebo);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _vbo);
     glDeleteBuffers(1, &_ebo);
     glDeleteBuffers(1, &_vbo);
     glDeleteVertexArrays(1, &_vao);
 }
 
-void Mesh::draw(const Shader &shader) const
+const AABB &Mesh::getBounds() const
+{
+    return _bounds;
+}
+
+const std::vector<glm::vec3> &Mesh::getPositions() const
+{
+    return _positions;
+}
+
+const std::vector<unsigned int> &Mesh::getIndices() const
+{
+    return _indices;
+}
+
+uint64_t Mesh::getGpuBytes() const
+{
+    uint64_t bytes = _bufferBytes;
+    for (const Texture &texture : _textures)
+        bytes += texture.getBytes();
+    return bytes;
+}
+
+uint64_t Mesh::getSystemBytes() const
+{
+    return _positions.capacity() * sizeof(glm::vec3) + _indices.capacity() * sizeof(unsigned int);
+}
+
+bool Mesh::raycast(const Ray &ray, const glm::mat4 &model, float maxDistance, float &distance) const
+{
+    // Left unnormalized, distances along it are then the same as along the original ray
+    glm::mat4 inverse = glm::inverse(model);
+    Ray local = {glm::vec3(inverse * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverse * glm::vec4(ray.direction, 0.0f))};
+
+    float closest = maxDistance;
+    if (!local.intersects(_bounds, closest, distance))
+        return false;
+
+    bool hit = false;
+    for (size_t i = 0; i + 2 < _indices.size(); i += 3)
+    {
+        float triangleDistance;
+        if (local.intersects(_positions[_indices[i]], _positions[_indices[i + 1]], _positions[_indices[i + 2]], closest, triangleDistance))
+        {
+            closest = triangleDistance;
+            hit = true;
+        }
+    }
+
+    distance = closest;
+    return hit;
+}
+
+void Mesh::draw(const Shader &shader, GLsizei instances) const
 {
     bool culled = false;
     if (!cullFaces)
@@ -58,24 +136,25 @@ void Mesh::draw(const Shader &shader) const
         culled = true;
     }
 
-    for (int i = 0; i < _textures.size(); i++)
+    // Textures embedded in the mesh override the material maps
+    for (const Texture &texture : _textures)
     {
-        const Texture &texture = _textures[i];
-        texture.use(i);
-
         switch (texture.type)
         {
         case TextureType::DIFFUSE:
-            shader.setUniform("material.diffuseMap", i);
+            texture.use(TextureUnit::DIFFUSE_MAP_UNIT);
+            break;
         case TextureType::SPECULAR:
-            shader.setUniform("material.specularMap", i);
+            texture.use(TextureUnit::SPECULAR_MAP_UNIT);
+            break;
         case TextureType::EMISSION:
-            shader.setUniform("material.emissionMap", i);
+            texture.use(TextureUnit::EMISSION_MAP_UNIT);
+            break;
         }
     }
 
     glBindVertexArray(_vao);
-    glDrawElements(GL_TRIANGLES, _indicesCount, GL_UNSIGNED_INT, 0);
+    glDrawElementsInstanced(GL_TRIANGLES, _indicesCount, GL_UNSIGNED_INT, 0, instances);
 
     glBindVertexArray(0);
 
@@ -86,17 +165,30 @@ void Mesh::draw(const Shader &shader) const
 
 Model::Model(const std::string &path)
 {
+    static MetricHistogram &loadTime = Metrics::histogram("engine_model_load_seconds", "Time to load a model and its textures from disk",
+                                                          {0.01, 0.05, 0.1, 0.5, 1.0, 5.0, 10.0});
+    static MetricGauge &loading = Metrics::gauge("engine_assets_loading", "Textures and models being loaded");
+    auto start = std::chrono::steady_clock::now();
+
     Assimp::Importer importer;
+    loading.add(1.0);
     const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        loading.add(-1.0);
         return;
     }
     _directory = path.substr(0, path.find_last_of('/'));
 
+    // Textures are tracked under their own path
+    ResourceTracker::beginOwner(path);
     processNode(scene->mRootNode, scene);
+    ResourceTracker::endOwner();
+
+    loading.add(-1.0);
+    loadTime.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 }
 
 void Model::processNode(aiNode *node, const aiScene *scene)
@@ -204,4 +296,22 @@ void Model::draw(const Shader &shader) const
 {
     for (const std::unique_ptr<Mesh> &mesh : _meshes)
         mesh->draw(shader);
+}
+
+const std::vector<std::unique_ptr<Mesh>> &Model::getMeshes() const { return _meshes; }
+
+uint64_t Model::getGpuBytes() const
+{
+    uint64_t bytes = 0;
+    for (const std::unique_ptr<Mesh> &mesh : _meshes)
+        bytes += mesh->getGpuBytes();
+    return bytes;
+}
+
+uint64_t Model::getSystemBytes() const
+{
+    uint64_t bytes = 0;
+    for (const std::unique_ptr<Mesh> &mesh : _meshes)
+        bytes += mesh->getSystemBytes();
+    return bytes;
 }
\ No newline at end of file
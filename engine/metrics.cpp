@@ -0,0 +1,204 @@
+#include <engine/metrics.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+static std::mutex mutex;
+static std::vector<std::unique_ptr<MetricCounter>> counters;
+static std::vector<std::unique_ptr<MetricGauge>> gauges;
+static std::vector<std::unique_ptr<MetricHistogram>> histograms;
+
+static std::atomic<int> nextShard = 0;
+static thread_local int shard = -1;
+
+static int getShard()
+{
+    if (shard < 0)
+        shard = nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+template <typename T>
+static T *find(const std::vector<std::unique_ptr<T>> &metrics, const char *name)
+{
+    for (const std::unique_ptr<T> &metric : metrics)
+        if (metric->getName() == name || std::strcmp(metric->getName(), name) == 0)
+            return metric.get();
+    return nullptr;
+}
+
+static void appendFormat(std::string &text, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    text.append(line, std::clamp(length, 0, (int)sizeof(line) - 1));
+}
+
+static void appendHeader(std::string &text, const char *name, const char *help, const char *type)
+{
+    // Help texts may not fit a formatted line
+    text.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    text.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+MetricCounter &Metrics::counter(const char *name, const char *help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (MetricCounter *counter = find(counters, name))
+        return *counter;
+    return *counters.emplace_back(std::make_unique<MetricCounter>(name, help));
+}
+
+MetricGauge &Metrics::gauge(const char *name, const char *help)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (MetricGauge *gauge = find(gauges, name))
+        return *gauge;
+    return *gauges.emplace_back(std::make_unique<MetricGauge>(name, help));
+}
+
+MetricHistogram &Metrics::histogram(const char *name, const char *help, const std::vector<double> &bounds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (MetricHistogram *histogram = find(histograms, name))
+        return *histogram;
+    return *histograms.emplace_back(std::make_unique<MetricHistogram>(name, help, bounds));
+}
+
+void Metrics::writePrometheus(std::string &text)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::unique_ptr<MetricCounter> &counter : counters)
+    {
+        appendHeader(text, counter->getName(), counter->getHelp(), "counter");
+        appendFormat(text, "%s %" PRIu64 "\n", counter->getName(), counter->get());
+    }
+
+    for (const std::unique_ptr<MetricGauge> &gauge : gauges)
+    {
+        appendHeader(text, gauge->getName(), gauge->getHelp(), "gauge");
+        appendFormat(text, "%s %.17g\n", gauge->getName(), gauge->get());
+    }
+
+    std::vector<uint64_t> buckets;
+    for (const std::unique_ptr<MetricHistogram> &histogram : histograms)
+    {
+        const char *name = histogram->getName();
+        appendHeader(text, name, histogram->getHelp(), "histogram");
+
+        // Cumulative in the exposition format
+        histogram->getBuckets(buckets);
+        const std::vector<double> &bounds = histogram->getBounds();
+        uint64_t cumulative = 0;
+        for (int i = 0; i < bounds.size(); i++)
+        {
+            cumulative += buckets[i];
+            appendFormat(text, "%s_bucket{le=\"%g\"} %" PRIu64 "\n", name, bounds[i], cumulative);
+        }
+        cumulative += buckets.back();
+        appendFormat(text, "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", name, cumulative);
+        appendFormat(text, "%s_sum %.17g\n%s_count %" PRIu64 "\n", name, histogram->getSum(), name, cumulative);
+    }
+}
+
+void Metrics::getSamples(std::vector<Sample> &samples)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    samples.clear();
+    for (const std::unique_ptr<MetricCounter> &counter : counters)
+        samples.push_back({counter->getName(), "", (double)counter->get()});
+    for (const std::unique_ptr<MetricGauge> &gauge : gauges)
+        samples.push_back({gauge->getName(), "", gauge->get()});
+    for (const std::unique_ptr<MetricHistogram> &histogram : histograms)
+    {
+        samples.push_back({histogram->getName(), "_count", (double)histogram->getCount()});
+        samples.push_back({histogram->getName(), "_sum", histogram->getSum()});
+    }
+}
+
+MetricCounter::MetricCounter(const char *name, const char *help) : _name(name), _help(help) {}
+
+void MetricCounter::record(uint64_t value)
+{
+    _shards[getShard()].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricCounter::get() const
+{
+    uint64_t value = 0;
+    for (const Shard &shard : _shards)
+        value += shard.value.load(std::memory_order_relaxed);
+    return value;
+}
+
+const char *MetricCounter::getName() const { return _name; }
+
+const char *MetricCounter::getHelp() const { return _help; }
+
+MetricGauge::MetricGauge(const char *name, const char *help) : _name(name), _help(help) {}
+
+double MetricGauge::get() const
+{
+    return _value.load(std::memory_order_relaxed);
+}
+
+const char *MetricGauge::getName() const { return _name; }
+
+const char *MetricGauge::getHelp() const { return _help; }
+
+MetricHistogram::MetricHistogram(const char *name, const char *help, const std::vector<double> &bounds)
+    : _name(name), _help(help), _bounds(bounds)
+{
+    for (Shard &shard : _shards)
+    {
+        shard.buckets = std::make_unique<std::atomic<uint64_t>[]>(_bounds.size() + 1);
+        for (int i = 0; i <= _bounds.size(); i++)
+            shard.buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::record(double value)
+{
+    int bucket = std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+    Shard &shard = _shards[getShard()];
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+const std::vector<double> &MetricHistogram::getBounds() const { return _bounds; }
+
+void MetricHistogram::getBuckets(std::vector<uint64_t> &buckets) const
+{
+    buckets.assign(_bounds.size() + 1, 0);
+    for (const Shard &shard : _shards)
+        for (int i = 0; i < buckets.size(); i++)
+            buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getCount() const
+{
+    uint64_t count = 0;
+    for (const Shard &shard : _shards)
+        count += shard.count.load(std::memory_order_relaxed);
+    return count;
+}
+
+double MetricHistogram::getSum() const
+{
+    double sum = 0.0;
+    for (const Shard &shard : _shards)
+        sum += shard.sum.load(std::memory_order_relaxed);
+    return sum;
+}
+
+const char *MetricHistogram::getName() const { return _name; }
+
+const char *MetricHistogram::getHelp() const { return _help; }
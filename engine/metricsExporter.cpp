@@ -0,0 +1,182 @@
+#include <engine/metricsExporter.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+// How long the server waits for a connection before checking whether it should quit, in milliseconds
+static constexpr int ACCEPT_TIMEOUT = 100;
+
+static bool endsWith(const std::string &text, const char *suffix)
+{
+    size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+MetricsExporter::MetricsExporter(const std::string &address, const std::string &logPath)
+{
+    Metrics::setEnabled(true);
+
+    if (!address.empty() && listen(address))
+        _server = std::thread(&MetricsExporter::serve, this);
+
+    if (!logPath.empty())
+    {
+        _log = std::fopen(logPath.c_str(), "a");
+        if (!_log)
+            std::cout << "ERROR::METRICS_EXPORTER::FILE_NOT_OPENED " << logPath << std::endl;
+        _csv = endsWith(logPath, ".csv");
+    }
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    _quit = true;
+    if (_server.joinable())
+        _server.join();
+
+    if (_listener >= 0)
+        close(_listener);
+    if (!_socketPath.empty())
+        unlink(_socketPath.c_str());
+    if (_log)
+        std::fclose(_log);
+
+    Metrics::setEnabled(false);
+}
+
+bool MetricsExporter::listen(const std::string &address)
+{
+    if (address.rfind("unix:", 0) == 0)
+    {
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+        {
+            std::cout << "ERROR::METRICS_EXPORTER::INVALID_ADDRESS " << address << std::endl;
+            return false;
+        }
+        std::strcpy(local.sun_path, path.c_str());
+
+        // Left behind by a run that did not exit cleanly
+        unlink(path.c_str());
+        _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_listener >= 0 && bind(_listener, (sockaddr *)&local, sizeof(local)) == 0)
+            _socketPath = path;
+        else
+        {
+            std::cout << "ERROR::METRICS_EXPORTER::BIND_FAILED " << address << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        int port = std::atoi(address.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+
+        sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &local.sin_addr) != 1)
+        {
+            std::cout << "ERROR::METRICS_EXPORTER::INVALID_ADDRESS " << address << std::endl;
+            return false;
+        }
+
+        _listener = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (_listener >= 0)
+            setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (_listener < 0 || bind(_listener, (sockaddr *)&local, sizeof(local)) != 0)
+        {
+            std::cout << "ERROR::METRICS_EXPORTER::BIND_FAILED " << address << std::endl;
+            return false;
+        }
+    }
+
+    if (::listen(_listener, 4) != 0)
+    {
+        std::cout << "ERROR::METRICS_EXPORTER::LISTEN_FAILED " << address << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::serve()
+{
+    std::string body;
+    std::string response;
+    while (!_quit)
+    {
+        pollfd listener = {_listener, POLLIN, 0};
+        if (poll(&listener, 1, ACCEPT_TIMEOUT) <= 0)
+            continue;
+
+        int client = accept(_listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+
+        // The request itself does not matter, it is read so closing does not reset the connection under the client
+        pollfd request = {client, POLLIN, 0};
+        char buffer[1024];
+        if (poll(&request, 1, ACCEPT_TIMEOUT) > 0)
+            recv(client, buffer, sizeof(buffer), 0);
+
+        body.clear();
+        Metrics::writePrometheus(body);
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size()) +
+                   "\r\nConnection: close\r\n\r\n" + body;
+
+        for (size_t sent = 0; sent < response.size();)
+        {
+            ssize_t result = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0)
+                break;
+            sent += result;
+        }
+        close(client);
+    }
+}
+
+void MetricsExporter::log(int frame, double time)
+{
+    if (!_log)
+        return;
+
+    Metrics::getSamples(_samples);
+
+    if (_csv)
+    {
+        if (_loggedCount != _samples.size())
+        {
+            std::fprintf(_log, "frame,time");
+            for (const Metrics::Sample &sample : _samples)
+                std::fprintf(_log, ",%s%s", sample.name, sample.suffix);
+            std::fprintf(_log, "\n");
+            _loggedCount = _samples.size();
+        }
+
+        std::fprintf(_log, "%d,%.3f", frame, time);
+        for (const Metrics::Sample &sample : _samples)
+            std::fprintf(_log, ",%.17g", sample.value);
+        std::fprintf(_log, "\n");
+    }
+    else
+    {
+        std::fprintf(_log, "{\"frame\": %d, \"time\": %.3f", frame, time);
+        for (const Metrics::Sample &sample : _samples)
+            std::fprintf(_log, ", \"%s%s\": %.17g", sample.name, sample.suffix, sample.value);
+        std::fprintf(_log, "}\n");
+    }
+
+    // A soak test may be killed rather than closed
+    std::fflush(_log);
+}
@@ -1,4 +1,5 @@
 #include <engine/object.h>
+#include <engine/game.h>
 
 #include <imgui.h>
 
@@ -19,9 +20,10 @@ void Object::notification(Notification type)
     onNotification(type);
 }
 
-void Object::init(Game &game)
+void Object::init(Game &game, ObjectHandle handle)
 {
     _game = &game;
+    _handle = handle;
 }
 
 Game &Object::getGame() const
@@ -29,4 +31,42 @@ Game &Object::getGame() const
     return *_game;
 }
 
+ObjectHandle Object::getHandle() const { return _handle; }
+bool Object::isDespawned() const { return _despawned; }
+
+void Object::resetInterpolation()
+{
+    _previousTransform = transform;
+}
+
+void Object::setBounds(const AABB &bounds)
+{
+    _bounds = bounds;
+    if (_hasBounds)
+        return;
+
+    _hasBounds = true;
+    // Objects still being set up are indexed when they join
+    if (_game)
+        _game->indexObject(this);
+}
+
+bool Object::hasBounds() const { return _hasBounds; }
+
+float Object::raycast(const Ray &ray, float maxDistance) const
+{
+    float distance;
+    return ray.intersects(_bounds.transformed(transform.getMatrix()), maxDistance, distance) ? distance : -1.0f;
+}
+
+void Object::runConcurrently(Notification type)
+{
+    _concurrentNotifications |= 1u << type;
+}
+
+bool Object::runsConcurrently(Notification type) const
+{
+    return _concurrentNotifications & (1u << type);
+}
+
 void Object::onNotification(Notification type) {}
\ No newline at end of file
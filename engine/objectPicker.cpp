@@ -0,0 +1,291 @@
+#include <engine/objectPicker.h>
+#include <engine/camera.h>
+#include <engine/profiler.h>
+#include <engine/renderer.h>
+#include <engine/resourceTracker.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "imgui.h"
+
+static float millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ObjectPicker::ObjectPicker(Profiler &profiler, const glm::vec2 &size)
+    : _profiler(profiler), _size(size)
+{
+    _shader = std::make_unique<Shader>("./shaders/depth.vs", "./shaders/pick.fs");
+
+    for (Readback &readback : _readbacks)
+    {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, REGION_SIZE * REGION_SIZE * sizeof(uint32_t), nullptr, GL_STREAM_READ);
+        ResourceTracker::track(RESOURCE_GL_BUFFER, readback.buffer, RESOURCE_BUFFER, "Object picker",
+                               REGION_SIZE * REGION_SIZE * sizeof(uint32_t));
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    createTargets();
+}
+
+ObjectPicker::~ObjectPicker()
+{
+    destroyTargets();
+
+    for (Readback &readback : _readbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        ResourceTracker::release(RESOURCE_GL_BUFFER, readback.buffer);
+        glDeleteBuffers(1, &readback.buffer);
+    }
+}
+
+void ObjectPicker::request(const glm::ivec2 &pixel)
+{
+    _request = pixel;
+}
+
+void ObjectPicker::render(const Camera &camera, const std::vector<DrawCommand> &commands)
+{
+    _frame++;
+    collect();
+
+    if (!_request || !_framebuffer)
+        return;
+
+    glm::ivec2 pixel = *_request;
+    _request.reset();
+    if (pixel.x < 0 || pixel.y < 0 || pixel.x >= _size.x || pixel.y >= _size.y)
+        return;
+
+    glm::ivec2 origin = glm::max(pixel - REGION_SIZE / 2, glm::ivec2(0));
+    glm::ivec2 size = glm::min(origin + REGION_SIZE, _size) - origin;
+
+    Readback *readback = nullptr;
+    if (!synchronous)
+    {
+        for (Readback &candidate : _readbacks)
+            if (!candidate.fence)
+                readback = &candidate;
+
+        // Clicks faster than the GPU returns them, the newest ones win next time
+        if (!readback)
+        {
+            _dropped++;
+            return;
+        }
+    }
+
+    _profiler.beginGpu("Pick pass");
+    draw(camera, commands, origin, size);
+    _profiler.endGpu();
+
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    if (synchronous)
+    {
+        // Waits for everything queued before it, the cost the asynchronous path avoids
+        _profiler.beginCpu("Pick readback");
+        auto start = std::chrono::steady_clock::now();
+        uint32_t ids[REGION_SIZE * REGION_SIZE];
+        glReadPixels(origin.x, origin.y, size.x, size.y, GL_RED_INTEGER, GL_UNSIGNED_INT, ids);
+        _syncStall = millisecondsSince(start);
+        _profiler.endCpu();
+
+        resolve(ids, {.pixel = pixel, .origin = origin, .size = size, .frame = _frame});
+    }
+    else
+    {
+        readback->pixel = pixel;
+        readback->origin = origin;
+        readback->size = size;
+        readback->frame = _frame;
+
+        // Only queues the copy, the fence tells when the buffer holds it
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+        glReadPixels(origin.x, origin.y, size.x, size.y, GL_RED_INTEGER, GL_UNSIGNED_INT, (void *)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ObjectPicker::draw(const Camera &camera, const std::vector<DrawCommand> &commands, const glm::ivec2 &origin, const glm::ivec2 &size)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _size.x, _size.y);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(origin.x, origin.y, size.x, size.y);
+
+    const GLuint noId[] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, noId);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+
+    _shader->use();
+    camera.setUniforms(*_shader);
+
+    // Every command, culled ones too, the scissor keeps the cost to the few pixels read
+    for (const DrawCommand &command : commands)
+    {
+        if (!command.pickId)
+            continue;
+
+        _shader->setUniform("model", command.model);
+        _shader->setUniform("pickId", command.pickId);
+        command.mesh->draw(*_shader);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void ObjectPicker::collect()
+{
+    // Oldest first, a result is only replaced by a newer one
+    Readback *order[READBACK_BUFFERS];
+    int count = 0;
+    for (Readback &readback : _readbacks)
+        if (readback.fence)
+            order[count++] = &readback;
+    std::sort(order, order + count, [](const Readback *a, const Readback *b)
+              { return a->frame < b->frame; });
+
+    for (int i = 0; i < count; i++)
+    {
+        Readback &readback = *order[i];
+        GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        if (status == GL_WAIT_FAILED)
+            std::cout << "ERROR::OBJECT_PICKER::WAIT_FAILED" << std::endl;
+
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        _profiler.beginCpu("Pick readback");
+        auto start = std::chrono::steady_clock::now();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        GLsizeiptr bytes = readback.size.x * readback.size.y * sizeof(uint32_t);
+        const uint32_t *ids = (const uint32_t *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (ids)
+        {
+            resolve(ids, readback);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        _asyncStall = millisecondsSince(start);
+        _profiler.endCpu();
+    }
+}
+
+void ObjectPicker::resolve(const uint32_t *ids, const Readback &readback)
+{
+    glm::ivec2 center = readback.pixel - readback.origin;
+    uint32_t id = 0;
+    int nearest = REGION_SIZE * REGION_SIZE;
+    for (int y = 0; y < readback.size.y; y++)
+        for (int x = 0; x < readback.size.x; x++)
+        {
+            uint32_t candidate = ids[y * readback.size.x + x];
+            int distance = (x - center.x) * (x - center.x) + (y - center.y) * (y - center.y);
+            if (candidate && distance < nearest)
+            {
+                id = candidate;
+                nearest = distance;
+            }
+        }
+
+    _lastLatency = _frame - readback.frame;
+
+    std::lock_guard<std::mutex> lock(_resultMutex);
+    _result = PickResult{id, readback.pixel, _lastLatency};
+}
+
+bool ObjectPicker::takeResult(PickResult &result)
+{
+    std::lock_guard<std::mutex> lock(_resultMutex);
+    if (!_result)
+        return false;
+
+    result = *_result;
+    _result.reset();
+    return true;
+}
+
+void ObjectPicker::resize(const glm::vec2 &size)
+{
+    _size = size;
+    destroyTargets();
+    createTargets();
+}
+
+void ObjectPicker::createTargets()
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    glGenFramebuffers(1, &_framebuffer);
+    glGenTextures(1, &_ids);
+    glGenRenderbuffers(1, &_depth);
+
+    glBindTexture(GL_TEXTURE_2D, _ids);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, _size.x, _size.y, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _size.x, _size.y);
+
+    ResourceTracker::track(RESOURCE_GL_TEXTURE, _ids, RESOURCE_RENDER_TARGET, "Object picker",
+                           ResourceTracker::getTextureBytes(GL_R32UI, _size.x, _size.y));
+    ResourceTracker::track(RESOURCE_GL_RENDERBUFFER, _depth, RESOURCE_RENDER_TARGET, "Object picker",
+                           ResourceTracker::getTextureBytes(GL_DEPTH_COMPONENT24, _size.x, _size.y));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _ids, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::OBJECT_PICKER::TARGET_INCOMPLETE" << std::endl;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ObjectPicker::destroyTargets()
+{
+    if (!_framebuffer)
+        return;
+
+    ResourceTracker::release(RESOURCE_GL_RENDERBUFFER, _depth);
+    ResourceTracker::release(RESOURCE_GL_TEXTURE, _ids);
+    glDeleteRenderbuffers(1, &_depth);
+    glDeleteTextures(1, &_ids);
+    glDeleteFramebuffers(1, &_framebuffer);
+
+    _framebuffer = _ids = _depth = 0;
+}
+
+void ObjectPicker::imguiDraw()
+{
+    if (ImGui::TreeNode("Picking"))
+    {
+        ImGui::Checkbox("Synchronous readback", &synchronous);
+        ImGui::Text("Stall: %.3f ms synchronous, %.3f ms asynchronous", _syncStall, _asyncStall);
+        ImGui::Text("Last result: %d frames late", _lastLatency);
+        ImGui::Text("Dropped requests: %d", _dropped);
+        ImGui::TreePop();
+    }
+}
@@ -0,0 +1,225 @@
+#include <engine/profiler.h>
+
+#include <cstring>
+#include "imgui.h"
+
+GpuQuery::GpuQuery(GLenum target) : _target(target)
+{
+    glGenQueries(LATENCY, _queries);
+}
+
+GpuQuery::~GpuQuery()
+{
+    glDeleteQueries(LATENCY, _queries);
+}
+
+void GpuQuery::begin()
+{
+    collect();
+
+    // Every query in the ring is still in flight, skip this frame instead of waiting
+    if (_pending[_current])
+    {
+        _active = false;
+        return;
+    }
+
+    glBeginQuery(_target, _queries[_current]);
+    _active = true;
+}
+
+void GpuQuery::end()
+{
+    if (!_active)
+        return;
+
+    glEndQuery(_target);
+    _pending[_current] = true;
+    _current = (_current + 1) % LATENCY;
+    _active = false;
+}
+
+GLuint64 GpuQuery::getResult() const { return _result; }
+
+void GpuQuery::collect()
+{
+    // Oldest query first so the latest result wins
+    for (int i = 0; i < LATENCY; i++)
+    {
+        int index = (_current + i) % LATENCY;
+        if (!_pending[index])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(_queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        glGetQueryObjectui64v(_queries[index], GL_QUERY_RESULT, &_result);
+        _pending[index] = false;
+    }
+}
+
+GpuTimer::GpuTimer() : GpuQuery(GL_TIME_ELAPSED) {}
+
+float GpuTimer::getMilliseconds() const
+{
+    return (float)getResult() / 1000000.0f;
+}
+
+template <typename T>
+int Profiler::find(const std::vector<T> &items, const char *name)
+{
+    for (int i = 0; i < items.size(); i++)
+        if (items[i].name == name)
+            return i;
+
+    for (int i = 0; i < items.size(); i++)
+        if (std::strcmp(items[i].name, name) == 0)
+            return i;
+
+    return -1;
+}
+
+void Profiler::beginFrame()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (Counter &counter : _counters)
+        counter.value = 0.0;
+
+    AllocationTracker::endFrame();
+    AllocationTracker::getFrameStats(_allocations);
+}
+
+void Profiler::beginGpu(const char *name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_gpuScopes, name);
+    if (index < 0)
+    {
+        index = _gpuScopes.size();
+        _gpuScopes.push_back({name, std::make_unique<GpuTimer>()});
+    }
+
+    // Timer queries cannot nest, close the previous one
+    if (_activeGpu)
+        _activeGpu->end();
+
+    _activeGpu = _gpuScopes[index].timer.get();
+    _activeGpu->begin();
+}
+
+void Profiler::endGpu()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_activeGpu)
+        return;
+
+    _activeGpu->end();
+    _activeGpu = nullptr;
+}
+
+void Profiler::beginCpu(const char *name)
+{
+    AllocationTracker::beginScope(name);
+    Clock::time_point start = Clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    int index = find(_cpuScopes, name);
+    if (index < 0)
+    {
+        index = _cpuScopes.size();
+        _cpuScopes.push_back({name});
+    }
+
+    _cpuStacks[std::this_thread::get_id()].push_back({index, start});
+}
+
+void Profiler::endCpu()
+{
+    Clock::time_point end = Clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<OpenCpuScope> &stack = _cpuStacks[std::this_thread::get_id()];
+    if (stack.empty())
+        return;
+
+    OpenCpuScope scope = stack.back();
+    stack.pop_back();
+
+    _cpuScopes[scope.index].milliseconds = std::chrono::duration<float, std::milli>(end - scope.start).count();
+    AllocationTracker::endScope();
+}
+
+void Profiler::setCounter(const char *name, double value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_counters, name);
+    if (index < 0)
+    {
+        _counters.push_back({name, value});
+        return;
+    }
+
+    _counters[index].value = value;
+}
+
+void Profiler::addCounter(const char *name, double value)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_counters, name);
+    if (index < 0)
+    {
+        _counters.push_back({name, value});
+        return;
+    }
+
+    _counters[index].value += value;
+}
+
+float Profiler::getGpuMilliseconds(const char *name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_gpuScopes, name);
+    return index < 0 ? 0.0f : _gpuScopes[index].timer->getMilliseconds();
+}
+
+float Profiler::getCpuMilliseconds(const char *name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_cpuScopes, name);
+    return index < 0 ? 0.0f : _cpuScopes[index].milliseconds;
+}
+
+double Profiler::getCounter(const char *name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int index = find(_counters, name);
+    return index < 0 ? 0.0 : _counters[index].value;
+}
+
+void Profiler::imguiDraw() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_NoSavedSettings))
+    {
+        ImGui::SeparatorText("CPU");
+        for (const CpuScope &scope : _cpuScopes)
+            ImGui::Text("%s: %.3f ms", scope.name, scope.milliseconds);
+
+        ImGui::SeparatorText("GPU");
+        for (const GpuScope &scope : _gpuScopes)
+            ImGui::Text("%s: %.3f ms", scope.name, scope.timer->getMilliseconds());
+
+        ImGui::SeparatorText("Counters");
+        for (const Counter &counter : _counters)
+            ImGui::Text("%s: %.0f", counter.name, counter.value);
+
+        ImGui::SeparatorText("Allocations");
+        if (!AllocationTracker::isEnabled())
+            ImGui::TextDisabled("Built without ENGINE_TRACK_ALLOCATIONS");
+        for (const AllocationTracker::Stats &stats : _allocations)
+            ImGui::Text("%s: %llu (%.1f KB)", stats.name, (unsigned long long)stats.count, stats.bytes / 1024.0);
+    }
+    ImGui::End();
+}
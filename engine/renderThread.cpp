@@ -0,0 +1,79 @@
+#include <engine/renderThread.h>
+
+#include <algorithm>
+
+RenderThread::RenderThread(GLFWwindow *window, int latency, std::function<void(FramePacket &)> render)
+    : _window(window), _render(std::move(render))
+{
+    // One being rendered plus the ones the main thread may run ahead
+    for (int i = 0; i < std::max(latency, 1) + 1; i++)
+        _packets.push_back(std::make_unique<FramePacket>());
+
+    _thread = std::thread(&RenderThread::loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+
+    glfwMakeContextCurrent(_window);
+}
+
+FramePacket &RenderThread::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait(lock, [this]
+                  { return _submitted - _rendered < _packets.size(); });
+
+    return *_packets[_submitted % _packets.size()];
+}
+
+void RenderThread::submit()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _submitted++;
+    }
+    _changed.notify_all();
+}
+
+void RenderThread::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait(lock, [this]
+                  { return _rendered == _submitted; });
+}
+
+void RenderThread::loop()
+{
+    glfwMakeContextCurrent(_window);
+
+    while (true)
+    {
+        FramePacket *packet;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _changed.wait(lock, [this]
+                          { return _quit || _rendered < _submitted; });
+            if (_rendered == _submitted)
+                break;
+
+            packet = _packets[_rendered % _packets.size()].get();
+        }
+
+        _render(*packet);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _rendered++;
+        }
+        _changed.notify_all();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
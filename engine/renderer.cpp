@@ -0,0 +1,1509 @@
+#include <engine/renderer.h>
+#include <engine/camera.h>
+#include <engine/light.h>
+#include <engine/profiler.h>
+#include <engine/resourceTracker.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "imgui.h"
+
+static constexpr int VOLUME_SEGMENTS = 16;
+static constexpr int VOLUME_STACKS = 8;
+
+// Visible objects are only tested again every few frames, hidden ones every frame
+static constexpr unsigned int OCCLUSION_RECHECK_INTERVAL = 4;
+// Objects that were not submitted for this many frames lose their queries
+static constexpr unsigned int OCCLUSION_FORGET_FRAMES = 60;
+
+// Per frame data streamed to the GPU, room for about ten thousand light volumes
+static constexpr GLsizeiptr STREAM_REGION_SIZE = 1 << 20;
+
+static LightInstance lightInstance(const PointLight &light, float radius)
+{
+    return {
+        .position = glm::vec4(light.transform.position, radius),
+        .direction = glm::vec4(light.transform.forward(), 1.0f),
+        .ambient = glm::vec4(light.ambient, -1.0f),
+        .diffuse = glm::vec4(light.diffuse, 0.0f),
+        .specular = glm::vec4(light.specular, 0.0f),
+        .attenuation = glm::vec4(light.constant, light.linear, light.quadratic, (float)light.shadowTile),
+    };
+}
+
+Renderer::Renderer(RenderPath path, const MaterialRegistry &materials, Profiler &profiler, JobSystem &jobs, const glm::vec2 &size)
+    : path(path), _materials(materials), _profiler(profiler), _size(size), _outputSize(size)
+{
+    _resolution = std::make_unique<ResolutionController>();
+    _softwareOcclusion = std::make_unique<SoftwareOcclusion>(profiler, jobs);
+    _gpuCulling = std::make_unique<GpuCulling>(materials, profiler, _frameArena, size);
+    _shadows = std::make_unique<ShadowAtlas>(materials, profiler);
+    _picker = std::make_unique<ObjectPicker>(profiler, size);
+    _stream = std::make_unique<StreamBuffer>(profiler, STREAM_REGION_SIZE);
+    _depthShader = std::make_unique<Shader>("./shaders/depth.vs", "./shaders/depth.fs");
+    _shadedSamples = std::make_unique<GpuQuery>(GL_SAMPLES_PASSED);
+
+    _outlineSeedShader = std::make_unique<Shader>("./shaders/depth.vs", "./shaders/outlineSeed.fs");
+    _jumpFloodShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/jumpFlood.fs");
+    _outlineShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/outline.fs");
+    _oitCompositeShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/oitComposite.fs");
+    _upscaleShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/upscale.fs");
+    _fxaaShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/fxaa.fs");
+
+    for (const Shader *shader : {_jumpFloodShader.get(), _outlineShader.get()})
+    {
+        shader->use();
+        shader->setUniform("seeds", (int)TextureUnit::OUTLINE_SEED_UNIT);
+    }
+
+    _oitCompositeShader->use();
+    _oitCompositeShader->setUniform("accumulation", (int)TextureUnit::OIT_ACCUMULATION_UNIT);
+    _oitCompositeShader->setUniform("weights", (int)TextureUnit::OIT_WEIGHT_UNIT);
+    for (const Shader *shader : {_upscaleShader.get(), _fxaaShader.get()})
+    {
+        shader->use();
+        shader->setUniform("scene", (int)TextureUnit::SCENE_COLOR_UNIT);
+    }
+    glUseProgram(0);
+
+    glGetIntegerv(GL_MAX_SAMPLES, &_maxSamples);
+
+    // Core profile needs a VAO bound even when the vertices come from gl_VertexID
+    glGenVertexArrays(1, &_emptyVao);
+
+    // Unit cube around the origin drawn for occlusion queries
+    {
+        const glm::vec3 positions[] = {
+            glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, -1.0f, -1.0f),
+            glm::vec3(-1.0f, 1.0f, -1.0f), glm::vec3(1.0f, 1.0f, -1.0f),
+            glm::vec3(-1.0f, -1.0f, 1.0f), glm::vec3(1.0f, -1.0f, 1.0f),
+            glm::vec3(-1.0f, 1.0f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f)};
+        // Culling is off for the proxies, the winding does not matter
+        const unsigned int indices[] = {
+            0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6,
+            0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6,
+            0, 2, 6, 0, 6, 4, 1, 3, 7, 1, 7, 5};
+
+        glGenVertexArrays(1, &_proxyVao);
+        glGenBuffers(1, &_proxyVbo);
+        glGenBuffers(1, &_proxyEbo);
+
+        glBindVertexArray(_proxyVao);
+        glBindBuffer(GL_ARRAY_BUFFER, _proxyVbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _proxyEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        ResourceTracker::track(RESOURCE_GL_BUFFER, _proxyVbo, RESOURCE_GEOMETRY, "Occlusion proxy", sizeof(positions));
+        ResourceTracker::track(RESOURCE_GL_BUFFER, _proxyEbo, RESOURCE_GEOMETRY, "Occlusion proxy", sizeof(indices));
+    }
+
+    createOutlineTargets();
+
+    if (path != RenderPath::DEFERRED)
+        return;
+
+    _gBufferShader = std::make_unique<Shader>("./shaders/vertex.vs", "./shaders/gbuffer.fs");
+    _directionalShader = std::make_unique<Shader>("./shaders/fullscreen.vs", "./shaders/deferredDirectional.fs");
+    _lightVolumeShader = std::make_unique<Shader>("./shaders/lightVolume.vs", "./shaders/deferredLight.fs");
+
+    for (const Shader *shader : {_directionalShader.get(), _lightVolumeShader.get()})
+    {
+        shader->use();
+        shader->setUniform("gAlbedo", (int)TextureUnit::GBUFFER_ALBEDO_UNIT);
+        shader->setUniform("gSpecular", (int)TextureUnit::GBUFFER_SPECULAR_UNIT);
+        shader->setUniform("gNormal", (int)TextureUnit::GBUFFER_NORMAL_UNIT);
+        shader->setUniform("gEmission", (int)TextureUnit::GBUFFER_EMISSION_UNIT);
+        shader->setUniform("gDepth", (int)TextureUnit::GBUFFER_DEPTH_UNIT);
+    }
+    glUseProgram(0);
+
+    // Unit sphere, pushed out a little so the faceted mesh contains the real sphere
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        const float scale = 1.0f / std::cos(glm::pi<float>() / VOLUME_SEGMENTS);
+
+        for (int i = 0; i <= VOLUME_STACKS; i++)
+        {
+            float phi = glm::pi<float>() * i / VOLUME_STACKS;
+            for (int j = 0; j <= VOLUME_SEGMENTS; j++)
+            {
+                float theta = 2.0f * glm::pi<float>() * j / VOLUME_SEGMENTS;
+                positions.push_back(glm::vec3(
+                                        std::sin(phi) * std::cos(theta),
+                                        std::cos(phi),
+                                        std::sin(phi) * std::sin(theta)) *
+                                    scale);
+            }
+        }
+
+        for (int i = 0; i < VOLUME_STACKS; i++)
+        {
+            for (int j = 0; j < VOLUME_SEGMENTS; j++)
+            {
+                unsigned int k1 = i * (VOLUME_SEGMENTS + 1) + j;
+                unsigned int k2 = k1 + VOLUME_SEGMENTS + 1;
+
+                indices.insert(indices.end(), {k1, k1 + 1, k2});
+                indices.insert(indices.end(), {k1 + 1, k2 + 1, k2});
+            }
+        }
+
+        createLightVolume(_sphere, positions, indices);
+    }
+
+    // Unit cone, apex at the origin and base of radius 1 at z = 1
+    {
+        std::vector<glm::vec3> positions = {glm::vec3(0.0f)};
+        std::vector<unsigned int> indices;
+        const float scale = 1.0f / std::cos(glm::pi<float>() / VOLUME_SEGMENTS);
+
+        for (int j = 0; j < VOLUME_SEGMENTS; j++)
+        {
+            float theta = 2.0f * glm::pi<float>() * j / VOLUME_SEGMENTS;
+            positions.push_back(glm::vec3(std::cos(theta) * scale, std::sin(theta) * scale, 1.0f));
+        }
+        positions.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+
+        unsigned int center = VOLUME_SEGMENTS + 1;
+        for (unsigned int j = 0; j < VOLUME_SEGMENTS; j++)
+        {
+            unsigned int current = j + 1;
+            unsigned int next = (j + 1) % VOLUME_SEGMENTS + 1;
+
+            indices.insert(indices.end(), {0, next, current});
+            indices.insert(indices.end(), {center, current, next});
+        }
+
+        createLightVolume(_cone, positions, indices);
+    }
+
+    createGBuffer();
+}
+
+Renderer::~Renderer()
+{
+    destroyOutlineTargets();
+    destroyOitTargets();
+    destroySceneTarget();
+    glDeleteVertexArrays(1, &_emptyVao);
+
+    for (auto &[owner, group] : _occlusionGroups)
+        glDeleteQueries(2, group.queries);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _proxyEbo);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _proxyVbo);
+    glDeleteBuffers(1, &_proxyEbo);
+    glDeleteBuffers(1, &_proxyVbo);
+    glDeleteVertexArrays(1, &_proxyVao);
+
+    if (path != RenderPath::DEFERRED)
+        return;
+
+    destroyGBuffer();
+    destroyLightVolume(_sphere);
+    destroyLightVolume(_cone);
+}
+
+void Renderer::submit(const DrawCommand &command)
+{
+    _submitted.push_back(command);
+    if (!command.pickId)
+        _submitted.back().pickId = _pickId;
+}
+
+void Renderer::setPickId(uint32_t id)
+{
+    _pickId = id;
+}
+
+void Renderer::requestPick(const glm::ivec2 &pixel)
+{
+    _pickRequest = pixel;
+}
+
+ObjectPicker &Renderer::getPicker() const { return *_picker; }
+
+ResolutionController &Renderer::getResolution() const { return *_resolution; }
+
+void Renderer::extract(std::vector<DrawCommand> &commands)
+{
+    commands.clear();
+    commands.swap(_submitted);
+}
+
+void Renderer::resize(const glm::vec2 &size)
+{
+    _outputSize = size;
+    resizeTargets(_resolution->getRenderSize(_outputSize));
+}
+
+void Renderer::resizeTargets(const glm::ivec2 &size)
+{
+    _size = size;
+
+    // Created again by render() when still needed
+    destroySceneTarget();
+    _gpuCulling->resize(size);
+    _picker->resize(size);
+    destroyOutlineTargets();
+    createOutlineTargets();
+    // Created again on first use
+    destroyOitTargets();
+
+    if (path != RenderPath::DEFERRED)
+        return;
+
+    destroyGBuffer();
+    createGBuffer();
+}
+
+void Renderer::render(const Camera &camera, const std::vector<Light *> &lights, std::vector<DrawCommand> &commands)
+{
+    _frameArena.reset();
+    _commands.swap(commands);
+    _profiler.setCounter("Draw commands", _commands.size());
+    _stream->beginFrame();
+    // ImGui, the capture and other GL users are free to bind anywhere between frames
+    Texture::resetBindings();
+
+    // Targets only follow the scale in steps, see ResolutionController
+    glm::ivec2 renderSize = _resolution->getRenderSize(_outputSize);
+    if (renderSize != _size)
+        resizeTargets(renderSize);
+    bool offscreen = _resolution->enabled || antiAliasing != AntiAliasingMode::AA_OFF;
+    if (_sceneFramebuffer && (!offscreen || getSceneSamples() != _sceneSamples))
+        destroySceneTarget();
+    if (offscreen && !_sceneFramebuffer)
+        createSceneTarget();
+
+    if (_pickRequest && _outputSize.x > 0 && _outputSize.y > 0)
+        _picker->request(glm::ivec2(glm::vec2(*_pickRequest) * glm::vec2(_size) / glm::vec2(_outputSize)));
+    _pickRequest.reset();
+
+    _resolution->beginFrame();
+
+    cullSoftwareOcclusion(camera);
+    sortCommands(camera);
+    updateOcclusion(camera);
+
+    // Culled commands still cast shadows
+    _shadows->render(camera, lights, _commands);
+    _shadows->bind();
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+    glViewport(0, 0, _size.x, _size.y);
+    if (_sceneFramebuffer)
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    if (path == RenderPath::DEFERRED)
+        renderDeferred(camera, lights);
+    else
+        renderForward(camera, lights);
+
+    drawOutlines(camera);
+    _picker->render(camera, _commands);
+    if (_sceneFramebuffer)
+        presentScene();
+    glViewport(0, 0, _outputSize.x, _outputSize.y);
+    _resolution->endFrame();
+    measureAntiAliasing();
+
+    _stream->endFrame();
+    _commands.swap(commands);
+    commands.clear();
+}
+
+void Renderer::cullSoftwareOcclusion(const Camera &camera)
+{
+    _culled.assign(_commands.size(), false);
+    if (!softwareOcclusion)
+        return;
+
+    for (const DrawCommand &command : _commands)
+        if (command.isOccluder)
+            _softwareOcclusion->addOccluder(*command.mesh, command.model);
+
+    _softwareOcclusion->rasterize(camera.getProjectionMatrix() * camera.getViewMatrix());
+
+    _profiler.beginCpu("Software test");
+    int tested = 0;
+    int culled = 0;
+    for (int i = 0; i < _commands.size(); i++)
+    {
+        const DrawCommand &command = _commands[i];
+        if (command.isOccluder)
+            continue;
+
+        tested++;
+        if (!_softwareOcclusion->isVisible(command.mesh->getBounds().transformed(command.model)))
+        {
+            _culled[i] = true;
+            culled++;
+        }
+    }
+    _profiler.endCpu();
+
+    _profiler.setCounter("Software tested", tested);
+    _profiler.setCounter("Software culled", culled);
+}
+
+void Renderer::sortCommands(const Camera &camera)
+{
+    glm::mat4 view = camera.getViewMatrix();
+
+    _opaque.clear();
+    _transparent.clear();
+    _viewDepths.clear();
+    for (int i = 0; i < _commands.size(); i++)
+    {
+        const DrawCommand &command = _commands[i];
+        _viewDepths.push_back(-(view * command.model[3]).z);
+        if (_culled[i])
+            continue;
+
+        if (_materials.isTransparent(command.material))
+            _transparent.push_back(&command);
+        else
+            _opaque.push_back(&command);
+    }
+
+    auto viewDepth = [this](const DrawCommand *command)
+    { return _viewDepths[command - _commands.data()]; };
+
+    // Front to back so early depth testing rejects as much as possible
+    std::sort(_opaque.begin(), _opaque.end(),
+              [&](const DrawCommand *a, const DrawCommand *b)
+              { return viewDepth(a) < viewDepth(b); });
+
+    if (transparencyMode != TransparencyMode::SORTED)
+        return;
+
+    // Objects submit in the same order every frame, start from last frame's order unless the set changed
+    if (_transparentOrder.size() != _transparent.size())
+    {
+        _transparentOrder.resize(_transparent.size());
+        for (int i = 0; i < _transparentOrder.size(); i++)
+            _transparentOrder[i] = i;
+    }
+
+    // Insertion sort, linear when the order is already close
+    for (int i = 1; i < _transparentOrder.size(); i++)
+    {
+        int index = _transparentOrder[i];
+        float depth = viewDepth(_transparent[index]);
+
+        int j = i;
+        for (; j > 0 && viewDepth(_transparent[_transparentOrder[j - 1]]) < depth; j--)
+            _transparentOrder[j] = _transparentOrder[j - 1];
+        _transparentOrder[j] = index;
+    }
+}
+
+void Renderer::updateOcclusion(const Camera &camera)
+{
+    _frame++;
+    _frameGroups.clear();
+    _hidden.assign(_commands.size(), false);
+
+    // GPU culling tests against its own depth pyramid
+    if (!occlusionCulling || gpuCulling)
+        return;
+
+    int previous = (_frame + 1) % 2;
+    for (const DrawCommand *command : _opaque)
+    {
+        if (!command->owner)
+            continue;
+
+        OcclusionGroup &group = _occlusionGroups[command->owner];
+        AABB bounds = command->mesh->getBounds().transformed(command->model);
+
+        if (group.lastFrame != _frame)
+        {
+            if (!group.queries[0])
+                glGenQueries(2, group.queries);
+
+            // Last frame's test, kept as is when the GPU has not got there yet
+            if (group.pending[previous])
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(group.queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint passed = 0;
+                    glGetQueryObjectuiv(group.queries[previous], GL_QUERY_RESULT, &passed);
+                    group.visible = passed != 0;
+                    group.pending[previous] = false;
+                }
+            }
+
+            group.lastFrame = _frame;
+            group.bounds = bounds;
+            group.commands.clear();
+            _frameGroups.push_back(&group);
+        }
+        else
+        {
+            group.bounds.min = glm::min(group.bounds.min, bounds.min);
+            group.bounds.max = glm::max(group.bounds.max, bounds.max);
+        }
+
+        group.commands.push_back(command);
+    }
+
+    // The near plane would cut the proxy open, groups around the camera are drawn without a test. Known once every
+    // command has been merged into its group's bounds, before the opaque pass reads _hidden
+    glm::vec3 position = camera.transform.position;
+    for (OcclusionGroup *group : _frameGroups)
+    {
+        group->cameraInside = glm::all(glm::greaterThan(position, group->bounds.min - 0.5f)) &&
+                              glm::all(glm::lessThan(position, group->bounds.max + 0.5f));
+        if (group->cameraInside)
+            group->visible = true;
+
+        for (const DrawCommand *command : group->commands)
+            _hidden[command - _commands.data()] = !group->visible;
+    }
+
+    for (auto it = _occlusionGroups.begin(); it != _occlusionGroups.end();)
+    {
+        if (_frame - it->second.lastFrame > OCCLUSION_FORGET_FRAMES)
+        {
+            glDeleteQueries(2, it->second.queries);
+            it = _occlusionGroups.erase(it);
+        }
+        else
+            it++;
+    }
+}
+
+bool Renderer::isHidden(const DrawCommand *command) const
+{
+    return _hidden[command - _commands.data()];
+}
+
+template <typename DrawFunction>
+void Renderer::drawOpaque(const Camera &camera, DrawFunction draw)
+{
+    _shadedSamples->begin();
+    for (const DrawCommand *command : _opaque)
+        if (!isHidden(command))
+            draw(*command, false);
+    _shadedSamples->end();
+    _profiler.setCounter("Shaded fragments", _shadedSamples->getResult());
+
+    if (_frameGroups.empty())
+        return;
+
+    testOcclusion(camera);
+
+    // These were left out of the depth pre-pass
+    GLint depthFunc;
+    GLboolean depthMask;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    // The proxy was just drawn, NO_WAIT draws anyway instead of stalling when its result is late
+    GLuint slot = _frame % 2;
+    for (OcclusionGroup *group : _frameGroups)
+    {
+        if (group->visible)
+            continue;
+
+        _profiler.addCounter("Occluded objects", 1);
+        _profiler.addCounter("Occluded draws", group->commands.size());
+
+        // Groups around the camera are visible, every one left was tested just now
+        glBeginConditionalRender(group->queries[slot], GL_QUERY_NO_WAIT);
+        for (const DrawCommand *command : group->commands)
+            draw(*command, true);
+        glEndConditionalRender();
+    }
+
+    glDepthFunc(depthFunc);
+    glDepthMask(depthMask);
+}
+
+template <typename BatchFunction>
+void Renderer::drawBatches(const Camera &camera, BatchFunction draw)
+{
+    _gpuCulling->cull(_opaque, camera);
+
+    _shadedSamples->begin();
+    for (const GpuCulling::Batch &batch : _gpuCulling->getBatches())
+        draw(batch);
+    _shadedSamples->end();
+    _profiler.setCounter("Shaded fragments", _shadedSamples->getResult());
+}
+
+void Renderer::testOcclusion(const Camera &camera)
+{
+    GLint depthFunc;
+    GLboolean depthMask;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glDisable(GL_CULL_FACE);
+
+    _depthShader->use();
+    camera.setUniforms(*_depthShader);
+    glBindVertexArray(_proxyVao);
+
+    int slot = _frame % 2;
+    for (int i = 0; i < _frameGroups.size(); i++)
+    {
+        OcclusionGroup &group = *_frameGroups[i];
+        if (group.cameraInside || (group.visible && (_frame + i) % OCCLUSION_RECHECK_INTERVAL != 0))
+            continue;
+
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), group.bounds.getCenter()), group.bounds.getExtents());
+        _depthShader->setUniform("model", model);
+
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, group.queries[slot]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+        group.pending[slot] = true;
+        _profiler.addCounter("Occlusion queries", 1);
+    }
+
+    glBindVertexArray(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(depthMask);
+    glDepthFunc(depthFunc);
+    glEnable(GL_CULL_FACE);
+}
+
+void Renderer::renderForward(const Camera &camera, const std::vector<Light *> &lights)
+{
+    if (depthPrePass)
+        drawDepthPrePass(camera);
+
+    _profiler.beginGpu("Forward");
+    glDisable(GL_BLEND);
+
+    _preparedShaders.clear();
+    if (gpuCulling)
+        drawBatches(camera, [&](const GpuCulling::Batch &batch)
+                    {
+            const Shader &shader = getMainPassShader(*batch.shader).getVariant("GPU_CULLED");
+            prepareShader(shader, camera, lights);
+            _materials.bindMaps(batch.material);
+            _gpuCulling->bind(shader, batch);
+            batch.mesh->draw(shader, batch.count); });
+    else
+        drawOpaque(camera, [&](const DrawCommand &command, bool hidden)
+                   { drawForward(command, hidden ? *command.shader : getMainPassShader(*command.shader), camera, lights); });
+
+    if (depthPrePass)
+        endDepthPrePass();
+
+    _profiler.endGpu();
+
+    if (gpuCulling)
+        _gpuCulling->buildDepthPyramid(_sceneFramebuffer);
+
+    drawTransparent(camera, lights);
+}
+
+void Renderer::renderDeferred(const Camera &camera, const std::vector<Light *> &lights)
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (depthPrePass)
+        drawDepthPrePass(camera);
+
+    // Geometry
+    _profiler.beginGpu("G-buffer");
+    glDisable(GL_BLEND);
+
+    // Objects hidden last frame skipped the pre-pass and still need the alpha test
+    const Shader &gBufferShader = getMainPassShader(*_gBufferShader);
+    for (const Shader *shader : {&gBufferShader, (const Shader *)_gBufferShader.get()})
+    {
+        shader->use();
+        camera.setUniforms(*shader);
+    }
+
+    if (gpuCulling)
+    {
+        const Shader &batchShader = gBufferShader.getVariant("GPU_CULLED");
+        batchShader.use();
+        camera.setUniforms(batchShader);
+
+        drawBatches(camera, [&](const GpuCulling::Batch &batch)
+                    {
+            batchShader.use();
+            _materials.bindMaps(batch.material);
+            _gpuCulling->bind(batchShader, batch);
+            batch.mesh->draw(batchShader, batch.count); });
+    }
+    else
+        drawOpaque(camera, [&](const DrawCommand &command, bool hidden)
+                   {
+            const Shader &shader = hidden ? *_gBufferShader : gBufferShader;
+            shader.use();
+            shader.setUniform("model", command.model);
+            shader.setUniform("normalMatrix", glm::transpose(glm::inverse(command.model)));
+            _materials.use(command.material, shader);
+            command.mesh->draw(shader); });
+
+    if (depthPrePass)
+        endDepthPrePass();
+
+    // Light volumes and the forward passes test against the scene depth
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _gBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _sceneFramebuffer);
+    glBlitFramebuffer(0, 0, _size.x, _size.y, 0, 0, _size.x, _size.y,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+
+    _profiler.endGpu();
+
+    if (gpuCulling)
+        _gpuCulling->buildDepthPyramid(_sceneFramebuffer);
+
+    // Lighting
+    _profiler.beginGpu("Lighting");
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::GBUFFER_ALBEDO_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gAlbedo);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::GBUFFER_SPECULAR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gSpecular);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::GBUFFER_NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gNormal);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::GBUFFER_EMISSION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gEmission);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::GBUFFER_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _gDepth);
+    glActiveTexture(GL_TEXTURE0);
+
+    glm::mat4 viewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+    glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+    glm::vec2 screenSize = glm::vec2(_size);
+
+    _pointInstances.clear();
+    _spotInstances.clear();
+
+    // Directional lights and emission in one fullscreen pass, it also overwrites the clear color under geometry
+    glDisable(GL_DEPTH_TEST);
+
+    _directionalShader->use();
+    _directionalShader->setUniform("viewPos", camera.transform.position);
+    _directionalShader->setUniform("view", camera.getViewMatrix());
+    _directionalShader->setUniform("inverseViewProjection", inverseViewProjection);
+
+    Light::resetCounters();
+    for (Light *light : lights)
+    {
+        if (SpotLight *spotLight = dynamic_cast<SpotLight *>(light))
+        {
+            float radius = spotLight->getRange();
+            if (radius <= 0.0f)
+                continue;
+
+            LightInstance instance = lightInstance(*spotLight, radius);
+            float outerCutOff = glm::min(spotLight->outerCutOff, glm::radians(85.0f));
+            instance.direction.w = glm::cos(spotLight->cutOff);
+            instance.ambient.w = glm::cos(spotLight->outerCutOff);
+            instance.diffuse.w = glm::tan(outerCutOff);
+            _spotInstances.push_back(instance);
+        }
+        else if (PointLight *pointLight = dynamic_cast<PointLight *>(light))
+        {
+            float radius = pointLight->getRange();
+            if (radius > 0.0f)
+                _pointInstances.push_back(lightInstance(*pointLight, radius));
+        }
+        else
+            light->setUniforms(*_directionalShader);
+    }
+    _directionalShader->setUniform("directionalLightsCount", DirectionalLight::count);
+
+    glBindVertexArray(_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    // Point and spot lights only shade the pixels inside their volumes
+    // Back faces are drawn with an inverted depth test so surfaces in front of the far side of the volume pass
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_GEQUAL);
+    glDepthMask(GL_FALSE);
+    glCullFace(GL_FRONT);
+    glEnable(GL_DEPTH_CLAMP);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    _lightVolumeShader->use();
+    camera.setUniforms(*_lightVolumeShader);
+    _lightVolumeShader->setUniform("inverseViewProjection", inverseViewProjection);
+    _lightVolumeShader->setUniform("screenSize", screenSize);
+
+    drawLightVolumes(_sphere, _pointInstances, false);
+    drawLightVolumes(_cone, _spotInstances, true);
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glCullFace(GL_BACK);
+    glDisable(GL_DEPTH_CLAMP);
+    glDisable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    _profiler.setCounter("Point light volumes", _pointInstances.size());
+    _profiler.setCounter("Spot light volumes", _spotInstances.size());
+    _profiler.endGpu();
+
+    // Transparent objects cannot go through the G-buffer
+    drawTransparent(camera, lights);
+}
+
+void Renderer::drawTransparent(const Camera &camera, const std::vector<Light *> &lights)
+{
+    _profiler.setCounter("Transparent draws", _transparent.size());
+
+    if (_transparent.empty())
+        return;
+
+    if (transparencyMode == TransparencyMode::WEIGHTED_BLENDED)
+    {
+        drawWeightedBlended(camera, lights);
+        return;
+    }
+
+    _profiler.beginGpu("Transparent");
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    _preparedShaders.clear();
+    for (int index : _transparentOrder)
+        drawForward(*_transparent[index], *_transparent[index]->shader, camera, lights);
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+
+    _profiler.endGpu();
+}
+
+void Renderer::drawWeightedBlended(const Camera &camera, const std::vector<Light *> &lights)
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    if (!_oitFramebuffer)
+        createOitTargets();
+
+    _profiler.beginGpu("Transparent");
+
+    // Opaque surfaces still hide transparent ones
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _sceneFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _oitFramebuffer);
+    glBlitFramebuffer(0, 0, _size.x, _size.y, 0, 0, _size.x, _size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, _oitFramebuffer);
+
+    const GLfloat clearAccumulation[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const GLfloat clearWeights[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+    glClearBufferfv(GL_COLOR, 1, clearWeights);
+
+    // GL 3.3 has no per target blending, color and weight add up while the accumulation alpha
+    // (revealage) is multiplied by 1 - alpha
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    _preparedShaders.clear();
+    for (const DrawCommand *command : _transparent)
+        drawForward(*command, command->shader->getVariant("WEIGHTED_BLENDED"), camera, lights);
+
+    glDepthMask(GL_TRUE);
+
+    // Composite over the scene
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::OIT_ACCUMULATION_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _oitAccumulation);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::OIT_WEIGHT_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _oitWeights);
+    glActiveTexture(GL_TEXTURE0);
+
+    _oitCompositeShader->use();
+    glBindVertexArray(_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    _profiler.endGpu();
+}
+
+void Renderer::drawDepthPrePass(const Camera &camera)
+{
+    _profiler.beginGpu("Depth pre-pass");
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    const Shader &alphaTestShader = _depthShader->getVariant("ALPHA_TEST");
+    for (const Shader *shader : {(const Shader *)_depthShader.get(), &alphaTestShader})
+    {
+        shader->use();
+        camera.setUniforms(*shader);
+    }
+
+    // Only materials with holes pay for the discard, everything else keeps early depth testing
+    const Shader *current = nullptr;
+    for (const DrawCommand *command : _opaque)
+    {
+        if (isHidden(command))
+            continue;
+
+        bool alphaTest = _materials.needsAlphaTest(command->material);
+        const Shader *shader = alphaTest ? &alphaTestShader : _depthShader.get();
+        if (shader != current)
+        {
+            shader->use();
+            current = shader;
+        }
+
+        shader->setUniform("model", command->model);
+        if (alphaTest)
+            _materials.use(command->material, *shader);
+
+        command->mesh->draw(*shader);
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // The main pass only shades the surviving surface
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+
+    _profiler.endGpu();
+}
+
+void Renderer::endDepthPrePass()
+{
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+const Shader &Renderer::getMainPassShader(const Shader &shader) const
+{
+    // Alpha testing was already done by the pre-pass
+    return depthPrePass ? shader.getVariant("NO_ALPHA_TEST") : shader;
+}
+
+void Renderer::prepareShader(const Shader &shader, const Camera &camera, const std::vector<Light *> &lights)
+{
+    shader.use();
+
+    // Camera and lights do not change during the frame, set them once per program
+    for (const Shader *prepared : _preparedShaders)
+        if (prepared == &shader)
+            return;
+
+    camera.setUniforms(shader);
+
+    Light::resetCounters();
+    for (Light *light : lights)
+        light->setUniforms(shader);
+
+    _preparedShaders.push_back(&shader);
+}
+
+void Renderer::drawForward(const DrawCommand &command, const Shader &shader, const Camera &camera, const std::vector<Light *> &lights)
+{
+    prepareShader(shader, camera, lights);
+
+    shader.setUniform("model", command.model);
+    shader.setUniform("normalMatrix", glm::transpose(glm::inverse(command.model)));
+    _materials.use(command.material, shader);
+    command.mesh->draw(shader);
+}
+
+void Renderer::drawOutlines(const Camera &camera)
+{
+    if (!_outlineFramebuffers[0])
+        return;
+
+    bool anyOutlined = false;
+    for (const DrawCommand &command : _commands)
+        anyOutlined = anyOutlined || command.outlined;
+
+    if (!anyOutlined)
+        return;
+
+    _profiler.beginGpu("Outlines");
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    // Seeds, every outlined object in one pass
+    const GLint noSeed[] = {-1, -1, 0, 0};
+    glBindFramebuffer(GL_FRAMEBUFFER, _outlineFramebuffers[0]);
+    glClearBufferiv(GL_COLOR, 0, noSeed);
+
+    _outlineSeedShader->use();
+    camera.setUniforms(*_outlineSeedShader);
+
+    for (const DrawCommand &command : _commands)
+    {
+        if (!command.outlined)
+            continue;
+
+        _outlineSeedShader->setUniform("model", command.model);
+        command.mesh->draw(*_outlineSeedShader);
+    }
+
+    // Jump flood, steps k, k/2, ..., 1 reach seeds up to 2k - 1 pixels away
+    int width = glm::max((int)std::ceil(outlineWidth), 1);
+    int step = 1;
+    while (step * 2 <= width)
+        step *= 2;
+
+    glBindVertexArray(_emptyVao);
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::OUTLINE_SEED_UNIT);
+
+    _jumpFloodShader->use();
+
+    int source = 0;
+    for (; step >= 1; step /= 2)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, _outlineFramebuffers[1 - source]);
+        glBindTexture(GL_TEXTURE_2D, _outlineSeeds[source]);
+        _jumpFloodShader->setUniform("stepSize", step);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        source = 1 - source;
+    }
+
+    // Composite
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+    glBindTexture(GL_TEXTURE_2D, _outlineSeeds[source]);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_BLEND);
+
+    _outlineShader->use();
+    _outlineShader->setUniform("color", outlineColor);
+    _outlineShader->setUniform("width", outlineWidth);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    _profiler.endGpu();
+}
+
+void Renderer::drawLightVolumes(const LightVolume &volume, const std::vector<LightInstance> &instances, bool isSpot)
+{
+    if (instances.empty())
+        return;
+
+    GLsizeiptr size = instances.size() * sizeof(LightInstance);
+    GLuint buffer = _stream->getBuffer();
+    GLintptr offset = _stream->write(instances.data(), size);
+    if (offset < 0)
+    {
+        // More than a stream region holds, respecify the volume's own buffer instead
+        buffer = volume.instances;
+        offset = 0;
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_STREAM_DRAW);
+        ResourceTracker::track(RESOURCE_GL_BUFFER, buffer, RESOURCE_BUFFER, "Light volumes", size);
+    }
+
+    _lightVolumeShader->setUniform("isSpot", isSpot);
+
+    glBindVertexArray(volume.vao);
+    setLightInstanceAttributes(buffer, offset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawElementsInstanced(GL_TRIANGLES, volume.indicesCount, GL_UNSIGNED_INT, 0, instances.size());
+    glBindVertexArray(0);
+}
+
+void Renderer::presentScene()
+{
+    bool scaled = _size != _outputSize;
+    GLuint source = _sceneColor;
+
+    if (_sceneSamples > 0)
+    {
+        // A resolve blit needs the same format on both sides, the default framebuffer's is whatever the driver
+        // chose, so the resolve goes to a target of our own and is copied to the window like an upscale
+        _profiler.beginGpu("MSAA resolve");
+        if (!_resolveFramebuffer)
+            createResolveTarget();
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, _sceneFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _resolveFramebuffer);
+        glBlitFramebuffer(0, 0, _size.x, _size.y, 0, 0, _size.x, _size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        _profiler.endGpu();
+
+        source = _resolveColor;
+    }
+    else if (antiAliasing == AntiAliasingMode::AA_FXAA)
+    {
+        // At the render size, before the upscale spreads the edges over more pixels
+        _profiler.beginGpu("FXAA");
+        if (scaled && !_resolveFramebuffer)
+            createResolveTarget();
+        glBindFramebuffer(GL_FRAMEBUFFER, scaled ? _resolveFramebuffer : 0);
+        glViewport(0, 0, _size.x, _size.y);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+
+        glActiveTexture(GL_TEXTURE0 + TextureUnit::SCENE_COLOR_UNIT);
+        glBindTexture(GL_TEXTURE_2D, _sceneColor);
+        glActiveTexture(GL_TEXTURE0);
+
+        _fxaaShader->use();
+        glBindVertexArray(_emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+
+        glEnable(GL_DEPTH_TEST);
+        _profiler.endGpu();
+
+        if (!scaled)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return;
+        }
+        source = _resolveColor;
+    }
+
+    upscale(source);
+}
+
+void Renderer::upscale(GLuint source)
+{
+    _profiler.beginGpu("Upscale");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, _outputSize.x, _outputSize.y);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::SCENE_COLOR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glActiveTexture(GL_TEXTURE0);
+
+    _upscaleShader->use();
+    // Nothing to sharpen when nothing was lost
+    _upscaleShader->setUniform("sharpness", _size.x < _outputSize.x ? upscaleSharpness : 0.0f);
+    glBindVertexArray(_emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    glEnable(GL_DEPTH_TEST);
+
+    _profiler.endGpu();
+}
+
+void Renderer::measureAntiAliasing()
+{
+    // The timings lag a few frames behind, the ones from before a switch are not counted
+    if (antiAliasing != _measuredAntiAliasing)
+    {
+        _measuredAntiAliasing = antiAliasing;
+        _antiAliasingFrames = 0;
+    }
+    if (++_antiAliasingFrames <= 8)
+        return;
+
+    float &average = _antiAliasingMilliseconds[antiAliasing];
+    float milliseconds = _resolution->getGpuMilliseconds();
+    average = average > 0.0f ? average * 0.95f + milliseconds * 0.05f : milliseconds;
+}
+
+int Renderer::getSceneSamples() const
+{
+    if (antiAliasing != AntiAliasingMode::AA_MSAA || path == RenderPath::DEFERRED)
+        return 0;
+    return glm::clamp(msaaSamples, 1, glm::max((int)_maxSamples, 1));
+}
+
+void Renderer::createSceneTarget()
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    _sceneSamples = getSceneSamples();
+    int samples = glm::max(_sceneSamples, 1);
+
+    glGenFramebuffers(1, &_sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _sceneFramebuffer);
+
+    if (_sceneSamples > 0)
+    {
+        // Only ever blitted from, no need for a multisampled texture
+        glGenRenderbuffers(1, &_sceneColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, _sceneColor);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, _sceneSamples, GL_RGBA8, _size.x, _size.y);
+        ResourceTracker::track(RESOURCE_GL_RENDERBUFFER, _sceneColor, RESOURCE_RENDER_TARGET, "Scene target",
+                               ResourceTracker::getTextureBytes(GL_RGBA8, _size.x, _size.y) * samples);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _sceneColor);
+    }
+    else
+    {
+        // Filtered by the upscale
+        glGenTextures(1, &_sceneColor);
+        glBindTexture(GL_TEXTURE_2D, _sceneColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _size.x, _size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, _sceneColor, RESOURCE_RENDER_TARGET, "Scene target",
+                               ResourceTracker::getTextureBytes(GL_RGBA8, _size.x, _size.y));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _sceneColor, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Same format as the other depth targets, depth is blitted between them
+    glGenRenderbuffers(1, &_sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, _sceneDepth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, _sceneSamples, GL_DEPTH24_STENCIL8, _size.x, _size.y);
+    ResourceTracker::track(RESOURCE_GL_RENDERBUFFER, _sceneDepth, RESOURCE_RENDER_TARGET, "Scene target",
+                           ResourceTracker::getTextureBytes(GL_DEPTH24_STENCIL8, _size.x, _size.y) * samples);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, _sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDERER::SCENE_TARGET_INCOMPLETE" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::destroySceneTarget()
+{
+    if (_resolveFramebuffer)
+    {
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, _resolveColor);
+        glDeleteTextures(1, &_resolveColor);
+        glDeleteFramebuffers(1, &_resolveFramebuffer);
+        _resolveFramebuffer = _resolveColor = 0;
+    }
+
+    if (!_sceneFramebuffer)
+        return;
+
+    if (_sceneSamples > 0)
+    {
+        ResourceTracker::release(RESOURCE_GL_RENDERBUFFER, _sceneColor);
+        glDeleteRenderbuffers(1, &_sceneColor);
+    }
+    else
+    {
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, _sceneColor);
+        glDeleteTextures(1, &_sceneColor);
+    }
+    ResourceTracker::release(RESOURCE_GL_RENDERBUFFER, _sceneDepth);
+    glDeleteRenderbuffers(1, &_sceneDepth);
+    glDeleteFramebuffers(1, &_sceneFramebuffer);
+
+    _sceneFramebuffer = _sceneColor = _sceneDepth = 0;
+    _sceneSamples = 0;
+}
+
+void Renderer::createResolveTarget()
+{
+    glGenFramebuffers(1, &_resolveFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _resolveFramebuffer);
+
+    glGenTextures(1, &_resolveColor);
+    glBindTexture(GL_TEXTURE_2D, _resolveColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _size.x, _size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    ResourceTracker::track(RESOURCE_GL_TEXTURE, _resolveColor, RESOURCE_RENDER_TARGET, "Scene target",
+                           ResourceTracker::getTextureBytes(GL_RGBA8, _size.x, _size.y));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _resolveColor, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDERER::RESOLVE_TARGET_INCOMPLETE" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::createOutlineTargets()
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    glGenFramebuffers(2, _outlineFramebuffers);
+    glGenTextures(2, _outlineSeeds);
+
+    for (int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, _outlineSeeds[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16I, _size.x, _size.y, 0, GL_RG_INTEGER, GL_SHORT, nullptr);
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, _outlineSeeds[i], RESOURCE_RENDER_TARGET, "Outlines",
+                               ResourceTracker::getTextureBytes(GL_RG16I, _size.x, _size.y));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, _outlineFramebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _outlineSeeds[i], 0);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDERER::OUTLINE_TARGET_INCOMPLETE" << std::endl;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::destroyOutlineTargets()
+{
+    if (!_outlineFramebuffers[0])
+        return;
+
+    for (GLuint texture : _outlineSeeds)
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, texture);
+    glDeleteTextures(2, _outlineSeeds);
+    glDeleteFramebuffers(2, _outlineFramebuffers);
+
+    _outlineFramebuffers[0] = _outlineFramebuffers[1] = 0;
+    _outlineSeeds[0] = _outlineSeeds[1] = 0;
+}
+
+void Renderer::createOitTargets()
+{
+    glGenFramebuffers(1, &_oitFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _oitFramebuffer);
+
+    struct Attachment
+    {
+        GLuint *texture;
+        GLint internalFormat;
+        GLenum format;
+        GLenum type;
+        GLenum attachment;
+    };
+
+    const Attachment attachments[] = {
+        {&_oitAccumulation, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0},
+        {&_oitWeights, GL_R16F, GL_RED, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT1},
+        {&_oitDepth, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT},
+    };
+
+    for (const Attachment &attachment : attachments)
+    {
+        glGenTextures(1, attachment.texture);
+        glBindTexture(GL_TEXTURE_2D, *attachment.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, attachment.internalFormat, _size.x, _size.y, 0, attachment.format, attachment.type, nullptr);
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, *attachment.texture, RESOURCE_RENDER_TARGET, "Transparency",
+                               ResourceTracker::getTextureBytes(attachment.internalFormat, _size.x, _size.y));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.attachment, GL_TEXTURE_2D, *attachment.texture, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDERER::OIT_TARGET_INCOMPLETE" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::destroyOitTargets()
+{
+    if (!_oitFramebuffer)
+        return;
+
+    GLuint textures[] = {_oitAccumulation, _oitWeights, _oitDepth};
+    for (GLuint texture : textures)
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, texture);
+    glDeleteTextures(3, textures);
+    glDeleteFramebuffers(1, &_oitFramebuffer);
+
+    _oitFramebuffer = _oitAccumulation = _oitWeights = _oitDepth = 0;
+}
+
+void Renderer::createGBuffer()
+{
+    if (_size.x <= 0 || _size.y <= 0)
+        return;
+
+    glGenFramebuffers(1, &_gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _gBuffer);
+
+    struct Attachment
+    {
+        GLuint *texture;
+        GLint internalFormat;
+        GLenum format;
+        GLenum type;
+        GLenum attachment;
+    };
+
+    const Attachment attachments[] = {
+        {&_gAlbedo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0},
+        {&_gSpecular, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT1},
+        {&_gNormal, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT2},
+        {&_gEmission, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT3},
+        {&_gDepth, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT},
+    };
+
+    for (const Attachment &attachment : attachments)
+    {
+        glGenTextures(1, attachment.texture);
+        glBindTexture(GL_TEXTURE_2D, *attachment.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, attachment.internalFormat, _size.x, _size.y, 0, attachment.format, attachment.type, nullptr);
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, *attachment.texture, RESOURCE_RENDER_TARGET, "G-buffer",
+                               ResourceTracker::getTextureBytes(attachment.internalFormat, _size.x, _size.y));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.attachment, GL_TEXTURE_2D, *attachment.texture, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+    glDrawBuffers(4, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::RENDERER::GBUFFER_INCOMPLETE" << std::endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Renderer::destroyGBuffer()
+{
+    if (!_gBuffer)
+        return;
+
+    GLuint textures[] = {_gAlbedo, _gSpecular, _gNormal, _gEmission, _gDepth};
+    for (GLuint texture : textures)
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, texture);
+    glDeleteTextures(5, textures);
+    glDeleteFramebuffers(1, &_gBuffer);
+
+    _gBuffer = _gAlbedo = _gSpecular = _gNormal = _gEmission = _gDepth = 0;
+}
+
+void Renderer::createLightVolume(LightVolume &volume, const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices)
+{
+    glGenVertexArrays(1, &volume.vao);
+    glGenBuffers(1, &volume.vbo);
+    glGenBuffers(1, &volume.ebo);
+    glGenBuffers(1, &volume.instances);
+
+    glBindVertexArray(volume.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, volume.vbo);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volume.ebo);
+    volume.indicesCount = indices.size();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    ResourceTracker::track(RESOURCE_GL_BUFFER, volume.vbo, RESOURCE_GEOMETRY, "Light volumes", positions.size() * sizeof(glm::vec3));
+    ResourceTracker::track(RESOURCE_GL_BUFFER, volume.ebo, RESOURCE_GEOMETRY, "Light volumes", indices.size() * sizeof(unsigned int));
+
+    for (int i = 0; i < 6; i++)
+    {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    setLightInstanceAttributes(volume.instances, 0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::setLightInstanceAttributes(GLuint buffer, GLintptr offset)
+{
+    // One vec4 attribute per LightInstance member, starting at location 3
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int i = 0; i < 6; i++)
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(LightInstance), (void *)(offset + i * sizeof(glm::vec4)));
+}
+
+void Renderer::destroyLightVolume(LightVolume &volume)
+{
+    ResourceTracker::release(RESOURCE_GL_BUFFER, volume.instances);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, volume.ebo);
+    ResourceTracker::release(RESOURCE_GL_BUFFER, volume.vbo);
+    glDeleteBuffers(1, &volume.instances);
+    glDeleteBuffers(1, &volume.ebo);
+    glDeleteBuffers(1, &volume.vbo);
+    glDeleteVertexArrays(1, &volume.vao);
+}
+
+void Renderer::imguiDraw()
+{
+    if (ImGui::CollapsingHeader("Renderer"))
+    {
+        ImGui::Text("Path: %s", path == RenderPath::DEFERRED ? "Deferred" : "Forward");
+        ImGui::Text("Size: %d x %d of %d x %d", _size.x, _size.y, _outputSize.x, _outputSize.y);
+        ImGui::Checkbox("Depth pre-pass", &depthPrePass);
+        ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        ImGui::Checkbox("Software occlusion", &softwareOcclusion);
+        ImGui::Checkbox("GPU culling", &gpuCulling);
+        ImGui::Text("Stream buffer: %s, %.0f KB per frame", _stream->isPersistent() ? "persistent" : "mapped ranges",
+                    _profiler.getCounter("Streamed bytes") / 1024.0);
+        if (softwareOcclusion)
+        {
+            // Millions per second, from the last frame's timings
+            float rasterizeMs = _profiler.getCpuMilliseconds("Software rasterize");
+            float testMs = _profiler.getCpuMilliseconds("Software test");
+            ImGui::Text("Rasterize: %.1f Mtri/s", rasterizeMs > 0.0f ? _softwareOcclusion->getTriangleCount() / (rasterizeMs * 1000.0f) : 0.0f);
+            ImGui::Text("Test: %.1f Mobjects/s", testMs > 0.0f ? _profiler.getCounter("Software tested") / (testMs * 1000.0f) : 0.0f);
+        }
+
+        const char *transparencyModes[] = {"Sorted", "Weighted blended"};
+        int mode = transparencyMode;
+        if (ImGui::Combo("Transparency", &mode, transparencyModes, IM_ARRAYSIZE(transparencyModes)))
+            transparencyMode = (TransparencyMode)mode;
+
+        const char *antiAliasingModes[] = {"Off", "MSAA", "FXAA"};
+        mode = antiAliasing;
+        if (ImGui::Combo("Anti-aliasing", &mode, antiAliasingModes, IM_ARRAYSIZE(antiAliasingModes)))
+            antiAliasing = (AntiAliasingMode)mode;
+        if (antiAliasing == AntiAliasingMode::AA_MSAA && path == RenderPath::DEFERRED)
+            ImGui::Text("MSAA needs the forward path, the G-buffer has one sample");
+        else if (antiAliasing == AntiAliasingMode::AA_MSAA)
+            ImGui::SliderInt("Samples", &msaaSamples, 2, glm::max((int)_maxSamples, 2));
+        // Whole frames, switch modes to compare them
+        ImGui::Text("Frame GPU: off %.2f ms, MSAA %.2f ms, FXAA %.2f ms", _antiAliasingMilliseconds[AntiAliasingMode::AA_OFF],
+                    _antiAliasingMilliseconds[AntiAliasingMode::AA_MSAA], _antiAliasingMilliseconds[AntiAliasingMode::AA_FXAA]);
+
+        ImGui::ColorEdit3("Outline color", &outlineColor.x);
+        ImGui::SliderFloat("Outline width", &outlineWidth, 1.0f, 32.0f);
+
+        _gpuCulling->imguiDraw();
+        _shadows->imguiDraw();
+        _picker->imguiDraw();
+        _resolution->imguiDraw();
+        ImGui::SliderFloat("Upscale sharpness", &upscaleSharpness, 0.0f, 1.0f);
+    }
+}
@@ -0,0 +1,160 @@
+#include <engine/resolutionController.h>
+#include <engine/metrics.h>
+
+#include <algorithm>
+#include <cmath>
+#include "imgui.h"
+
+// Fraction of the budget the scale aims for, so noise alone does not push frames over it
+static constexpr float BUDGET_HEADROOM = 0.9f;
+// How much of the new estimate is taken each frame
+static constexpr float SMOOTHING = 0.1f;
+// Frames between changes, more than the queries lag behind so the effect of the last change is measured
+static constexpr int SETTLE_FRAMES = 8;
+
+ResolutionController::ResolutionController()
+{
+    glGenQueries(LATENCY * 2, &_queries[0][0]);
+}
+
+ResolutionController::~ResolutionController()
+{
+    glDeleteQueries(LATENCY * 2, &_queries[0][0]);
+}
+
+void ResolutionController::beginFrame()
+{
+    collect();
+
+    // Every frame in the ring is still in flight, this one goes unmeasured instead of waiting
+    if (_pending[_current])
+    {
+        _active = false;
+        return;
+    }
+
+    glQueryCounter(_queries[_current][0], GL_TIMESTAMP);
+    _frameScales[_current] = getScale();
+    _active = true;
+}
+
+void ResolutionController::endFrame()
+{
+    if (!_active)
+        return;
+
+    glQueryCounter(_queries[_current][1], GL_TIMESTAMP);
+    _pending[_current] = true;
+    _current = (_current + 1) % LATENCY;
+    _active = false;
+}
+
+glm::ivec2 ResolutionController::getRenderSize(const glm::ivec2 &outputSize) const
+{
+    return glm::ivec2(glm::vec2(outputSize) * getScale() + 0.5f);
+}
+
+float ResolutionController::getScale() const
+{
+    return enabled ? glm::clamp(_scale, minScale, maxScale) : 1.0f;
+}
+
+float ResolutionController::getGpuMilliseconds() const { return _gpuMilliseconds; }
+
+float ResolutionController::getWithinBudget() const
+{
+    return _measuredFrames > 0 ? (float)_framesWithinBudget / _measuredFrames : 1.0f;
+}
+
+void ResolutionController::resetStatistics()
+{
+    _averageMilliseconds = 0.0f;
+    _worstMilliseconds = 0.0f;
+    _measuredFrames = 0;
+    _framesWithinBudget = 0;
+    _scaleChanges = 0;
+}
+
+void ResolutionController::collect()
+{
+    // Oldest frame first so the controller sees them in order
+    for (int i = 0; i < LATENCY; i++)
+    {
+        int index = (_current + i) % LATENCY;
+        if (!_pending[index])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(_queries[index][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(_queries[index][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(_queries[index][1], GL_QUERY_RESULT, &end);
+        _pending[index] = false;
+
+        update((float)(end - start) / 1000000.0f, _frameScales[index]);
+    }
+}
+
+void ResolutionController::update(float milliseconds, float frameScale)
+{
+    static MetricGauge &scaleMetric = Metrics::gauge("engine_render_scale", "Resolution scale of the scene");
+    static MetricGauge &gpuTime = Metrics::gauge("engine_gpu_frame_seconds", "GPU time of the last measured frame");
+    static MetricCounter &overBudget = Metrics::counter("engine_frames_over_budget_total", "Frames whose GPU time went over the target");
+
+    _gpuMilliseconds = milliseconds;
+    _averageMilliseconds = _measuredFrames > 0 ? _averageMilliseconds * 0.95f + milliseconds * 0.05f : milliseconds;
+    _worstMilliseconds = std::max(_worstMilliseconds, milliseconds);
+    _measuredFrames++;
+    if (milliseconds <= targetMilliseconds)
+        _framesWithinBudget++;
+    else
+        overBudget.add();
+
+    gpuTime.set(milliseconds / 1000.0);
+    scaleMetric.set(getScale());
+
+    _framesSinceChange++;
+    if (!enabled || milliseconds <= 0.0f)
+        return;
+
+    float scale = getScale();
+    float ideal = frameScale * std::sqrt(targetMilliseconds * BUDGET_HEADROOM / milliseconds);
+    _idealScale += (glm::clamp(ideal, minScale, maxScale) - _idealScale) * SMOOTHING;
+
+    if (_framesSinceChange < SETTLE_FRAMES || std::abs(_idealScale - scale) < SCALE_STEP)
+        return;
+
+    // Down a full step as soon as the estimate is below it, up only once the estimate clears the next step
+    float stepped = _idealScale < scale ? std::floor(_idealScale / SCALE_STEP) * SCALE_STEP
+                                        : std::floor(_idealScale / SCALE_STEP + 1e-3f) * SCALE_STEP;
+    stepped = glm::clamp(stepped, minScale, maxScale);
+    if (stepped == scale)
+        return;
+
+    _scale = stepped;
+    _framesSinceChange = 0;
+    _scaleChanges++;
+}
+
+void ResolutionController::imguiDraw()
+{
+    if (ImGui::TreeNode("Dynamic resolution"))
+    {
+        ImGui::Checkbox("Enabled", &enabled);
+        ImGui::SliderFloat("Target", &targetMilliseconds, 1.0f, 50.0f, "%.1f ms");
+        ImGui::SliderFloat("Min scale", &minScale, 0.25f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Max scale", &maxScale, 0.25f, 2.0f, "%.2f");
+        maxScale = std::max(maxScale, minScale);
+
+        ImGui::Text("Scale: %.2f (%d changes)", getScale(), _scaleChanges);
+        ImGui::Text("GPU: %.2f ms, average %.2f ms, worst %.2f ms", _gpuMilliseconds, _averageMilliseconds, _worstMilliseconds);
+        ImGui::Text("Within budget: %.1f%% of %d frames", getWithinBudget() * 100.0f, _measuredFrames);
+        if (ImGui::Button("Reset statistics"))
+            resetStatistics();
+        ImGui::TreePop();
+    }
+}
@@ -0,0 +1,376 @@
+#include <engine/resourceTracker.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "imgui.h"
+
+static const char *KIND_NAMES[] = {"buffer", "texture", "renderbuffer", "program", "host"};
+
+// Owners listed in the overlay, the dump has them all
+static constexpr int OVERLAY_OWNERS = 10;
+
+namespace
+{
+    struct Entry
+    {
+        ResourceCategory category;
+        std::string owner;
+        uint64_t bytes;
+    };
+
+    struct Totals
+    {
+        const char *name;
+        uint64_t bytes = 0;
+        uint64_t peak = 0;
+        int count = 0;
+        uint64_t budget = 0;
+        bool overBudget = false;
+    };
+
+    struct Owner
+    {
+        uint64_t bytes = 0;
+        uint64_t categoryBytes[RESOURCE_CATEGORY_COUNT] = {};
+        std::vector<std::pair<uint64_t, const Entry *>> resources;
+    };
+}
+
+static std::mutex mutex;
+static std::unordered_map<uint64_t, Entry> entries;
+static Totals categories[RESOURCE_CATEGORY_COUNT] = {
+    {"Geometry"}, {"Textures"}, {"Render targets"}, {"Buffers"}, {"Programs"}, {"Geometry copies"},
+};
+static Totals gpuTotals = {"GPU"};
+static Totals systemTotals = {"System"};
+static thread_local std::vector<std::string> owners;
+
+static bool isGpu(ResourceCategory category)
+{
+    return category < RESOURCE_GEOMETRY_COPY;
+}
+
+static uint64_t getKey(ResourceKind kind, uintptr_t id)
+{
+    // Host addresses fit in 56 bits
+    return (uint64_t)kind << 56 | (uint64_t)id;
+}
+
+static double toMegabytes(uint64_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+static void adjust(Totals &totals, int64_t bytes, int count)
+{
+    totals.bytes += bytes;
+    totals.count += count;
+    totals.peak = std::max(totals.peak, totals.bytes);
+
+    if (!totals.budget || totals.bytes <= totals.budget)
+    {
+        totals.overBudget = false;
+        return;
+    }
+
+    if (!totals.overBudget)
+        std::cout << "ERROR::RESOURCE_TRACKER::OVER_BUDGET " << totals.name << " " << toMegabytes(totals.bytes)
+                  << " MB of " << toMegabytes(totals.budget) << " MB" << std::endl;
+    totals.overBudget = true;
+}
+
+static void adjust(ResourceCategory category, int64_t bytes, int count)
+{
+    adjust(categories[category], bytes, count);
+    adjust(isGpu(category) ? gpuTotals : systemTotals, bytes, count);
+}
+
+static ResourceTracker::Usage getUsage(const Totals &totals)
+{
+    return {totals.bytes, totals.peak, totals.count, totals.budget};
+}
+
+// Mutex held
+static std::map<std::string, Owner> groupByOwner()
+{
+    std::map<std::string, Owner> grouped;
+    for (const auto &[key, entry] : entries)
+    {
+        Owner &owner = grouped[entry.owner];
+        owner.bytes += entry.bytes;
+        owner.categoryBytes[entry.category] += entry.bytes;
+        owner.resources.emplace_back(key, &entry);
+    }
+    return grouped;
+}
+
+static void writeString(std::FILE *file, const std::string &text)
+{
+    std::fputc('"', file);
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            std::fputc('\\', file);
+        if ((unsigned char)c < 0x20)
+            std::fprintf(file, "\\u%04x", c);
+        else
+            std::fputc(c, file);
+    }
+    std::fputc('"', file);
+}
+
+static void writeUsage(std::FILE *file, const Totals &totals)
+{
+    std::fprintf(file, "{\"bytes\": %llu, \"peak\": %llu, \"count\": %d, \"budget\": %llu}", (unsigned long long)totals.bytes,
+                 (unsigned long long)totals.peak, totals.count, (unsigned long long)totals.budget);
+}
+
+void ResourceTracker::track(ResourceKind kind, uintptr_t id, ResourceCategory category, const char *owner, uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(getKey(kind, id));
+    if (found == entries.end())
+    {
+        entries.emplace(getKey(kind, id), Entry{category, owner ? owner : "Unowned", bytes});
+        adjust(category, bytes, 1);
+        return;
+    }
+
+    // By the difference, dropping to zero in between would warn again for every resize past a budget
+    Entry &entry = found->second;
+    if (entry.category == category)
+        adjust(category, (int64_t)bytes - (int64_t)entry.bytes, 0);
+    else
+    {
+        adjust(entry.category, -(int64_t)entry.bytes, -1);
+        adjust(category, bytes, 1);
+    }
+    entry.category = category;
+    entry.bytes = bytes;
+}
+
+void ResourceTracker::track(ResourceKind kind, uintptr_t id, ResourceCategory category, uint64_t bytes)
+{
+    track(kind, id, category, owners.empty() ? nullptr : owners.back().c_str(), bytes);
+}
+
+void ResourceTracker::release(ResourceKind kind, uintptr_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(getKey(kind, id));
+    if (found == entries.end())
+        return;
+
+    adjust(found->second.category, -(int64_t)found->second.bytes, -1);
+    entries.erase(found);
+}
+
+void ResourceTracker::beginOwner(const std::string &owner)
+{
+    owners.push_back(owner);
+}
+
+void ResourceTracker::endOwner()
+{
+    if (!owners.empty())
+        owners.pop_back();
+}
+
+ResourceTracker::Usage ResourceTracker::getUsage(ResourceCategory category)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::getUsage(categories[category]);
+}
+
+ResourceTracker::Usage ResourceTracker::getGpuUsage()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::getUsage(gpuTotals);
+}
+
+ResourceTracker::Usage ResourceTracker::getSystemUsage()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::getUsage(systemTotals);
+}
+
+uint64_t ResourceTracker::getOwnerBytes(const std::string &owner)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t bytes = 0;
+    for (const auto &[key, entry] : entries)
+        if (entry.owner == owner)
+            bytes += entry.bytes;
+    return bytes;
+}
+
+void ResourceTracker::setBudget(ResourceCategory category, uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    categories[category].budget = bytes;
+    adjust(categories[category], 0, 0);
+}
+
+void ResourceTracker::setGpuBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    gpuTotals.budget = bytes;
+    adjust(gpuTotals, 0, 0);
+}
+
+void ResourceTracker::setSystemBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    systemTotals.budget = bytes;
+    adjust(systemTotals, 0, 0);
+}
+
+bool ResourceTracker::dumpJson(const std::string &path)
+{
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        std::cout << "ERROR::RESOURCE_TRACKER::FILE_NOT_OPENED " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, Owner> grouped = groupByOwner();
+    std::vector<std::pair<const std::string *, Owner *>> sorted;
+    for (auto &[name, owner] : grouped)
+    {
+        std::sort(owner.resources.begin(), owner.resources.end(), [](const auto &a, const auto &b)
+                  { return a.second->bytes > b.second->bytes; });
+        sorted.emplace_back(&name, &owner);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+              { return a.second->bytes > b.second->bytes; });
+
+    std::fprintf(file, "{\n  \"gpu\": ");
+    writeUsage(file, gpuTotals);
+    std::fprintf(file, ",\n  \"system\": ");
+    writeUsage(file, systemTotals);
+    std::fprintf(file, ",\n  \"categories\": {");
+    for (int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+    {
+        std::fprintf(file, "%s\n    \"%s\": ", i ? "," : "", categories[i].name);
+        writeUsage(file, categories[i]);
+    }
+    std::fprintf(file, "\n  },\n  \"owners\": [");
+
+    for (int i = 0; i < sorted.size(); i++)
+    {
+        const Owner &owner = *sorted[i].second;
+        std::fprintf(file, "%s\n    {\"owner\": ", i ? "," : "");
+        writeString(file, *sorted[i].first);
+        std::fprintf(file, ", \"bytes\": %llu, \"categories\": {", (unsigned long long)owner.bytes);
+        bool first = true;
+        for (int category = 0; category < RESOURCE_CATEGORY_COUNT; category++)
+            if (owner.categoryBytes[category])
+            {
+                std::fprintf(file, "%s\"%s\": %llu", first ? "" : ", ", categories[category].name,
+                             (unsigned long long)owner.categoryBytes[category]);
+                first = false;
+            }
+        std::fprintf(file, "}, \"resources\": [");
+        for (int j = 0; j < owner.resources.size(); j++)
+        {
+            auto [key, entry] = owner.resources[j];
+            std::fprintf(file, "%s\n      {\"kind\": \"%s\", \"id\": %llu, \"category\": \"%s\", \"bytes\": %llu}", j ? "," : "",
+                         KIND_NAMES[key >> 56], (unsigned long long)(key & ((1ull << 56) - 1)), categories[entry->category].name,
+                         (unsigned long long)entry->bytes);
+        }
+        std::fprintf(file, "\n    ]}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+
+    bool written = std::ferror(file) == 0;
+    std::fclose(file);
+    if (!written)
+        std::cout << "ERROR::RESOURCE_TRACKER::FILE_NOT_WRITTEN " << path << std::endl;
+    return written;
+}
+
+uint64_t ResourceTracker::getTextureBytes(GLenum internalFormat, int width, int height, int levels)
+{
+    uint64_t texelBytes = 4;
+    switch (internalFormat)
+    {
+    case GL_RED:
+    case GL_R8:
+        texelBytes = 1;
+        break;
+    case GL_RG:
+    case GL_RG8:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+        texelBytes = 2;
+        break;
+    case GL_RG32F:
+    case GL_RGB16F:
+    case GL_RGBA16F:
+        texelBytes = 8;
+        break;
+    case GL_RGB32F:
+    case GL_RGBA32F:
+        texelBytes = 16;
+        break;
+    }
+
+    uint64_t bytes = 0;
+    for (int level = 0; level < levels; level++)
+        bytes += (uint64_t)std::max(width >> level, 1) * std::max(height >> level, 1) * texelBytes;
+    return bytes;
+}
+
+int ResourceTracker::getMipCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+void ResourceTracker::imguiDraw()
+{
+    if (ImGui::Button("Dump to resources.json"))
+        dumpJson("resources.json");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Totals *totals : {&gpuTotals, &systemTotals})
+    {
+        if (totals->budget)
+            ImGui::Text("%s: %.1f MB of %.0f MB, peak %.1f MB", totals->name, toMegabytes(totals->bytes),
+                        toMegabytes(totals->budget), toMegabytes(totals->peak));
+        else
+            ImGui::Text("%s: %.1f MB, peak %.1f MB", totals->name, toMegabytes(totals->bytes), toMegabytes(totals->peak));
+    }
+
+    ImGui::SeparatorText("Categories");
+    for (const Totals &totals : categories)
+    {
+        ImGui::Text("%s: %.2f MB in %d, peak %.2f MB%s", totals.name, toMegabytes(totals.bytes), totals.count,
+                    toMegabytes(totals.peak), totals.overBudget ? " (over budget)" : "");
+    }
+
+    // Grouped only while open, it goes over every resource
+    if (ImGui::TreeNode("Biggest owners"))
+    {
+        std::map<std::string, Owner> grouped = groupByOwner();
+        std::vector<std::pair<uint64_t, const std::string *>> sorted;
+        for (const auto &[name, owner] : grouped)
+            sorted.emplace_back(owner.bytes, &name);
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+                  { return a.first > b.first; });
+
+        for (int i = 0; i < std::min((int)sorted.size(), OVERLAY_OWNERS); i++)
+            ImGui::Text("%s: %.2f MB", sorted[i].second->c_str(), toMegabytes(sorted[i].first));
+        ImGui::TreePop();
+    }
+}
@@ -1,7 +1,28 @@
 #include <engine/game.h>
+#include <engine/resourceTracker.h>
 #include <engine/shader.h>
+#include <engine/texture.h>
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath)
+// From GL 4.1 or GL_ARB_get_program_binary, the context is only 3.3
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+
+// Defines go right after the #version line, which has to stay first
+static std::string addDefines(const std::string &code, const std::vector<std::string> &defines)
+{
+    if (defines.empty())
+        return code;
+
+    size_t versionEnd = code.find('\n') + 1;
+    std::string header;
+    for (const std::string &define : defines)
+        header += "#define " + define + "\n";
+
+    return code.substr(0, versionEnd) + header + code.substr(versionEnd);
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines,
+               const std::vector<std::string> &feedbackVaryings)
+    : _vertexPath(vertexPath), _fragmentPath(fragmentPath ? fragmentPath : ""), _defines(defines), _feedbackVaryings(feedbackVaryings)
 {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
@@ -17,17 +38,19 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     {
         // open files
         vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
         std::stringstream vShaderStream, fShaderStream;
         // read file's buffer contents into streams
         vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
         vShaderFile.close();
-        fShaderFile.close();
+        if (fragmentPath)
+        {
+            fShaderFile.open(fragmentPath);
+            fShaderStream << fShaderFile.rdbuf();
+            fShaderFile.close();
+        }
         // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = addDefines(vShaderStream.str(), defines);
+        fragmentCode = addDefines(fShaderStream.str(), defines);
     }
     catch (std::ifstream::failure e)
     {
@@ -52,23 +75,37 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
                   << infoLog << std::endl;
     }
 
-    GLuint fragmentShader;
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fShaderCode, NULL);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    GLuint fragmentShader = 0;
+    if (fragmentPath)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
+        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fShaderCode, NULL);
+        glCompileShader(fragmentShader);
+
+        glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
+                      << infoLog << std::endl;
+        }
     }
 
     GLuint shaderProgram;
     shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
+    if (fragmentShader)
+        glAttachShader(shaderProgram, fragmentShader);
+
+    // Has to be known before linking
+    if (!feedbackVaryings.empty())
+    {
+        std::vector<const char *> varyings;
+        for (const std::string &varying : feedbackVaryings)
+            varyings.push_back(varying.c_str());
+        glTransformFeedbackVaryings(shaderProgram, varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    }
+
     glLinkProgram(shaderProgram);
 
     glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
@@ -80,13 +117,45 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     }
 
     glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    if (fragmentShader)
+        glDeleteShader(fragmentShader);
 
     _id = shaderProgram;
+
+    // Only known to drivers able to hand the binary back
+    GLint binaryLength = 0;
+    if (glfwExtensionSupported("GL_ARB_get_program_binary"))
+        glGetProgramiv(_id, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    std::string owner = fragmentPath ? _vertexPath + ", " + _fragmentPath : _vertexPath;
+    ResourceTracker::track(RESOURCE_GL_PROGRAM, _id, RESOURCE_PROGRAM, owner.c_str(), binaryLength);
+
+    bindEngineInterface();
+}
+
+void Shader::bindEngineInterface() const
+{
+    GLuint materialsBlock = glGetUniformBlockIndex(_id, "Materials");
+    if (materialsBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(_id, materialsBlock, UniformBlock::MATERIALS_BLOCK);
+
+    GLuint shadowsBlock = glGetUniformBlockIndex(_id, "Shadows");
+    if (shadowsBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(_id, shadowsBlock, UniformBlock::SHADOWS_BLOCK);
+
+    use();
+    setUniform("diffuseMap", (int)TextureUnit::DIFFUSE_MAP_UNIT);
+    setUniform("specularMap", (int)TextureUnit::SPECULAR_MAP_UNIT);
+    setUniform("emissionMap", (int)TextureUnit::EMISSION_MAP_UNIT);
+    setUniform("shadowAtlas", (int)TextureUnit::SHADOW_ATLAS_UNIT);
+    setUniform("instanceData", (int)TextureUnit::INSTANCE_DATA_UNIT);
+    setUniform("instanceVisibility", (int)TextureUnit::INSTANCE_VISIBILITY_UNIT);
+    setUniform("depthPyramid", (int)TextureUnit::DEPTH_PYRAMID_UNIT);
+    glUseProgram(0);
 }
 
 Shader::~Shader()
 {
+    ResourceTracker::release(RESOURCE_GL_PROGRAM, _id);
     glDeleteProgram(_id);
 }
 
@@ -95,36 +164,69 @@ void Shader::use() const
     glUseProgram(_id);
 }
 
-void Shader::setUniform(const std::string &name, bool value) const
+const Shader &Shader::getVariant(const char *define) const
 {
-    glUniform1i(glGetUniformLocation(_id, name.c_str()), (int)value);
+    for (const auto &[name, variant] : _variants)
+        if (name == define)
+            return *variant;
+
+    std::vector<std::string> defines = _defines;
+    defines.push_back(define);
+
+    const char *fragmentPath = _fragmentPath.empty() ? nullptr : _fragmentPath.c_str();
+    _variants.emplace_back(define, std::make_unique<Shader>(_vertexPath.c_str(), fragmentPath, defines, _feedbackVaryings));
+    return *_variants.back().second;
 }
-void Shader::setUniform(const std::string &name, int value) const
+
+GLint Shader::getLocation(const char *name) const
 {
-    glUniform1i(glGetUniformLocation(_id, name.c_str()), value);
+    auto it = _locations.find(std::string_view(name));
+    if (it != _locations.end())
+        return it->second;
+
+    GLint location = glGetUniformLocation(_id, name);
+    _locations.emplace(name, location);
+    return location;
 }
-void Shader::setUniform(const std::string &name, float value) const
+
+void Shader::setUniform(const char *name, bool value) const
 {
-    glUniform1f(glGetUniformLocation(_id, name.c_str()), value);
+    glUniform1i(getLocation(name), (int)value);
 }
-void Shader::setUniform(const std::string &name, float x, float y, float z, float w) const
+void Shader::setUniform(const char *name, int value) const
 {
-    glUniform4f(glGetUniformLocation(_id, name.c_str()), x, y, z, w);
+    glUniform1i(getLocation(name), value);
 }
-void Shader::setUniform(const std::string &name, float x, float y, float z) const
+void Shader::setUniform(const char *name, unsigned int value) const
 {
-    glUniform3f(glGetUniformLocation(_id, name.c_str()), x, y, z);
+    glUniform1ui(getLocation(name), value);
+}
+void Shader::setUniform(const char *name, float value) const
+{
+    glUniform1f(getLocation(name), value);
+}
+void Shader::setUniform(const char *name, float x, float y, float z, float w) const
+{
+    glUniform4f(getLocation(name), x, y, z, w);
+}
+void Shader::setUniform(const char *name, float x, float y, float z) const
+{
+    glUniform3f(getLocation(name), x, y, z);
 }
 
-void Shader::setUniform(const std::string &name, const glm::vec3 &val) const
+void Shader::setUniform(const char *name, const glm::vec2 &val) const
+{
+    glUniform2f(getLocation(name), val.x, val.y);
+}
+void Shader::setUniform(const char *name, const glm::vec3 &val) const
 {
-    glUniform3f(glGetUniformLocation(_id, name.c_str()), val.x, val.y, val.z);
+    glUniform3f(getLocation(name), val.x, val.y, val.z);
 }
-void Shader::setUniform(const std::string &name, const glm::vec4 &val) const
+void Shader::setUniform(const char *name, const glm::vec4 &val) const
 {
-    glUniform4f(glGetUniformLocation(_id, name.c_str()), val.x, val.y, val.z, val.w);
+    glUniform4f(getLocation(name), val.x, val.y, val.z, val.w);
 }
-void Shader::setUniform(const std::string &name, const glm::mat4 &matrix) const
+void Shader::setUniform(const char *name, const glm::mat4 &matrix) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+    glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include <engine/shadowAtlas.h>
+#include <engine/bounds.h>
+#include <engine/camera.h>
+#include <engine/light.h>
+#include <engine/profiler.h>
+#include <engine/renderer.h>
+#include <engine/resourceTracker.h>
+
+#include <cmath>
+#include <iostream>
+#include "imgui.h"
+
+static constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+static glm::mat4 lookAtDirection(const glm::vec3 &position, const glm::vec3 &direction)
+{
+    glm::vec3 up = glm::abs(direction.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    return glm::lookAt(position, position + direction, up);
+}
+
+ShadowAtlas::ShadowAtlas(const MaterialRegistry &materials, Profiler &profiler)
+    : _materials(materials), _profiler(profiler)
+{
+    _depthShader = std::make_unique<Shader>("./shaders/depth.vs", "./shaders/depth.fs");
+
+    glGenBuffers(1, &_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowData), &_data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _ubo, RESOURCE_BUFFER, "Shadow atlas", sizeof(ShadowData));
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, UniformBlock::SHADOWS_BLOCK, _ubo);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+    destroyAtlas();
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _ubo);
+    glDeleteBuffers(1, &_ubo);
+}
+
+void ShadowAtlas::render(const Camera &camera, const std::vector<Light *> &lights, const std::vector<DrawCommand> &commands)
+{
+    cascadeCount = glm::clamp(cascadeCount, 1, MAX_CASCADES);
+
+    _tiles.clear();
+    _data.cascadeSplits = glm::vec4(0.0f);
+
+    for (Light *light : lights)
+    {
+        light->shadowTile = -1;
+        if (!light->castsShadows)
+            continue;
+
+        if (SpotLight *spotLight = dynamic_cast<SpotLight *>(light))
+        {
+            float range = spotLight->getRange();
+            if (range <= 0.0f || !allocateTiles(*light, 1))
+                continue;
+
+            float fov = glm::min(2.0f * spotLight->outerCutOff, glm::radians(170.0f));
+            glm::mat4 projection = glm::perspective(fov, 1.0f, 0.05f, range);
+            _tiles.push_back({projection * lookAtDirection(light->transform.position, light->transform.forward()), false});
+        }
+        else if (PointLight *pointLight = dynamic_cast<PointLight *>(light))
+        {
+            float range = pointLight->getRange();
+            if (range <= 0.0f || !allocateTiles(*light, 6))
+                continue;
+
+            const glm::vec3 faces[6] = {
+                glm::vec3(1.0f, 0.0f, 0.0f),
+                glm::vec3(-1.0f, 0.0f, 0.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f),
+                glm::vec3(0.0f, 0.0f, 1.0f),
+                glm::vec3(0.0f, 0.0f, -1.0f),
+            };
+
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, range);
+            for (const glm::vec3 &face : faces)
+                _tiles.push_back({projection * lookAtDirection(light->transform.position, face), false});
+        }
+        else
+        {
+            if (!allocateTiles(*light, cascadeCount))
+                continue;
+
+            addCascades(camera, light->transform.forward());
+        }
+    }
+
+    // Light space to the tile's corner of the atlas
+    const float tileScale = (float)TILE_SIZE / SIZE;
+    const float halfTexel = 0.5f / SIZE;
+    const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+
+    for (int i = 0; i < _tiles.size(); i++)
+    {
+        glm::vec2 tileMin = glm::vec2(i % TILES_PER_ROW, i / TILES_PER_ROW) * tileScale;
+        glm::mat4 toTile = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(tileMin, 0.0f)), glm::vec3(tileScale, tileScale, 1.0f));
+
+        _data.matrices[i] = toTile * bias * _tiles[i].viewProjection;
+        _data.tiles[i] = glm::vec4(tileMin + halfTexel, tileMin + tileScale - halfTexel);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowData), &_data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    _profiler.setCounter("Shadow tiles", _tiles.size());
+
+    if (_tiles.empty())
+        return;
+
+    if (!_framebuffer)
+        createAtlas();
+
+    _profiler.beginGpu("Shadows");
+
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (int i = 0; i < _tiles.size(); i++)
+        renderTile(i, commands);
+
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    _profiler.endGpu();
+}
+
+void ShadowAtlas::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit::SHADOW_ATLAS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _atlas);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool ShadowAtlas::allocateTiles(Light &light, int count)
+{
+    if (_tiles.size() + count > MAX_TILES)
+    {
+        _profiler.addCounter("Shadow lights dropped", 1);
+        return false;
+    }
+
+    light.shadowTile = _tiles.size();
+    return true;
+}
+
+void ShadowAtlas::addCascades(const Camera &camera, const glm::vec3 &direction)
+{
+    glm::mat4 projection = camera.getProjectionMatrix();
+    glm::mat4 inverseViewProjection = glm::inverse(projection * camera.getViewMatrix());
+
+    // Clip planes back from the perspective matrix
+    float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+    float distance = glm::min(shadowDistance, farPlane);
+
+    glm::vec3 nearCorners[4];
+    glm::vec3 farCorners[4];
+    for (int i = 0; i < 4; i++)
+    {
+        glm::vec2 ndc = glm::vec2(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f);
+        glm::vec4 nearCorner = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farCorner = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+        nearCorners[i] = glm::vec3(nearCorner) / nearCorner.w;
+        farCorners[i] = glm::vec3(farCorner) / farCorner.w;
+    }
+
+    glm::mat4 lightView = lookAtDirection(glm::vec3(0.0f), direction);
+
+    float sliceStart = nearPlane;
+    for (int i = 0; i < cascadeCount; i++)
+    {
+        // Practical split scheme, mostly logarithmic
+        float t = (float)(i + 1) / cascadeCount;
+        float sliceEnd = glm::mix(nearPlane + (distance - nearPlane) * t, nearPlane * std::pow(distance / nearPlane, t), 0.75f);
+        _data.cascadeSplits[i] = sliceEnd;
+
+        glm::vec3 corners[8];
+        for (int j = 0; j < 4; j++)
+        {
+            corners[j] = glm::mix(nearCorners[j], farCorners[j], (sliceStart - nearPlane) / (farPlane - nearPlane));
+            corners[j + 4] = glm::mix(nearCorners[j], farCorners[j], (sliceEnd - nearPlane) / (farPlane - nearPlane));
+        }
+
+        // A bounding sphere keeps the same size as the camera turns, and snapping its center to texels
+        // keeps the texels in place as it moves, so the edges do not shimmer
+        glm::vec3 center = glm::vec3(0.0f);
+        for (const glm::vec3 &corner : corners)
+            center += corner / 8.0f;
+
+        float radius = 0.0f;
+        for (const glm::vec3 &corner : corners)
+            radius = glm::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        float texel = 2.0f * radius / TILE_SIZE;
+        lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+        lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+        // Casters in front of the near plane are depth clamped onto it
+        glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                               lightCenter.y - radius, lightCenter.y + radius,
+                                               -lightCenter.z - radius, -lightCenter.z + radius);
+
+        _tiles.push_back({lightProjection * lightView, true});
+        sliceStart = sliceEnd;
+    }
+}
+
+void ShadowAtlas::renderTile(int index, const std::vector<DrawCommand> &commands)
+{
+    const Tile &tile = _tiles[index];
+    Frustum frustum(tile.viewProjection);
+
+    _staticCasters.clear();
+    _dynamicCasters.clear();
+
+    uint64_t staticHash = hashBytes(HASH_SEED, &tile.viewProjection, sizeof(glm::mat4));
+    uint64_t dynamicHash = HASH_SEED;
+    int culled = 0;
+
+    for (const DrawCommand &command : commands)
+    {
+        if (!command.castsShadows)
+            continue;
+
+        if (!frustum.intersects(command.mesh->getBounds().transformed(command.model), tile.isDirectional))
+        {
+            culled++;
+            continue;
+        }
+
+        bool isStatic = cacheStatic && command.isStatic;
+        uint64_t &hash = isStatic ? staticHash : dynamicHash;
+        hash = hashBytes(hash, &command.mesh, sizeof(command.mesh));
+        hash = hashBytes(hash, &command.model, sizeof(command.model));
+
+        (isStatic ? _staticCasters : _dynamicCasters).push_back(&command);
+    }
+
+    _profiler.addCounter("Shadow casters culled", culled);
+
+    TileCache &cache = _cache[index];
+    bool staticDirty = cache.staticHash != staticHash;
+    bool dynamicDirty = staticDirty || cache.dynamicHash != dynamicHash;
+
+    if (!dynamicDirty)
+    {
+        _profiler.addCounter("Shadow tiles cached", 1);
+        return;
+    }
+
+    int x = (index % TILES_PER_ROW) * TILE_SIZE;
+    int y = (index / TILES_PER_ROW) * TILE_SIZE;
+    glViewport(x, y, TILE_SIZE, TILE_SIZE);
+    glScissor(x, y, TILE_SIZE, TILE_SIZE);
+
+    if (tile.isDirectional)
+        glEnable(GL_DEPTH_CLAMP);
+    else
+        glDisable(GL_DEPTH_CLAMP);
+
+    if (staticDirty)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, _cacheFramebuffer);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        drawCasters(_staticCasters, tile.viewProjection);
+
+        cache.staticHash = staticHash;
+        _profiler.addCounter("Shadow tiles rerendered", 1);
+    }
+    else
+        _profiler.addCounter("Shadow tiles refreshed", 1);
+
+    // Dynamic casters go over a fresh copy of the static ones
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _cacheFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebuffer);
+    glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE, x, y, x + TILE_SIZE, y + TILE_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    drawCasters(_dynamicCasters, tile.viewProjection);
+
+    cache.dynamicHash = dynamicHash;
+}
+
+void ShadowAtlas::drawCasters(const std::vector<const DrawCommand *> &casters, const glm::mat4 &viewProjection)
+{
+    if (casters.empty())
+        return;
+
+    const Shader &alphaTestShader = _depthShader->getVariant("ALPHA_TEST");
+    for (const Shader *shader : {(const Shader *)_depthShader.get(), &alphaTestShader})
+    {
+        shader->use();
+        shader->setUniform("view", glm::mat4(1.0f));
+        shader->setUniform("projection", viewProjection);
+    }
+
+    const Shader *current = nullptr;
+    for (const DrawCommand *command : casters)
+    {
+        bool alphaTest = _materials.needsAlphaTest(command->material);
+        const Shader *shader = alphaTest ? &alphaTestShader : _depthShader.get();
+        if (shader != current)
+        {
+            shader->use();
+            current = shader;
+        }
+
+        shader->setUniform("model", command->model);
+        if (alphaTest)
+            _materials.use(command->material, *shader);
+
+        command->mesh->draw(*shader);
+    }
+
+    _profiler.addCounter("Shadow draws", casters.size());
+}
+
+void ShadowAtlas::createAtlas()
+{
+    struct Target
+    {
+        GLuint *framebuffer;
+        GLuint *texture;
+    };
+
+    const Target targets[] = {
+        {&_framebuffer, &_atlas},
+        {&_cacheFramebuffer, &_cacheAtlas},
+    };
+
+    for (const Target &target : targets)
+    {
+        glGenTextures(1, target.texture);
+        glBindTexture(GL_TEXTURE_2D, *target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SIZE, SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, *target.texture, RESOURCE_RENDER_TARGET, "Shadow atlas",
+                               ResourceTracker::getTextureBytes(GL_DEPTH_COMPONENT24, SIZE, SIZE));
+        // Linear filtering with a compare mode gives 2x2 PCF for free
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glGenFramebuffers(1, target.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, *target.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, *target.texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SHADOW_ATLAS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (TileCache &cache : _cache)
+        cache = TileCache();
+}
+
+void ShadowAtlas::destroyAtlas()
+{
+    if (!_framebuffer)
+        return;
+
+    GLuint textures[] = {_atlas, _cacheAtlas};
+    GLuint framebuffers[] = {_framebuffer, _cacheFramebuffer};
+    for (GLuint texture : textures)
+        ResourceTracker::release(RESOURCE_GL_TEXTURE, texture);
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(2, framebuffers);
+
+    _framebuffer = _atlas = _cacheFramebuffer = _cacheAtlas = 0;
+}
+
+void ShadowAtlas::imguiDraw()
+{
+    if (ImGui::TreeNode("Shadows"))
+    {
+        ImGui::Text("Tiles: %d / %d", (int)_tiles.size(), MAX_TILES);
+        ImGui::SliderInt("Cascades", &cascadeCount, 1, MAX_CASCADES);
+        ImGui::DragFloat("Distance", &shadowDistance, 1.0f, 1.0f, 100.0f);
+        ImGui::Checkbox("Cache static casters", &cacheStatic);
+        ImGui::TreePop();
+    }
+}
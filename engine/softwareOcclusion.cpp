@@ -0,0 +1,290 @@
+#include <engine/softwareOcclusion.h>
+#include <engine/jobSystem.h>
+#include <engine/mesh.h>
+#include <engine/profiler.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Just enough of a float vector to write the span loop once, 8 lanes with AVX2, 4 with SSE2, 1 otherwise
+namespace simd
+{
+#if defined(__AVX2__)
+    constexpr int LANES = 8;
+    using Float = __m256;
+    using Mask = __m256;
+
+    inline Float set(float value) { return _mm256_set1_ps(value); }
+    inline Float ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+    inline Float load(const float *address) { return _mm256_loadu_ps(address); }
+    inline void store(float *address, Float value) { _mm256_storeu_ps(address, value); }
+    inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    inline Float multiplyAdd(Float a, Float b, Float c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+    inline Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    inline Mask inside(Float a, Float b, Float c)
+    {
+        Float zero = _mm256_setzero_ps();
+        return _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GE_OQ), _mm256_cmp_ps(b, zero, _CMP_GE_OQ)),
+                             _mm256_cmp_ps(c, zero, _CMP_GE_OQ));
+    }
+    inline bool any(Mask mask) { return _mm256_movemask_ps(mask) != 0; }
+    inline Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+#elif defined(__SSE2__) || defined(_M_X64)
+    constexpr int LANES = 4;
+    using Float = __m128;
+    using Mask = __m128;
+
+    inline Float set(float value) { return _mm_set1_ps(value); }
+    inline Float ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+    inline Float load(const float *address) { return _mm_loadu_ps(address); }
+    inline void store(float *address, Float value) { _mm_storeu_ps(address, value); }
+    inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    inline Float multiplyAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    inline Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    inline Mask inside(Float a, Float b, Float c)
+    {
+        Float zero = _mm_setzero_ps();
+        return _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(a, zero), _mm_cmpge_ps(b, zero)), _mm_cmpge_ps(c, zero));
+    }
+    inline bool any(Mask mask) { return _mm_movemask_ps(mask) != 0; }
+    // No blendv before SSE4.1
+    inline Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+#else
+    constexpr int LANES = 1;
+    using Float = float;
+    using Mask = bool;
+
+    inline Float set(float value) { return value; }
+    inline Float ramp() { return 0.0f; }
+    inline Float load(const float *address) { return *address; }
+    inline void store(float *address, Float value) { *address = value; }
+    inline Float add(Float a, Float b) { return a + b; }
+    inline Float multiplyAdd(Float a, Float b, Float c) { return a * b + c; }
+    inline Float min(Float a, Float b) { return std::min(a, b); }
+    inline Mask inside(Float a, Float b, Float c) { return a >= 0.0f && b >= 0.0f && c >= 0.0f; }
+    inline bool any(Mask mask) { return mask; }
+    inline Float select(Mask mask, Float a, Float b) { return mask ? a : b; }
+#endif
+}
+
+static_assert(SoftwareOcclusion::WIDTH % simd::LANES == 0);
+static_assert(SoftwareOcclusion::HEIGHT % (SoftwareOcclusion::BANDS * SoftwareOcclusion::TILE_HEIGHT) == 0);
+
+// Clip space to pixels, depth in [0, 1]
+static glm::vec3 toScreen(const glm::vec4 &clip)
+{
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    return glm::vec3((ndc.x * 0.5f + 0.5f) * SoftwareOcclusion::WIDTH,
+                     (ndc.y * 0.5f + 0.5f) * SoftwareOcclusion::HEIGHT,
+                     ndc.z * 0.5f + 0.5f);
+}
+
+SoftwareOcclusion::SoftwareOcclusion(Profiler &profiler, JobSystem &jobs) : _profiler(profiler), _jobs(jobs)
+{
+    _depth.assign(WIDTH * HEIGHT, 1.0f);
+    _tileMax.assign(TILES_X * TILES_Y, 1.0f);
+}
+
+void SoftwareOcclusion::addOccluder(const Mesh &mesh, const glm::mat4 &model)
+{
+    _occluders.push_back({&mesh, model});
+}
+
+void SoftwareOcclusion::rasterize(const glm::mat4 &viewProjection)
+{
+    _profiler.beginCpu("Software rasterize");
+
+    _viewProjection = viewProjection;
+    setupTriangles();
+    _occluders.clear();
+
+    _jobs.parallelFor(BANDS, 1, [this](int begin, int end)
+                      {
+        for (int band = begin; band < end; band++)
+            rasterizeBand(band); });
+
+    _profiler.endCpu();
+    _profiler.setCounter("Occluder triangles", _triangles.size());
+}
+
+bool SoftwareOcclusion::isVisible(const AABB &bounds) const
+{
+    glm::vec2 min = glm::vec2(WIDTH, HEIGHT);
+    glm::vec2 max = glm::vec2(0.0f);
+    float nearest = 1.0f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner = glm::vec3(i & 1 ? bounds.max.x : bounds.min.x,
+                                     i & 2 ? bounds.max.y : bounds.min.y,
+                                     i & 4 ? bounds.max.z : bounds.min.z);
+        glm::vec4 clip = _viewProjection * glm::vec4(corner, 1.0f);
+
+        // Crosses the near plane, the rectangle is meaningless
+        if (clip.z < -clip.w)
+            return true;
+
+        glm::vec3 screen = toScreen(clip);
+        min = glm::min(min, glm::vec2(screen));
+        max = glm::max(max, glm::vec2(screen));
+        nearest = std::min(nearest, screen.z);
+    }
+
+    // Off screen is for frustum culling to decide
+    if (max.x < 0.0f || max.y < 0.0f || min.x >= WIDTH || min.y >= HEIGHT)
+        return true;
+
+    glm::ivec2 minTile = glm::ivec2(glm::max(min, glm::vec2(0.0f))) / glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+    glm::ivec2 maxTile = glm::min(glm::ivec2(max) / glm::ivec2(TILE_WIDTH, TILE_HEIGHT), glm::ivec2(TILES_X - 1, TILES_Y - 1));
+
+    for (int y = minTile.y; y <= maxTile.y; y++)
+        for (int x = minTile.x; x <= maxTile.x; x++)
+            if (nearest < _tileMax[y * TILES_X + x])
+                return true;
+
+    return false;
+}
+
+int SoftwareOcclusion::getTriangleCount() const { return _triangles.size(); }
+
+void SoftwareOcclusion::setupTriangles()
+{
+    _triangles.clear();
+    for (const Occluder &occluder : _occluders)
+    {
+        glm::mat4 modelViewProjection = _viewProjection * occluder.model;
+
+        const std::vector<glm::vec3> &positions = occluder.mesh->getPositions();
+        _clipPositions.resize(positions.size());
+        for (int i = 0; i < positions.size(); i++)
+            _clipPositions[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+
+        const std::vector<unsigned int> &indices = occluder.mesh->getIndices();
+        for (int i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const glm::vec4 *vertices[3] = {&_clipPositions[indices[i]], &_clipPositions[indices[i + 1]], &_clipPositions[indices[i + 2]]};
+
+            // Against the near plane (z >= -w), one triangle in gives at most two out
+            glm::vec4 clipped[4];
+            int count = 0;
+            for (int j = 0; j < 3; j++)
+            {
+                const glm::vec4 &a = *vertices[j];
+                const glm::vec4 &b = *vertices[(j + 1) % 3];
+                float distanceA = a.z + a.w;
+                float distanceB = b.z + b.w;
+
+                if (distanceA >= 0.0f)
+                    clipped[count++] = a;
+                if ((distanceA >= 0.0f) != (distanceB >= 0.0f))
+                    clipped[count++] = glm::mix(a, b, distanceA / (distanceA - distanceB));
+            }
+
+            for (int j = 2; j < count; j++)
+                addTriangle(clipped[0], clipped[j - 1], clipped[j]);
+        }
+    }
+}
+
+void SoftwareOcclusion::addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+{
+    glm::vec3 v0 = toScreen(a);
+    glm::vec3 v1 = toScreen(b);
+    glm::vec3 v2 = toScreen(c);
+
+    // Occluders are not back face culled, wind every triangle the same way instead
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::abs(area) < 1e-6f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    Triangle triangle;
+    triangle.min = glm::max(glm::ivec2(glm::floor(glm::min(v0, glm::min(v1, v2)))), glm::ivec2(0));
+    triangle.max = glm::min(glm::ivec2(glm::ceil(glm::max(v0, glm::max(v1, v2)))), glm::ivec2(WIDTH - 1, HEIGHT - 1));
+    if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+        return;
+
+    const glm::vec3 vertices[3] = {v0, v1, v2};
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec3 &from = vertices[i];
+        const glm::vec3 &to = vertices[(i + 1) % 3];
+        float x = from.y - to.y;
+        float y = to.x - from.x;
+        triangle.edges[i] = glm::vec3(x, y, -x * from.x - y * from.y);
+    }
+
+    float depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    triangle.depth = glm::vec3(depthX, depthY, v0.z - depthX * v0.x - depthY * v0.y);
+
+    _triangles.push_back(triangle);
+}
+
+void SoftwareOcclusion::rasterizeBand(int band)
+{
+    constexpr int BAND_HEIGHT = HEIGHT / BANDS;
+    int bandStart = band * BAND_HEIGHT;
+    int bandEnd = bandStart + BAND_HEIGHT - 1;
+
+    std::fill(_depth.begin() + bandStart * WIDTH, _depth.begin() + (bandEnd + 1) * WIDTH, 1.0f);
+
+    const simd::Float ramp = simd::ramp();
+    for (const Triangle &triangle : _triangles)
+    {
+        int startY = std::max(triangle.min.y, bandStart);
+        int endY = std::min(triangle.max.y, bandEnd);
+        int startX = triangle.min.x - triangle.min.x % simd::LANES;
+
+        simd::Float edgeX[3];
+        for (int i = 0; i < 3; i++)
+            edgeX[i] = simd::set(triangle.edges[i].x);
+        simd::Float depthX = simd::set(triangle.depth.x);
+
+        for (int y = startY; y <= endY; y++)
+        {
+            float centerY = y + 0.5f;
+            float *row = &_depth[y * WIDTH];
+
+            for (int x = startX; x <= triangle.max.x; x += simd::LANES)
+            {
+                simd::Float centerX = simd::add(ramp, simd::set(x + 0.5f));
+
+                simd::Float edges[3];
+                for (int i = 0; i < 3; i++)
+                    edges[i] = simd::multiplyAdd(edgeX[i], centerX, simd::set(triangle.edges[i].y * centerY + triangle.edges[i].z));
+
+                simd::Mask covered = simd::inside(edges[0], edges[1], edges[2]);
+                if (!simd::any(covered))
+                    continue;
+
+                simd::Float depth = simd::multiplyAdd(depthX, centerX, simd::set(triangle.depth.y * centerY + triangle.depth.z));
+                simd::Float current = simd::load(row + x);
+                simd::store(row + x, simd::select(covered, simd::min(current, depth), current));
+            }
+        }
+    }
+
+    // Farthest depth of each tile, what a box has to be in front of somewhere to be visible
+    for (int tileY = bandStart / TILE_HEIGHT; tileY <= bandEnd / TILE_HEIGHT; tileY++)
+        for (int tileX = 0; tileX < TILES_X; tileX++)
+        {
+            float farthest = 0.0f;
+            for (int y = 0; y < TILE_HEIGHT; y++)
+            {
+                const float *row = &_depth[(tileY * TILE_HEIGHT + y) * WIDTH + tileX * TILE_WIDTH];
+                farthest = std::max(farthest, *std::max_element(row, row + TILE_WIDTH));
+            }
+            _tileMax[tileY * TILES_X + tileX] = farthest;
+        }
+}
@@ -0,0 +1,7 @@
+#include <engine/spatialIndex.h>
+
+void SpatialIndex::insert(int count, const AABB *bounds, void *const *userData, int *proxies)
+{
+    for (int i = 0; i < count; i++)
+        proxies[i] = insert(bounds[i], userData[i]);
+}
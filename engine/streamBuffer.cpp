@@ -0,0 +1,165 @@
+#include <engine/streamBuffer.h>
+#include <engine/profiler.h>
+#include <engine/resourceTracker.h>
+
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+// From GL 4.4, the context is only 3.3 so they are loaded by hand
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+StreamBuffer::StreamBuffer(Profiler &profiler, GLsizeiptr regionSize)
+    : _profiler(profiler), _regionSize(regionSize)
+{
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+
+    PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+    if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+        bufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+
+    if (bufferStorage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(GL_COPY_WRITE_BUFFER, REGIONS * _regionSize, nullptr, flags);
+        _mapped = (char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, REGIONS * _regionSize, flags);
+        _persistent = _mapped != nullptr;
+
+        if (!_persistent)
+        {
+            // Storage is immutable, start over with a plain buffer
+            std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &_buffer);
+            glGenBuffers(1, &_buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+        }
+    }
+
+    if (!_persistent)
+        glBufferData(GL_COPY_WRITE_BUFFER, REGIONS * _regionSize, nullptr, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    ResourceTracker::track(RESOURCE_GL_BUFFER, _buffer, RESOURCE_BUFFER, "Stream buffer", REGIONS * _regionSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : _fences)
+        if (fence)
+            glDeleteSync(fence);
+
+    if (_mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    ResourceTracker::release(RESOURCE_GL_BUFFER, _buffer);
+    glDeleteBuffers(1, &_buffer);
+}
+
+void StreamBuffer::beginFrame()
+{
+    _used = 0;
+    _inFrame = true;
+
+    GLsync &fence = _fences[_region];
+    if (fence)
+    {
+        _profiler.beginCpu("Stream fence wait");
+        GLbitfield flags = 0;
+        while (true)
+        {
+            GLenum result = glClientWaitSync(fence, flags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            // Make sure the fence gets to the GPU before waiting on it again
+            flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        }
+        _profiler.endCpu();
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    GLsizeiptr begin = (_used + alignment - 1) / alignment * alignment;
+    if (!_inFrame || begin + size > _regionSize)
+        return {};
+
+    GLintptr offset = getRegionOffset() + begin;
+    if (_persistent)
+    {
+        _used = begin + size;
+        _profiler.addCounter("Streamed bytes", size);
+        return {_mapped + offset, offset};
+    }
+
+    commit();
+
+    // The fence already covers the GPU's reads of this region, the driver must not add its own wait
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+    _mapped = (char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (!_mapped)
+    {
+        std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+        return {};
+    }
+
+    _used = begin + size;
+    _profiler.addCounter("Streamed bytes", size);
+    return {_mapped, offset};
+}
+
+void StreamBuffer::commit()
+{
+    if (_persistent || !_mapped)
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _mapped = nullptr;
+}
+
+GLintptr StreamBuffer::write(const void *data, GLsizeiptr size, GLsizeiptr alignment)
+{
+    Allocation allocation = allocate(size, alignment);
+    if (!allocation.data)
+        return -1;
+
+    std::memcpy(allocation.data, data, size);
+    commit();
+    return allocation.offset;
+}
+
+void StreamBuffer::endFrame()
+{
+    if (!_inFrame)
+        return;
+
+    commit();
+
+    // Signaled once every draw reading this region is done
+    _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _region = (_region + 1) % REGIONS;
+    _inFrame = false;
+}
+
+GLuint StreamBuffer::getBuffer() const { return _buffer; }
+bool StreamBuffer::isPersistent() const { return _persistent; }
+GLsizeiptr StreamBuffer::getRegionSize() const { return _regionSize; }
+
+GLintptr StreamBuffer::getRegionOffset() const
+{
+    return _region * _regionSize;
+}
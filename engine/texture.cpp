@@ -1,11 +1,29 @@
 #include <engine/texture.h>
+#include <engine/metrics.h>
+#include <engine/resourceTracker.h>
+#include <chrono>
 #include <iostream>
 
+// Textures last bound to the material map units, every draw binds them and most keep the same ones
+static GLuint boundMaps[TextureUnit::EMISSION_MAP_UNIT + 1] = {};
+
+// Alpha at or below which the shaders discard, must match their alpha tests
+static constexpr unsigned char CUTOUT_ALPHA = 25;
+// Soft cutout edges have texels in between too, more than this share of the whole map means it is meant to be
+// blended. The grass is about 8% edges, the window about 85% glass
+static constexpr float PARTIAL_ALPHA_SHARE = 0.2f;
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 Texture::Texture(const std::string imagePath, TextureType type, bool wrap) : type(type)
 {
+    static MetricHistogram &loadTime = Metrics::histogram("engine_texture_load_seconds", "Time to load a texture from disk",
+                                                          {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0});
+    static MetricGauge &loading = Metrics::gauge("engine_assets_loading", "Textures and models being loaded");
+    auto start = std::chrono::steady_clock::now();
+    loading.add(1.0);
+
     glGenTextures(1, &_id);
 
     int width, height, nrChannels;
@@ -32,8 +50,27 @@ Texture::Texture(const std::string imagePath, TextureType type, bool wrap) : typ
         else if (nrChannels == 4)
             format = GL_RGBA;
 
+        if (nrChannels == 4)
+        {
+            int cutout = 0;
+            int partial = 0;
+            for (int i = 3; i < width * height * 4; i += 4)
+            {
+                if (data[i] <= CUTOUT_ALPHA)
+                    cutout++;
+                else if (data[i] < 255)
+                    partial++;
+            }
+
+            _hasCutout = cutout > 0;
+            _hasPartialAlpha = partial > 0 && partial > width * height * PARTIAL_ALPHA_SHARE;
+        }
+
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+
+        _bytes = ResourceTracker::getTextureBytes(format, width, height, ResourceTracker::getMipCount(width, height));
+        ResourceTracker::track(RESOURCE_GL_TEXTURE, _id, RESOURCE_TEXTURE, imagePath.c_str(), _bytes);
     }
     else
     {
@@ -41,12 +78,18 @@ Texture::Texture(const std::string imagePath, TextureType type, bool wrap) : typ
     }
 
     stbi_image_free(data);
+
+    loading.add(-1.0);
+    loadTime.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 }
 
 Texture::Texture(Texture &&other) noexcept
 {
     _id = other._id;
     type = other.type;
+    _hasCutout = other._hasCutout;
+    _hasPartialAlpha = other._hasPartialAlpha;
+    _bytes = other._bytes;
 
     other._id = 0;
 }
@@ -58,6 +101,9 @@ Texture &Texture::operator=(Texture &&other) noexcept
 
     _id = other._id;
     type = other.type;
+    _hasCutout = other._hasCutout;
+    _hasPartialAlpha = other._hasPartialAlpha;
+    _bytes = other._bytes;
 
     other._id = 0;
     return *this;
@@ -65,11 +111,42 @@ Texture &Texture::operator=(Texture &&other) noexcept
 
 Texture::~Texture()
 {
+    // Deleting unbinds it, and its name may come back for another texture
+    for (GLuint &bound : boundMaps)
+        if (bound == _id)
+            bound = 0;
+
+    ResourceTracker::release(RESOURCE_GL_TEXTURE, _id);
     glDeleteTextures(1, &_id);
 }
 
 void Texture::use(int index) const
 {
+    bind(index, _id);
+}
+
+void Texture::bind(int index, GLuint id)
+{
+    bool isMap = index >= TextureUnit::DIFFUSE_MAP_UNIT && index <= TextureUnit::EMISSION_MAP_UNIT;
+    if (isMap && boundMaps[index] == id)
+        return;
+    if (isMap)
+        boundMaps[index] = id;
+
     glActiveTexture(GL_TEXTURE0 + index);
-    glBindTexture(GL_TEXTURE_2D, _id);
-}
\ No newline at end of file
+    glBindTexture(GL_TEXTURE_2D, id);
+    // Target creation binds to whatever unit is active, which must not be a map unit the cache remembers
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Texture::resetBindings()
+{
+    for (GLuint &bound : boundMaps)
+        bound = 0;
+}
+
+bool Texture::hasCutout() const { return _hasCutout; }
+
+bool Texture::hasPartialAlpha() const { return _hasPartialAlpha; }
+
+uint64_t Texture::getBytes() const { return _bytes; }
\ No newline at end of file
@@ -19,6 +19,16 @@ glm::mat4 Transform::getMatrix() const
     return matrix;
 }
 
+Transform Transform::interpolate(const Transform &from, const Transform &to, float t)
+{
+    Transform result = to;
+    result.position = glm::mix(from.position, to.position, t);
+    result.rotation = glm::slerp(from.rotation, to.rotation, t);
+    result.scale = glm::mix(from.scale, to.scale, t);
+
+    return result;
+}
+
 glm::vec3 Transform::forward() const
 {
     return rotation * glm::vec3(0.0f, 0.0f, 1.0f);
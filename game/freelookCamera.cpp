@@ -15,13 +15,10 @@ void FreelookCamera::onNotification(Notification type)
     case Notification::UPDATE:
         update();
         break;
-
-    case Notification::MOUSE_MOVE:
-        mouseInput();
-        break;
-
-    case Notification::KEY_INPUT:
-        keyInput();
+    case Notification::LATE_UPDATE:
+        // Only the view follows the late input, moving stays in step with the rest of the frame
+        if (!_isPaused)
+            mouseInput(getGame().getInput().getLatchedMouseDelta());
         break;
     }
 }
@@ -31,37 +28,60 @@ void FreelookCamera::onStart()
     Game &game = getGame();
     game.setCursorMode(GLFW_CURSOR_DISABLED);
 
+    InputSystem &input = game.getInput();
+    input.bind(CameraAction::MOVE_FORWARD, GLFW_KEY_W);
+    input.bind(CameraAction::MOVE_BACKWARD, GLFW_KEY_S);
+    input.bind(CameraAction::MOVE_LEFT, GLFW_KEY_A);
+    input.bind(CameraAction::MOVE_RIGHT, GLFW_KEY_D);
+    input.bind(CameraAction::MOVE_UP, GLFW_KEY_SPACE);
+    input.bind(CameraAction::MOVE_DOWN, GLFW_KEY_LEFT_CONTROL);
+    input.bind(CameraAction::BOOST, GLFW_KEY_LEFT_SHIFT);
+    input.bind(CameraAction::PAUSE, GLFW_KEY_ESCAPE);
+
     updateRotation();
 }
 
 void FreelookCamera::update()
 {
-    float deltaTime = getGame().getDeltaTime();
+    Game &game = getGame();
+    const InputSystem &input = game.getInput();
+    float deltaTime = game.getDeltaTime();
+
+    if (input.getAction(CameraAction::PAUSE).released)
+    {
+        _isPaused = !_isPaused;
+        if (_isPaused)
+            game.setCursorMode(GLFW_CURSOR_NORMAL);
+        else
+            game.setCursorMode(GLFW_CURSOR_DISABLED);
+    }
 
     if (_isPaused)
         return;
 
+    mouseInput(input.getMouseDelta());
+
     const float moveSpeed = 5.0f;
     const float boostMultiplier = 2.0f;
 
     glm::vec3 moveDirection = glm::vec3(0.0f);
-    if (_input.forward)
+    if (input.getAction(CameraAction::MOVE_FORWARD).down)
         moveDirection.z -= 1.0f;
-    if (_input.backward)
+    if (input.getAction(CameraAction::MOVE_BACKWARD).down)
         moveDirection.z += 1.0f;
-    if (_input.right)
+    if (input.getAction(CameraAction::MOVE_RIGHT).down)
         moveDirection.x += 1.0f;
-    if (_input.left)
+    if (input.getAction(CameraAction::MOVE_LEFT).down)
         moveDirection.x -= 1.0f;
 
     glm::vec3 movement = transform.rotation * moveDirection;
-    if (_input.up)
+    if (input.getAction(CameraAction::MOVE_UP).down)
         movement.y += 1.0f;
-    if (_input.down)
+    if (input.getAction(CameraAction::MOVE_DOWN).down)
         movement.y -= 1.0f;
 
     float finalSpeed = moveSpeed;
-    if (_input.boost)
+    if (input.getAction(CameraAction::BOOST).down)
         finalSpeed *= boostMultiplier;
 
     movement *= finalSpeed;
@@ -69,20 +89,16 @@ void FreelookCamera::update()
     transform.position += movement * deltaTime;
 }
 
-void FreelookCamera::mouseInput()
+void FreelookCamera::mouseInput(const glm::vec2 &delta)
 {
-    const MouseMove &mouseMove = getGame().getMouseMove();
-    if (_isPaused)
-        return;
-
     float sensitivity = 0.01f;
 
     glm::vec3 right = transform.right();
 
-    _lookRotation.x += mouseMove.delta.x * sensitivity;
+    _lookRotation.x += delta.x * sensitivity;
     _lookRotation.x = glm::mod(_lookRotation.x, glm::radians(360.0f));
 
-    _lookRotation.y += mouseMove.delta.y * sensitivity;
+    _lookRotation.y += delta.y * sensitivity;
     _lookRotation.y = glm::clamp(_lookRotation.y, glm::radians(-89.0f), glm::radians(89.0f));
 
     updateRotation();
@@ -100,57 +116,3 @@ void FreelookCamera::updateRotation()
 
     transform.rotation = rotation;
 }
-
-inline void handleKey(bool &result, int action);
-void FreelookCamera::keyInput()
-{
-    Game &game = getGame();
-    const KeyInput &keyInput = game.getKeyInput();
-
-    int action = keyInput.action;
-
-    switch (keyInput.key)
-    {
-    case GLFW_KEY_W:
-        handleKey(_input.forward, action);
-        break;
-    case GLFW_KEY_S:
-        handleKey(_input.backward, action);
-        break;
-    case GLFW_KEY_A:
-        handleKey(_input.left, action);
-        break;
-    case GLFW_KEY_D:
-        handleKey(_input.right, action);
-        break;
-    case GLFW_KEY_SPACE:
-        handleKey(_input.up, action);
-        break;
-    case GLFW_KEY_LEFT_CONTROL:
-        handleKey(_input.down, action);
-        break;
-    case GLFW_KEY_LEFT_SHIFT:
-        handleKey(_input.boost, action);
-        break;
-
-    case GLFW_KEY_ESCAPE:
-        if (action == GLFW_RELEASE)
-        {
-            _isPaused = !_isPaused;
-            if (_isPaused)
-                game.setCursorMode(GLFW_CURSOR_NORMAL);
-            else
-                game.setCursorMode(GLFW_CURSOR_DISABLED);
-        }
-        break;
-    }
-}
-
-inline void handleKey(bool &result, int action)
-{
-    if (action == GLFW_PRESS)
-        result = true;
-
-    if (action == GLFW_RELEASE)
-        result = false;
-}
\ No newline at end of file
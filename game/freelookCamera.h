@@ -2,15 +2,17 @@
 
 #include <engine/camera.h>
 
-struct Input
+// Input actions bound by the camera
+enum CameraAction
 {
-    bool forward = false;
-    bool backward = false;
-    bool up = false;
-    bool down = false;
-    bool left = false;
-    bool right = false;
-    bool boost = false;
+    MOVE_FORWARD,
+    MOVE_BACKWARD,
+    MOVE_LEFT,
+    MOVE_RIGHT,
+    MOVE_UP,
+    MOVE_DOWN,
+    BOOST,
+    PAUSE,
 };
 
 class FreelookCamera : public Camera
@@ -21,12 +23,9 @@ private:
     bool _isPaused = false;
     glm::vec2 _lookRotation = glm::vec3(0.0f);
 
-    Input _input;
-
     void updateRotation();
 
     void onStart();
     void update();
-    void mouseInput();
-    void keyInput();
+    void mouseInput(const glm::vec2 &delta);
 };
\ No newline at end of file
@@ -2,8 +2,17 @@
 #include <engine/mesh.h>
 #include <engine/light.h>
 #include <engine/material.h>
-
-#include <cassert>
+#include <engine/materialRegistry.h>
+#include <engine/aabbTree.h>
+#include <engine/hashGrid.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
 
 #include "data/primitives.hpp"
 #include "data/materials.hpp"
@@ -13,14 +22,21 @@ class Cube : public Object
 {
 public:
     std::shared_ptr<Mesh> mesh;
-    std::shared_ptr<Material> material;
+    MaterialHandle material = 0;
     std::shared_ptr<Shader> shader;
-    std::shared_ptr<Shader> singleColorShader;
+    bool outlined = false;
+    bool isStatic = false;
+    bool isOccluder = false;
+
+    Cube() { runConcurrently(Notification::UPDATE); }
 
     void onNotification(Notification type) override
     {
         switch (type)
         {
+        case Notification::START:
+            setBounds(mesh->getBounds().transformed(getMeshMatrix()));
+            break;
         case Notification::UPDATE:
             update();
             break;
@@ -30,63 +46,42 @@ public:
         }
     }
 
-private:
-    void update()
+    float raycast(const Ray &ray, float maxDistance) const override
     {
-
-        // transform.rotation *= glm::angleAxis(deltaTime, glm::vec3(0.5f, 1.0f, 0.2f));
-        transform.rotation = glm::normalize(transform.rotation);
+        float distance;
+        return mesh->raycast(ray, transform.getMatrix() * getMeshMatrix(), maxDistance, distance) ? distance : -1.0f;
     }
 
-    void setupShader(Shader &currentShader, const glm::mat4 &modelMatrix) const
+private:
+    // Outlined cubes are drawn at their size, the others slightly bigger
+    glm::mat4 getMeshMatrix() const
     {
-        Game &game = getGame();
-        assert(game.activeCamera != nullptr);
-
-        currentShader.use();
-
-        game.activeCamera->setUniforms(currentShader);
-
-        Light::resetCounters();
-        for (Light *light : game.lights)
-            light->setUniforms(currentShader);
+        return outlined ? glm::mat4(1.0f) : glm::scale(glm::mat4(1.0f), glm::vec3(1.2f));
+    }
 
-        currentShader.setUniform("model", modelMatrix);
-        currentShader.setUniform("normalMatrix", glm::transpose(glm::inverse(modelMatrix)));
+    void update()
+    {
 
-        material->setUniforms(currentShader);
+        // transform.rotation *= glm::angleAxis(deltaTime, glm::vec3(0.5f, 1.0f, 0.2f));
+        transform.rotation = glm::normalize(transform.rotation);
     }
 
     void draw() const
     {
-        if (singleColorShader)
-        {
-            glStencilFunc(GL_ALWAYS, 1, 0xFF);
-            glStencilMask(0xFF);
-
-            setupShader(*shader, transform.getMatrix());
-
-            mesh->draw(*shader);
-
-            glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-            glStencilMask(0x00);
-            glDisable(GL_DEPTH_TEST);
-
-            setupShader(*singleColorShader, glm::scale(transform.getMatrix(), glm::vec3(1.2f)));
+        Game &game = getGame();
 
-            mesh->draw(*singleColorShader);
+        DrawCommand command = {
+            .mesh = mesh.get(),
+            .shader = shader.get(),
+            .material = material,
+            .isStatic = isStatic,
+            .isOccluder = isOccluder,
+        };
 
-            glStencilMask(0xFF);
-            glStencilFunc(GL_ALWAYS, 1, 0xFF);
-            glEnable(GL_DEPTH_TEST);
-        }
-        else
-        {
-            setupShader(*shader, glm::scale(transform.getMatrix(), glm::vec3(1.2f)));
-            mesh->draw(*shader);
-        }
+        command.model = transform.getMatrix() * getMeshMatrix();
+        command.outlined = outlined;
 
-        glStencilMask(0x00);
+        game.getRenderer().submit(command);
     }
 };
 
@@ -94,13 +89,19 @@ class ModelRenderer : public Object
 {
 public:
     std::shared_ptr<Model> model;
-    std::shared_ptr<Material> material;
+    MaterialHandle material = 0;
     std::shared_ptr<Shader> shader;
+    bool isStatic = false;
+
+    ModelRenderer() { runConcurrently(Notification::UPDATE); }
 
     void onNotification(Notification type) override
     {
         switch (type)
         {
+        case Notification::START:
+            onStart();
+            break;
         case Notification::UPDATE:
             update();
             break;
@@ -110,7 +111,36 @@ public:
         }
     }
 
+    float raycast(const Ray &ray, float maxDistance) const override
+    {
+        const glm::mat4 &modelMatrix = transform.getMatrix();
+        float closest = -1.0f;
+        for (const std::unique_ptr<Mesh> &mesh : model->getMeshes())
+        {
+            float distance;
+            if (mesh->raycast(ray, modelMatrix, maxDistance, distance))
+            {
+                closest = distance;
+                maxDistance = distance;
+            }
+        }
+
+        return closest;
+    }
+
 private:
+    void onStart()
+    {
+        const std::vector<std::unique_ptr<Mesh>> &meshes = model->getMeshes();
+        if (meshes.empty())
+            return;
+
+        AABB bounds = meshes[0]->getBounds();
+        for (const std::unique_ptr<Mesh> &mesh : meshes)
+            bounds = bounds.merged(mesh->getBounds());
+        setBounds(bounds);
+    }
+
     void update()
     {
         // transform.rotation *= glm::angleAxis(deltaTime, glm::vec3(0.5f, 1.0f, 0.2f));
@@ -120,23 +150,17 @@ private:
     void draw() const
     {
         Game &game = getGame();
-        assert(game.activeCamera != nullptr);
-
-        shader->use();
-
-        game.activeCamera->setUniforms(*shader);
-
-        Light::resetCounters();
-        for (Light *light : game.lights)
-            light->setUniforms(*shader);
-
         const glm::mat4 &modelMatrix = transform.getMatrix();
-        shader->setUniform("model", modelMatrix);
-        shader->setUniform("normalMatrix", glm::transpose(glm::inverse(modelMatrix)));
-
-        material->setUniforms(*shader);
 
-        model->draw(*shader);
+        for (const std::unique_ptr<Mesh> &mesh : model->getMeshes())
+            game.getRenderer().submit({
+                .mesh = mesh.get(),
+                .shader = shader.get(),
+                .material = material,
+                .model = modelMatrix,
+                .isStatic = isStatic,
+                .owner = this,
+            });
     }
 };
 
@@ -144,10 +168,12 @@ class MyLight : public PointLight
 {
 public:
     std::shared_ptr<Mesh> mesh;
-    std::shared_ptr<Material> material;
+    MaterialHandle material = 0;
     std::shared_ptr<Shader> shader;
     glm::vec3 initialPosition;
 
+    MyLight() { runConcurrently(Notification::UPDATE); }
+
     void onNotification(Notification type) override
     {
         PointLight::onNotification(type);
@@ -185,7 +211,9 @@ private:
 
         // diffuse = lightColor * glm::vec3(0.5f);
         // ambient = diffuse * glm::vec3(0.2f);
-        // material->emission = lightColor;
+        // Material emissive = game.getMaterials().get(material);
+        // emissive.emission = lightColor;
+        // game.getMaterials().update(material, emissive);
 
         // transform.position = initialPosition + glm::vec3(glm::cos(time), glm::sin(time), 0.0f) * 2.0f;
         transform.rotation = glm::angleAxis(deltaTime, glm::vec3(0.0f, 1.0f, 0.0f)) * transform.rotation;
@@ -195,39 +223,366 @@ private:
     void draw() const
     {
         Game &game = getGame();
-        assert(game.activeCamera != nullptr);
-
-        shader->use();
-
-        game.activeCamera->setUniforms(*shader);
-        setUniforms(*shader);
-
-        const glm::mat4 &modelMatrix = transform.getMatrix();
-        shader->setUniform("model", modelMatrix);
-        shader->setUniform("normalMatrix", glm::transpose(glm::inverse(modelMatrix)));
 
-        material->setUniforms(*shader);
-
-        mesh->draw(*shader);
+        DrawCommand command = {
+            .mesh = mesh.get(),
+            .shader = shader.get(),
+            .material = material,
+            .model = transform.getMatrix(),
+            // The light sits inside its own shadow maps
+            .castsShadows = false,
+        };
+        game.getRenderer().submit(command);
 
         Transform arrowHead = transform;
         arrowHead.position += arrowHead.forward() * 0.3f;
         arrowHead.scale.x *= 0.5;
         arrowHead.scale.y *= 0.5;
-        const glm::mat4 &arrowHeadMatrix = arrowHead.getMatrix();
-        shader->setUniform("model", arrowHeadMatrix);
-        shader->setUniform("normalMatrix", glm::transpose(glm::inverse(arrowHeadMatrix)));
+        command.model = arrowHead.getMatrix();
+        game.getRenderer().submit(command);
+    }
+};
+
+// Update only, stands in for simulated objects when measuring the update phase
+class Spinner : public Object
+{
+public:
+    glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    Spinner() { runConcurrently(Notification::UPDATE); }
 
-        mesh->draw(*shader);
+    void onNotification(Notification type) override
+    {
+        if (type != Notification::UPDATE)
+            return;
+
+        transform.rotation = glm::normalize(glm::angleAxis(getGame().getDeltaTime(), axis) * transform.rotation);
+        transform.position += transform.forward() * getGame().getDeltaTime();
+    }
+};
+
+// Short lived update only object, despawns itself when its time is up
+class Particle : public Object
+{
+public:
+    glm::vec3 velocity = glm::vec3(0.0f);
+    float lifetime = 1.0f;
+
+    Particle() { runConcurrently(Notification::UPDATE); }
+
+    void onNotification(Notification type) override
+    {
+        if (type != Notification::UPDATE)
+            return;
+
+        float deltaTime = getGame().getDeltaTime();
+        velocity.y -= 9.81f * deltaTime;
+        transform.position += velocity * deltaTime;
+
+        lifetime -= deltaTime;
+        if (lifetime <= 0.0f)
+            getGame().despawn(getHandle());
+    }
+};
+
+// Spawns a fixed number of particles every frame, stands in for gameplay that keeps creating and destroying objects
+class ParticleEmitter : public Object
+{
+public:
+    int rate = 0;
+
+    void onNotification(Notification type) override
+    {
+        if (type != Notification::UPDATE)
+            return;
+
+        for (int i = 0; i < rate; i++)
+        {
+            float angle = (float)(_spawned++ % 360) * glm::pi<float>() / 180.0f;
+            getGame().spawn<Particle>([&](Particle &particle)
+                                      {
+                particle.objectName = "Particle";
+                particle.transform.position = transform.position;
+                particle.velocity = glm::vec3(std::cos(angle), 4.0f, std::sin(angle));
+                particle.lifetime = 1.0f + (float)(i % 8) * 0.125f; });
+        }
     }
+
+private:
+    unsigned int _spawned = 0;
 };
 
-int main()
+// Times the index over count random boxes of about a unit spread at one per 8 cubic units, without a window
+static void benchmarkSpatialIndex(SpatialIndex &index, const char *name, int count)
+{
+    using Clock = std::chrono::steady_clock;
+    auto milliseconds = [](Clock::time_point start)
+    { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+    const int RAYS = 10000;
+    const int QUERIES = 1000;
+    const int FRUSTUMS = 100;
+
+    std::mt19937 random(1234);
+    float side = std::cbrt((float)count) * 2.0f;
+    std::uniform_real_distribution<float> position(-side * 0.5f, side * 0.5f);
+    std::uniform_real_distribution<float> extent(0.125f, 0.5f);
+    std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto randomPoint = [&]
+    { return glm::vec3(position(random), position(random), position(random)); };
+    auto randomDirection = [&]
+    { return glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 1e-3f)); };
+
+    std::vector<AABB> boxes(count);
+    for (AABB &box : boxes)
+    {
+        glm::vec3 center = randomPoint();
+        glm::vec3 extents(extent(random), extent(random), extent(random));
+        box = {center - extents, center + extents};
+    }
+
+    std::vector<int> proxies(count);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < count; i++)
+        proxies[i] = index.insert(boxes[i], nullptr);
+    double insertTime = milliseconds(start);
+
+    start = Clock::now();
+    index.rebuild();
+    double buildTime = milliseconds(start);
+
+    // As the game adds objects spawned in the same frame
+    std::vector<void *> userData(count, nullptr);
+    index.clear();
+    start = Clock::now();
+    index.insert(count, boxes.data(), userData.data(), proxies.data());
+    double bulkInsertTime = milliseconds(start);
+
+    // Every box moves a little, as when the game follows its objects after a frame
+    for (AABB &box : boxes)
+    {
+        glm::vec3 offset(step(random), step(random), step(random));
+        box = {box.min + offset, box.max + offset};
+    }
+    start = Clock::now();
+    for (int i = 0; i < count; i++)
+        index.update(proxies[i], boxes[i]);
+    double refitTime = milliseconds(start);
+
+    std::vector<Ray> rays(RAYS);
+    for (Ray &ray : rays)
+        ray = {randomPoint(), randomDirection()};
+
+    int hits = 0;
+    start = Clock::now();
+    for (const Ray &ray : rays)
+        hits += index.raycast(ray, side).proxy >= 0;
+    double rayTime = milliseconds(start);
+
+    std::vector<RayHit> rayHits(RAYS);
+    start = Clock::now();
+    index.raycast(rays.data(), RAYS, side, rayHits.data());
+    double batchTime = milliseconds(start);
+
+    std::vector<int> found;
+    size_t sphereResults = 0;
+    start = Clock::now();
+    for (int i = 0; i < QUERIES; i++)
+    {
+        index.querySphere(randomPoint(), 4.0f, found);
+        sphereResults += found.size();
+    }
+    double sphereTime = milliseconds(start);
+
+    start = Clock::now();
+    for (int i = 0; i < QUERIES; i++)
+        index.findNearest(randomPoint(), 8, found);
+    double nearestTime = milliseconds(start);
+
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    size_t frustumResults = 0;
+    start = Clock::now();
+    for (int i = 0; i < FRUSTUMS; i++)
+    {
+        glm::vec3 eye = randomPoint();
+        index.queryFrustum(Frustum(projection * glm::lookAt(eye, eye + randomDirection(), glm::vec3(0.0f, 1.0f, 0.0f))), found);
+        frustumResults += found.size();
+    }
+    double frustumTime = milliseconds(start);
+
+    std::cout << name << ", " << count << " boxes" << std::endl
+              << "  insert " << insertTime << " ms, build " << buildTime << " ms, bulk insert " << bulkInsertTime
+              << " ms, refit after moving all "
+              << refitTime << " ms" << std::endl
+              << "  ray " << rayTime * 1000.0 / RAYS << " us (" << hits << " hits), batched "
+              << batchTime * 1000.0 / RAYS << " us per ray" << std::endl
+              << "  sphere " << sphereTime * 1000.0 / QUERIES << " us (" << sphereResults / QUERIES << " found), 8 nearest "
+              << nearestTime * 1000.0 / QUERIES << " us, frustum " << frustumTime / FRUSTUMS << " ms ("
+              << frustumResults / FRUSTUMS << " found)" << std::endl;
+}
+
+int main(int argc, char **argv)
 {
-    Game game;
+    // --deferred selects the deferred renderer, --depth-prepass enables the depth pre-pass,
+    // --oit uses weighted blended transparency, --occlusion enables occlusion culling of models,
+    // --software-occlusion culls against the ground on the CPU, --gpu-culling culls and batches opaque draws on the GPU,
+    // --point-lights N adds N extra point lights to stress lighting, --stress-objects N adds N update only objects,
+    // --threads N sizes the job system, --render-thread renders on its own thread,
+    // --render-latency N lets the simulation run N frames ahead of it (1 double, 2 triple buffering),
+    // --check-allocations reports frames that still allocate from the heap, --particles N spawns N short lived
+    // objects every frame, --no-raw-mouse keeps accelerated mouse motion, --measure-latency shows motion to photon time,
+    // --vsync off|on|adaptive sets the swap interval, --frame-limit N caps the frame rate, --raw-delta-time turns
+    // off delta time smoothing, --low-latency waits for the GPU before polling input, --late-latch updates the
+    // camera view with input polled right before rendering, --fixed-update N updates N times per second,
+    // --max-fixed-updates N caps the updates run by one frame, --no-interpolation renders the last update as is,
+    // --spatial-grid indexes objects in a hash grid instead of a tree, --spatial-benchmark N times both over N
+    // boxes and exits, --gpu-picking selects objects from a pick pass read back asynchronously, --sync-picking
+    // reads it back right away, --headless never shows the window, --capture png|y4m records every frame,
+    // --capture-path P sets where, --capture-frames N quits after N captured frames, --capture-every-frame waits
+    // for the encoders instead of dropping frames, --hide-imgui starts with ImGui hidden (F1 toggles it),
+    // --imgui-rate N rebuilds ImGui N times per second, --gpu-budget MB and --system-budget MB warn when tracked
+    // resources go past them, --dump-resources P writes them per owner to P as JSON on exit, --metrics ADDRESS serves
+    // metrics on unix:PATH, HOST:PORT or PORT, --metrics-log P appends them to P (CSV when it ends with .csv),
+    // --metrics-interval N every N frames, --dynamic-resolution MS scales the scene to keep its GPU time under MS
+    // milliseconds, --min-scale S and --max-scale S bound the scale, --sharpen S sharpens the upscale (0 to 1),
+    // --aa off|msaa|fxaa selects the anti-aliasing, --msaa-samples N the samples per pixel of MSAA
+    GameSettings settings;
+    int extraPointLights = 0;
+    int stressObjects = 0;
+    int particleRate = 0;
+    int spatialBenchmark = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--deferred") == 0)
+            settings.renderPath = RenderPath::DEFERRED;
+        else if (std::strcmp(argv[i], "--depth-prepass") == 0)
+            settings.depthPrePass = true;
+        else if (std::strcmp(argv[i], "--oit") == 0)
+            settings.transparencyMode = TransparencyMode::WEIGHTED_BLENDED;
+        else if (std::strcmp(argv[i], "--occlusion") == 0)
+            settings.occlusionCulling = true;
+        else if (std::strcmp(argv[i], "--software-occlusion") == 0)
+            settings.softwareOcclusion = true;
+        else if (std::strcmp(argv[i], "--gpu-culling") == 0)
+            settings.gpuCulling = true;
+        else if (std::strcmp(argv[i], "--point-lights") == 0 && i + 1 < argc)
+            extraPointLights = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--stress-objects") == 0 && i + 1 < argc)
+            stressObjects = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            settings.threadCount = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--render-thread") == 0)
+            settings.renderThread = true;
+        else if (std::strcmp(argv[i], "--render-latency") == 0 && i + 1 < argc)
+            settings.renderLatency = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--check-allocations") == 0)
+            settings.checkAllocations = true;
+        else if (std::strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+            particleRate = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-raw-mouse") == 0)
+            settings.rawMouseMotion = false;
+        else if (std::strcmp(argv[i], "--measure-latency") == 0)
+            settings.measureInputLatency = true;
+        else if (std::strcmp(argv[i], "--vsync") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (std::strcmp(argv[i], "off") == 0)
+                settings.vsyncMode = VsyncMode::VSYNC_OFF;
+            else if (std::strcmp(argv[i], "adaptive") == 0)
+                settings.vsyncMode = VsyncMode::VSYNC_ADAPTIVE;
+            else
+                settings.vsyncMode = VsyncMode::VSYNC_ON;
+        }
+        else if (std::strcmp(argv[i], "--frame-limit") == 0 && i + 1 < argc)
+            settings.frameLimit = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--raw-delta-time") == 0)
+            settings.smoothDeltaTime = false;
+        else if (std::strcmp(argv[i], "--low-latency") == 0)
+            settings.lowLatency = true;
+        else if (std::strcmp(argv[i], "--late-latch") == 0)
+            settings.lateLatch = true;
+        else if (std::strcmp(argv[i], "--fixed-update") == 0 && i + 1 < argc)
+            settings.fixedUpdateRate = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--max-fixed-updates") == 0 && i + 1 < argc)
+            settings.maxFixedUpdates = std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--no-interpolation") == 0)
+            settings.interpolateTransforms = false;
+        else if (std::strcmp(argv[i], "--spatial-grid") == 0)
+            settings.spatialIndex = SpatialIndexType::HASH_GRID;
+        else if (std::strcmp(argv[i], "--spatial-benchmark") == 0 && i + 1 < argc)
+            spatialBenchmark = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--gpu-picking") == 0)
+            settings.gpuPicking = true;
+        else if (std::strcmp(argv[i], "--sync-picking") == 0)
+            settings.syncPicking = true;
+        else if (std::strcmp(argv[i], "--headless") == 0)
+            settings.headless = true;
+        else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            settings.capture = true;
+            settings.captureFormat = std::strcmp(argv[++i], "y4m") == 0 ? CaptureFormat::CAPTURE_Y4M : CaptureFormat::CAPTURE_PNG;
+        }
+        else if (std::strcmp(argv[i], "--capture-path") == 0 && i + 1 < argc)
+            settings.capturePath = argv[++i];
+        else if (std::strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+            settings.captureFrames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--capture-every-frame") == 0)
+            settings.captureEveryFrame = true;
+        else if (std::strcmp(argv[i], "--hide-imgui") == 0)
+            settings.showImGui = false;
+        else if (std::strcmp(argv[i], "--imgui-rate") == 0 && i + 1 < argc)
+            settings.imguiRate = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+            settings.gpuMemoryBudget = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--system-budget") == 0 && i + 1 < argc)
+            settings.systemMemoryBudget = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--dump-resources") == 0 && i + 1 < argc)
+            settings.resourceDumpPath = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+            settings.metricsAddress = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics-log") == 0 && i + 1 < argc)
+            settings.metricsLogPath = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc)
+            settings.metricsLogInterval = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc)
+        {
+            settings.dynamicResolution = true;
+            settings.resolutionTarget = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--min-scale") == 0 && i + 1 < argc)
+            settings.minResolutionScale = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--max-scale") == 0 && i + 1 < argc)
+            settings.maxResolutionScale = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--sharpen") == 0 && i + 1 < argc)
+            settings.upscaleSharpness = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--aa") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (std::strcmp(argv[i], "msaa") == 0)
+                settings.antiAliasing = AntiAliasingMode::AA_MSAA;
+            else if (std::strcmp(argv[i], "fxaa") == 0)
+                settings.antiAliasing = AntiAliasingMode::AA_FXAA;
+            else
+                settings.antiAliasing = AntiAliasingMode::AA_OFF;
+        }
+        else if (std::strcmp(argv[i], "--msaa-samples") == 0 && i + 1 < argc)
+            settings.msaaSamples = std::atoi(argv[++i]);
+    }
+
+    if (spatialBenchmark > 0)
+    {
+        AabbTree tree;
+        benchmarkSpatialIndex(tree, "AABB tree", spatialBenchmark);
+        // About as many buckets as boxes
+        HashGrid grid(2.0f, spatialBenchmark);
+        benchmarkSpatialIndex(grid, "Hash grid", spatialBenchmark);
+        return 0;
+    }
+
+    Game game(settings);
     {
         std::shared_ptr<Shader> shader = std::make_shared<Shader>("./shaders/vertex.vs", "./shaders/fragment.fs");
-        std::shared_ptr<Shader> singleColorShader = std::make_shared<Shader>("./shaders/vertex.vs", "./shaders/singleColor.fs");
         std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>(cubeVertices, cubeIndices);
         std::shared_ptr<Mesh> planeMesh = std::make_shared<Mesh>(planeVertices, planeIndices);
         std::shared_ptr<Mesh> grassMesh = std::make_shared<Mesh>(grassVertices, grassIndices);
@@ -254,7 +609,7 @@ int main()
 
         // Plane
         std::unique_ptr<Cube> plane = std::make_unique<Cube>();
-        plane->material = std::make_shared<Material>(
+        plane->material = game.getMaterials().intern(
             Material{
                 .specular = glm::vec3(0.2f),
                 .shininess = 0.2f,
@@ -264,11 +619,13 @@ int main()
         plane->shader = shader;
         plane->transform.position = glm::vec3(0.0f, -0.25f, 0.0f);
         plane->transform.scale = glm::vec3(50.0f);
+        plane->isStatic = true;
+        plane->isOccluder = true;
         game.addObject(std::move(plane));
 
         {
             std::unique_ptr<ModelRenderer> suzanne = std::make_unique<ModelRenderer>();
-            suzanne->material = std::make_shared<Material>(
+            suzanne->material = game.getMaterials().intern(
                 Material{
                     .shininess = 1.0f,
                 });
@@ -278,12 +635,13 @@ int main()
             suzanne->transform.position = glm::vec3(-1.0f, 0.25f, 0.0f);
             suzanne->transform.rotation = glm::quat(glm::vec3(-glm::pi<float>() / 2.0f, 0.0f, 0.0f));
             suzanne->transform.scale = glm::vec3(0.02f);
+            suzanne->isStatic = true;
             game.addObject(std::move(suzanne));
         }
 
         {
             std::unique_ptr<Cube> box = std::make_unique<Cube>();
-            box->material = std::make_shared<Material>(
+            box->material = game.getMaterials().intern(
                 Material{
                     .specular = glm::vec3(1.0f),
                     .shininess = 1.0f,
@@ -293,17 +651,18 @@ int main()
 
             box->mesh = cubeMesh;
             box->shader = shader;
-            box->singleColorShader = singleColorShader;
+            box->outlined = true;
             box->transform.position = glm::vec3(-3.0f, 0.25f, 0.0f);
             box->transform.rotation = glm::quat(glm::vec3(-glm::pi<float>() / 2.0f, 0.0f, 0.0f));
             box->transform.scale = glm::vec3(0.25);
+            box->isStatic = true;
             game.addObject(std::move(box));
         }
 
         {
             std::unique_ptr<Cube> window = std::make_unique<Cube>();
             window->objectName = "Window";
-            window->material = std::make_shared<Material>(
+            window->material = game.getMaterials().intern(
                 Material{
                     .specular = glm::vec3(1.0f),
                     .shininess = 1.0f,
@@ -315,12 +674,13 @@ int main()
             window->transform.position = glm::vec3(-5.0f, 0.5f, 2.0f);
             window->transform.scale = glm::vec3(0.5f);
             window->transform.rotation = glm::quat(glm::radians(glm::vec3(45.0f, -45.0f, 0.0f)));
+            window->isStatic = true;
             game.addObject(std::move(window));
         }
 
         {
             std::unique_ptr<Cube> grass = std::make_unique<Cube>();
-            grass->material = std::make_shared<Material>(
+            grass->material = game.getMaterials().intern(
                 Material{
                     .specular = glm::vec3(1.0f),
                     .shininess = 1.0f,
@@ -331,6 +691,7 @@ int main()
             grass->shader = shader;
             grass->transform.position = glm::vec3(-5.0f, 0.5f, 0.0f);
             grass->transform.scale = glm::vec3(0.5f);
+            grass->isStatic = true;
             game.addObject(std::move(grass));
         }
 
@@ -344,12 +705,13 @@ int main()
             int y = i / 4;
 
             cube->transform.rotation = glm::quat(glm::vec3(-glm::pi<float>() / 2.0f, 0.0f, 0.0f));
-            cube->material = std::make_shared<Material>(material);
+            cube->material = game.getMaterials().intern(material);
             cube->objectName = material.name;
             cube->model = shibaModel;
             cube->shader = shader;
             cube->transform.scale = glm::vec3(0.25f);
             cube->transform.position = glm::vec3((float)x, 0.0f, (float)y);
+            cube->isStatic = true;
 
             game.addObject(std::move(cube));
         }
@@ -367,7 +729,8 @@ int main()
             light->quadratic = 1.0f;
             light->linear = 0.0f;
             light->objectName = "Light";
-            light->material = std::make_shared<Material>(Material{
+            light->castsShadows = true;
+            light->material = game.getMaterials().intern(Material{
                 .emission = glm::vec3(0.2f)});
             light->mesh = cubeMesh;
             light->shader = shader;
@@ -383,6 +746,7 @@ int main()
             light->diffuse = glm::vec3(0.5f);
             light->specular = glm::vec3(0.5f);
             light->objectName = "DirectionalLight";
+            light->castsShadows = true;
 
             game.addObject(std::move(light));
         }
@@ -399,9 +763,41 @@ int main()
             light->cutOff = glm::radians((float)i * 45.0f / 5.0f);
 
             light->objectName = "SpotLight";
+            light->castsShadows = true;
 
             game.addObject(std::move(light));
         }
+
+        // Grid of small point lights over the plane
+        int gridSize = (int)std::ceil(std::sqrt((float)extraPointLights));
+        for (int i = 0; i < extraPointLights; i++)
+        {
+            std::unique_ptr<PointLight> light = std::make_unique<PointLight>();
+            float x = (float)(i % gridSize) / glm::max(gridSize - 1, 1);
+            float z = (float)(i / gridSize) / glm::max(gridSize - 1, 1);
+            light->transform.position = glm::vec3(x * 40.0f - 20.0f, 0.5f, z * 40.0f - 20.0f);
+            light->ambient = glm::vec3(0.0f);
+            light->diffuse = glm::vec3(0.3f);
+            light->specular = glm::vec3(0.3f);
+            light->quadratic = 2.0f;
+            light->linear = 0.0f;
+            light->objectName = "StressLight";
+
+            game.addObject(std::move(light));
+        }
+
+        for (int i = 0; i < stressObjects; i++)
+            game.spawn<Spinner>([i](Spinner &spinner)
+                                {
+                spinner.objectName = "Spinner";
+                spinner.axis = glm::normalize(glm::vec3(std::sin((float)i), 1.0f, std::cos((float)i))); });
+
+        if (particleRate > 0)
+            game.spawn<ParticleEmitter>([particleRate](ParticleEmitter &emitter)
+                                        {
+                emitter.objectName = "ParticleEmitter";
+                emitter.transform.position = glm::vec3(0.0f, 1.0f, 4.0f);
+                emitter.rate = particleRate; });
     }
 
     game.run();
@@ -0,0 +1,66 @@
+#version 330 core
+// One point per instance, captured with transform feedback and the rasterizer off
+out float Visible;
+
+// Must match GpuCulling, model matrix columns then world bounds min (w = material) and max
+#define INSTANCE_TEXELS 6
+uniform samplerBuffer instanceData;
+
+// Normals point inside
+uniform vec4 frustumPlanes[6];
+
+// Farthest depth of last frame, each level halving the one before
+uniform sampler2D depthPyramid;
+uniform bool occlusionTest;
+uniform mat4 viewProjection;
+
+void main()
+{
+    int base = gl_VertexID * INSTANCE_TEXELS;
+    vec3 boundsMin = texelFetch(instanceData, base + 4).xyz;
+    vec3 boundsMax = texelFetch(instanceData, base + 5).xyz;
+
+    // Same test as Frustum::intersects
+    vec3 center = (boundsMin + boundsMax) * 0.5;
+    vec3 extents = (boundsMax - boundsMin) * 0.5;
+    for(int i = 0; i < 6; i++) {
+        vec4 plane = frustumPlanes[i];
+        if(dot(plane.xyz, center) + plane.w < -dot(extents, abs(plane.xyz))) {
+            Visible = 0.0;
+            return;
+        }
+    }
+
+    Visible = 1.0;
+    if(!occlusionTest)
+        return;
+
+    vec3 rectMin = vec3(1.0);
+    vec3 rectMax = vec3(0.0);
+    for(int i = 0; i < 8; i++) {
+        vec3 corner = vec3((i & 1) != 0 ? boundsMax.x : boundsMin.x,
+                           (i & 2) != 0 ? boundsMax.y : boundsMin.y,
+                           (i & 4) != 0 ? boundsMax.z : boundsMin.z);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+
+        // Crosses the near plane, the rectangle is meaningless
+        if(clip.z < -clip.w)
+            return;
+
+        vec3 screen = clip.xyz / clip.w * 0.5 + 0.5;
+        rectMin = min(rectMin, screen);
+        rectMax = max(rectMax, screen);
+    }
+    rectMin.xy = clamp(rectMin.xy, 0.0, 1.0);
+    rectMax.xy = clamp(rectMax.xy, 0.0, 1.0);
+
+    // Level where the rectangle spans at most two texels each way, four samples cover it
+    vec2 size = (rectMax.xy - rectMin.xy) * vec2(textureSize(depthPyramid, 0));
+    int levels = int(log2(float(max(textureSize(depthPyramid, 0).x, textureSize(depthPyramid, 0).y)))) + 1;
+    float level = min(ceil(log2(max(max(size.x, size.y), 1.0))), float(levels - 1));
+
+    float farthest = max(max(textureLod(depthPyramid, rectMin.xy, level).r, textureLod(depthPyramid, vec2(rectMax.x, rectMin.y), level).r),
+                         max(textureLod(depthPyramid, vec2(rectMin.x, rectMax.y), level).r, textureLod(depthPyramid, rectMax.xy, level).r));
+
+    Visible = rectMin.z <= farthest ? 1.0 : 0.0;
+}
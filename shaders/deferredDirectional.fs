@@ -0,0 +1,133 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gEmission;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform mat4 view;
+uniform vec3 viewPos;
+
+struct DirectionalLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    int shadowTile;
+};
+
+#define MAX_DIRECTIONAL_LIGHTS 4
+uniform int directionalLightsCount;
+uniform DirectionalLight directionalLights[MAX_DIRECTIONAL_LIGHTS];
+
+// Pushed along the normal against shadow acne
+vec3 shadowPosition;
+float viewDepth;
+
+// Must match ShadowAtlas
+#define MAX_SHADOW_TILES 64
+#define MAX_CASCADES 4
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[MAX_SHADOW_TILES]; // world to atlas uv and depth
+    vec4 shadowTiles[MAX_SHADOW_TILES];    // xy = min uv, zw = max uv
+    vec4 cascadeSplits;                    // view depth where each cascade ends
+};
+
+uniform sampler2DShadow shadowAtlas;
+
+// 3x3 PCF kept inside the tile, 1 is fully lit
+float SampleShadow(int tile, vec3 position) {
+    vec4 projected = shadowMatrices[tile] * vec4(position, 1.0);
+    vec3 coords = projected.xyz / projected.w;
+    if(coords.z >= 1.0) {
+        return 1.0;
+    }
+
+    vec4 bounds = shadowTiles[tile];
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    float lit = 0.0;
+    for(int y = -1; y <= 1; y++)
+        for(int x = -1; x <= 1; x++)
+            lit += texture(shadowAtlas, vec3(clamp(coords.xy + vec2(x, y) * texel, bounds.xy, bounds.zw), coords.z));
+
+    return lit / 9.0;
+}
+
+// One tile per cascade, past the last one is lit
+float CalcDirectionalShadow(int firstTile, vec3 position, float viewDepth) {
+    for(int i = 0; i < MAX_CASCADES; i++)
+        if(viewDepth < cascadeSplits[i])
+            return SampleShadow(firstTile + i, position);
+
+    return 1.0;
+}
+
+// One tile per cube face, +X -X +Y -Y +Z -Z
+float CalcPointShadow(int firstTile, vec3 lightPosition, vec3 position) {
+    vec3 direction = position - lightPosition;
+    vec3 absolute = abs(direction);
+
+    int face;
+    if(absolute.x >= absolute.y && absolute.x >= absolute.z)
+        face = direction.x >= 0.0 ? 0 : 1;
+    else if(absolute.y >= absolute.z)
+        face = direction.y >= 0.0 ? 2 : 3;
+    else
+        face = direction.z >= 0.0 ? 4 : 5;
+
+    return SampleShadow(firstTile + face, position);
+}
+
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec4 specularFactor);
+
+void main()
+{
+    float depth = texture(gDepth, TexCoord).r;
+    if(depth >= 1.0) {
+        discard;
+    }
+
+    vec4 clipPos = inverseViewProjection * vec4(vec3(TexCoord, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = clipPos.xyz / clipPos.w;
+
+    vec3 albedo = texture(gAlbedo, TexCoord).rgb;
+    vec4 specularFactor = texture(gSpecular, TexCoord);
+    vec3 normal = normalize(texture(gNormal, TexCoord).xyz);
+    vec3 viewDir = normalize(viewPos - fragPos);
+    shadowPosition = fragPos + normal * 0.02;
+    viewDepth = -(view * vec4(fragPos, 1.0)).z;
+
+    vec3 result = texture(gEmission, TexCoord).rgb;
+    for(int i = 0; i < min(directionalLightsCount, MAX_DIRECTIONAL_LIGHTS); i++)
+        result += CalcDirectionalLight(directionalLights[i], normal, viewDir, albedo, specularFactor);
+
+    FragColor = vec4(result, 1.0);
+}
+
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 albedo, vec4 specularFactor) {
+    vec3 lightDir = normalize(-light.direction);
+
+    // ambient shading
+    vec3 ambient = light.ambient * albedo;
+
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * albedo;
+
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), specularFactor.a * 128.0);
+    vec3 specular = light.specular * spec * specularFactor.rgb;
+
+    float shadow = light.shadowTile < 0 ? 1.0 : CalcDirectionalShadow(light.shadowTile, shadowPosition, viewDepth);
+
+    // combine results
+    return (ambient + (diffuse + specular) * shadow);
+}
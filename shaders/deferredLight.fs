@@ -0,0 +1,121 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in vec4 LightPosition;    // w = volume radius
+flat in vec4 LightDirection;   // w = cos(cutOff)
+flat in vec4 LightAmbient;     // w = cos(outerCutOff)
+flat in vec3 LightDiffuse;
+flat in vec3 LightSpecular;
+flat in vec4 LightAttenuation; // w = first shadow tile, negative without shadows
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+uniform vec2 screenSize;
+uniform bool isSpot;
+
+// Must match ShadowAtlas
+#define MAX_SHADOW_TILES 64
+#define MAX_CASCADES 4
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[MAX_SHADOW_TILES]; // world to atlas uv and depth
+    vec4 shadowTiles[MAX_SHADOW_TILES];    // xy = min uv, zw = max uv
+    vec4 cascadeSplits;                    // view depth where each cascade ends
+};
+
+uniform sampler2DShadow shadowAtlas;
+
+// 3x3 PCF kept inside the tile, 1 is fully lit
+float SampleShadow(int tile, vec3 position) {
+    vec4 projected = shadowMatrices[tile] * vec4(position, 1.0);
+    vec3 coords = projected.xyz / projected.w;
+    if(coords.z >= 1.0) {
+        return 1.0;
+    }
+
+    vec4 bounds = shadowTiles[tile];
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    float lit = 0.0;
+    for(int y = -1; y <= 1; y++)
+        for(int x = -1; x <= 1; x++)
+            lit += texture(shadowAtlas, vec3(clamp(coords.xy + vec2(x, y) * texel, bounds.xy, bounds.zw), coords.z));
+
+    return lit / 9.0;
+}
+
+// One tile per cube face, +X -X +Y -Y +Z -Z
+float CalcPointShadow(int firstTile, vec3 lightPosition, vec3 position) {
+    vec3 direction = position - lightPosition;
+    vec3 absolute = abs(direction);
+
+    int face;
+    if(absolute.x >= absolute.y && absolute.x >= absolute.z)
+        face = direction.x >= 0.0 ? 0 : 1;
+    else if(absolute.y >= absolute.z)
+        face = direction.y >= 0.0 ? 2 : 3;
+    else
+        face = direction.z >= 0.0 ? 4 : 5;
+
+    return SampleShadow(firstTile + face, position);
+}
+
+void main()
+{
+    vec2 texCoord = gl_FragCoord.xy / screenSize;
+    float depth = texture(gDepth, texCoord).r;
+
+    vec4 clipPos = inverseViewProjection * vec4(vec3(texCoord, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = clipPos.xyz / clipPos.w;
+
+    float distance = length(LightPosition.xyz - fragPos);
+    if(distance > LightPosition.w) {
+        discard;
+    }
+
+    vec3 lightDir = (LightPosition.xyz - fragPos) / distance;
+
+    float intensity = 1.0;
+    if(isSpot) {
+        float theta = dot(lightDir, normalize(-LightDirection.xyz));
+        if(theta < LightAmbient.w) {
+            discard;
+        }
+
+        float epsilon = LightDirection.w - LightAmbient.w;
+        intensity = clamp((theta - LightAmbient.w) / epsilon, 0.0, 1.0);
+    }
+
+    vec3 albedo = texture(gAlbedo, texCoord).rgb;
+    vec4 specularFactor = texture(gSpecular, texCoord);
+    vec3 normal = normalize(texture(gNormal, texCoord).xyz);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    // attenuation
+    float attenuation = 1.0 / (LightAttenuation.x + LightAttenuation.y * distance +
+                               LightAttenuation.z * (distance * distance));
+
+    // ambient shading
+    vec3 ambient = LightAmbient.rgb * albedo;
+
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = LightDiffuse * diff * albedo;
+
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), specularFactor.a * 128.0);
+    vec3 specular = LightSpecular * spec * specularFactor.rgb;
+
+    float shadow = 1.0;
+    int shadowTile = int(LightAttenuation.w);
+    if(shadowTile >= 0) {
+        vec3 shadowPosition = fragPos + normal * 0.02;
+        shadow = isSpot ? SampleShadow(shadowTile, shadowPosition) : CalcPointShadow(shadowTile, LightPosition.xyz, shadowPosition);
+    }
+
+    FragColor = vec4((ambient + (diffuse + specular) * shadow) * intensity * attenuation, 1.0);
+}
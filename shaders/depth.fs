@@ -0,0 +1,16 @@
+#version 330 core
+
+#ifdef ALPHA_TEST
+in vec2 TexCoord;
+
+uniform sampler2D diffuseMap;
+#endif
+
+void main()
+{
+#ifdef ALPHA_TEST
+    if(texture(diffuseMap, TexCoord).a <= 0.1) {
+        discard;
+    }
+#endif
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+
+#ifdef ALPHA_TEST
+out vec2 TexCoord;
+#endif
+
+// Must match vertex.vs bit for bit so the main pass can test with GL_EQUAL
+invariant gl_Position;
+
+uniform mat4 model;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef ALPHA_TEST
+    TexCoord = aTexCoord;
+#endif
+}
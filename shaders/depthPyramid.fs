@@ -0,0 +1,36 @@
+#version 330 core
+out float Depth;
+
+// Scene depth for the first level, otherwise the pyramid with its base level set to the level below
+uniform sampler2D source;
+uniform bool reduce;
+
+float fetch(ivec2 coords, ivec2 size) {
+    return texelFetch(source, min(coords, size - 1), 0).r;
+}
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    if(!reduce) {
+        Depth = texelFetch(source, coords, 0).r;
+        return;
+    }
+
+    // Farthest of the 2x2 texels below, odd sizes fold their last row and column into the texels before them
+    ivec2 size = textureSize(source, 0);
+    ivec2 base = coords * 2;
+    float depth = max(max(fetch(base, size), fetch(base + ivec2(1, 0), size)),
+                      max(fetch(base + ivec2(0, 1), size), fetch(base + ivec2(1, 1), size)));
+
+    bool lastX = (size.x & 1) != 0 && base.x + 3 == size.x;
+    bool lastY = (size.y & 1) != 0 && base.y + 3 == size.y;
+    if(lastX)
+        depth = max(depth, max(fetch(base + ivec2(2, 0), size), fetch(base + ivec2(2, 1), size)));
+    if(lastY)
+        depth = max(depth, max(fetch(base + ivec2(0, 2), size), fetch(base + ivec2(1, 2), size)));
+    if(lastX && lastY)
+        depth = max(depth, fetch(base + ivec2(2, 2), size));
+
+    Depth = depth;
+}
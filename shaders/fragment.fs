@@ -1,10 +1,16 @@
 #version 330 core
+#ifdef WEIGHTED_BLENDED
+layout (location = 0) out vec4 Accumulation;
+layout (location = 1) out float Weight;
+#else
 out vec4 FragColor;
+#endif
   
 in vec3 ourColor;
 in vec2 TexCoord;
 in vec3 FragPos;  
 in vec3 Normal;
+flat in int MaterialIndex;
 
 uniform vec3 viewPos;
 
@@ -14,6 +20,8 @@ struct DirectionalLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+
+    int shadowTile;
 };
 
 struct PointLight {
@@ -26,6 +34,8 @@ struct PointLight {
     float constant;
     float linear;
     float quadratic;
+
+    int shadowTile;
 }; 
 
 struct SpotLight {
@@ -41,24 +51,96 @@ struct SpotLight {
     float constant;
     float linear;
     float quadratic;
+
+    int shadowTile;
 };    
 
 
+struct MaterialData {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // w = shininess
+    vec4 emission;
+};
+
 struct Material {
     vec3 ambient;
-
     vec4 diffuse;
-    sampler2D diffuseMap;
-
     float shininess;
     vec3 specular;
-    sampler2D specularMap;
-
     vec3 emission;
-    sampler2D emissionMap;
 };
 
-uniform Material material;
+#define MAX_MATERIALS 256
+layout (std140) uniform Materials {
+    MaterialData materials[MAX_MATERIALS];
+};
+
+uniform sampler2D diffuseMap;
+uniform sampler2D specularMap;
+uniform sampler2D emissionMap;
+
+Material material;
+
+uniform mat4 view;
+
+// Pushed along the normal against shadow acne
+vec3 shadowPosition;
+float viewDepth;
+
+// Must match ShadowAtlas
+#define MAX_SHADOW_TILES 64
+#define MAX_CASCADES 4
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[MAX_SHADOW_TILES]; // world to atlas uv and depth
+    vec4 shadowTiles[MAX_SHADOW_TILES];    // xy = min uv, zw = max uv
+    vec4 cascadeSplits;                    // view depth where each cascade ends
+};
+
+uniform sampler2DShadow shadowAtlas;
+
+// 3x3 PCF kept inside the tile, 1 is fully lit
+float SampleShadow(int tile, vec3 position) {
+    vec4 projected = shadowMatrices[tile] * vec4(position, 1.0);
+    vec3 coords = projected.xyz / projected.w;
+    if(coords.z >= 1.0) {
+        return 1.0;
+    }
+
+    vec4 bounds = shadowTiles[tile];
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    float lit = 0.0;
+    for(int y = -1; y <= 1; y++)
+        for(int x = -1; x <= 1; x++)
+            lit += texture(shadowAtlas, vec3(clamp(coords.xy + vec2(x, y) * texel, bounds.xy, bounds.zw), coords.z));
+
+    return lit / 9.0;
+}
+
+// One tile per cascade, past the last one is lit
+float CalcDirectionalShadow(int firstTile, vec3 position, float viewDepth) {
+    for(int i = 0; i < MAX_CASCADES; i++)
+        if(viewDepth < cascadeSplits[i])
+            return SampleShadow(firstTile + i, position);
+
+    return 1.0;
+}
+
+// One tile per cube face, +X -X +Y -Y +Z -Z
+float CalcPointShadow(int firstTile, vec3 lightPosition, vec3 position) {
+    vec3 direction = position - lightPosition;
+    vec3 absolute = abs(direction);
+
+    int face;
+    if(absolute.x >= absolute.y && absolute.x >= absolute.z)
+        face = direction.x >= 0.0 ? 0 : 1;
+    else if(absolute.y >= absolute.z)
+        face = direction.y >= 0.0 ? 2 : 3;
+    else
+        face = direction.z >= 0.0 ? 4 : 5;
+
+    return SampleShadow(firstTile + face, position);
+}
 
 #define MAX_DIRECTIONAL_LIGHTS 4
 uniform int directionalLightsCount;
@@ -79,33 +161,49 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir);
 
 void main()
 {
+    MaterialData data = materials[MaterialIndex];
+    material = Material(data.ambient.rgb, data.diffuse, data.specular.w, data.specular.rgb, data.emission.rgb);
+
     vec3 outColor = vec3(0.0);
-    vec4 textureDiffuse = texture(material.diffuseMap, TexCoord);
+    vec4 textureDiffuse = texture(diffuseMap, TexCoord);
+#ifndef NO_ALPHA_TEST
+    // A discard anywhere in the shader turns off early depth testing, passes after a depth pre-pass leave it out
     if(textureDiffuse.a <= 0.1) {
         discard;
     }
+#endif
 
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
+    shadowPosition = FragPos + norm * 0.02;
+    viewDepth = -(view * vec4(FragPos, 1.0)).z;
 
     vec3 result = vec3(0.0);
 
-    for(int i = 0; i < directionalLightsCount; i++)
+    for(int i = 0; i < min(directionalLightsCount, MAX_DIRECTIONAL_LIGHTS); i++)
          result += CalcDirectionalLight(directionalLights[i], norm, viewDir);
-    for(int i = 0; i < pointLightsCount; i++)
+    for(int i = 0; i < min(pointLightsCount, MAX_POINT_LIGHTS); i++)
         result += CalcPointLight(pointLights[i], norm, viewDir);
-    for(int i = 0; i < spotLightsCount; i++)
+    for(int i = 0; i < min(spotLightsCount, MAX_SPOT_LIGHTS); i++)
         result += CalcSpotLight(spotLights[i], norm, viewDir);
 
-    vec3 emission = material.emission * vec3(texture(material.emissionMap, TexCoord));
-    FragColor = vec4(result + emission, textureDiffuse.a);
+    vec3 emission = material.emission * vec3(texture(emissionMap, TexCoord));
+    vec4 color = vec4(result + emission, textureDiffuse.a * material.diffuse.a);
+#ifdef WEIGHTED_BLENDED
+    // Closer surfaces weigh more, the renderer blends color and weight additively and revealage multiplicatively
+    float weight = color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0));
+    Accumulation = vec4(color.rgb * weight, color.a);
+    Weight = weight;
+#else
+    FragColor = color;
+#endif
 }
 
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
     vec3 lightDir = normalize(-light.direction);
-    vec3 albedo = material.diffuse.rgb * texture(material.diffuseMap, TexCoord).rgb;
-    vec3 specularFactor = material.specular * vec3(texture(material.specularMap, TexCoord));
+    vec3 albedo = material.diffuse.rgb * texture(diffuseMap, TexCoord).rgb;
+    vec3 specularFactor = material.specular * vec3(texture(specularMap, TexCoord));
 
     // ambient shading
     vec3 ambient = light.ambient * albedo;
@@ -119,15 +217,17 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * 128.0);
     vec3 specular = light.specular * spec * specularFactor;
 
+    float shadow = light.shadowTile < 0 ? 1.0 : CalcDirectionalShadow(light.shadowTile, shadowPosition, viewDepth);
+
     // combine results
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * shadow);
 }
 
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir) {
     vec3 lightDir = normalize(light.position - FragPos);
-    vec3 albedo = material.diffuse.rgb * texture(material.diffuseMap, TexCoord).rgb;
-    vec3 specularFactor = material.specular * vec3(texture(material.specularMap, TexCoord));
+    vec3 albedo = material.diffuse.rgb * texture(diffuseMap, TexCoord).rgb;
+    vec3 specularFactor = material.specular * vec3(texture(specularMap, TexCoord));
 
     // attenuation
     float distance    = length(light.position - FragPos);
@@ -146,8 +246,10 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * 128.0);
     vec3 specular = light.specular * spec * specularFactor;
 
+    float shadow = light.shadowTile < 0 ? 1.0 : CalcPointShadow(light.shadowTile, light.position, shadowPosition);
+
     // combine results
-    return (ambient + diffuse + specular) * attenuation;
+    return (ambient + (diffuse + specular) * shadow) * attenuation;
 }
 
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir) {
@@ -161,8 +263,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir) {
         return vec3(0.0);
     }
 
-    vec3 albedo = material.diffuse.rgb * texture(material.diffuseMap, TexCoord).rgb;
-    vec3 specularFactor = material.specular * vec3(texture(material.specularMap, TexCoord));
+    vec3 albedo = material.diffuse.rgb * texture(diffuseMap, TexCoord).rgb;
+    vec3 specularFactor = material.specular * vec3(texture(specularMap, TexCoord));
 
     // attenuation
     float distance    = length(light.position - FragPos);
@@ -181,6 +283,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 viewDir) {
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess * 128.0);
     vec3 specular = light.specular * spec * specularFactor;
 
+    float shadow = light.shadowTile < 0 ? 1.0 : SampleShadow(light.shadowTile, shadowPosition);
+
     // combine results
-    return (ambient + diffuse + specular) * intensity * attenuation;
+    return (ambient + (diffuse + specular) * shadow) * intensity * attenuation;
 }
\ No newline at end of file
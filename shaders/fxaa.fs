@@ -0,0 +1,55 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// FXAA after Lottes, the fast variant: finds the edge direction from the luma of the diagonal neighbours and
+// blends along it, falling back to a shorter blend when the longer one picks up a different surface
+uniform sampler2D scene;
+
+// Contrast below which a pixel is left alone, absolute and relative to the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 1.0 / 32.0;
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+// In pixels
+const float SPAN_MAX = 8.0;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 center = texture(scene, TexCoord).rgb;
+
+    float lumaNW = luma(texture(scene, TexCoord + vec2(-1.0, 1.0) * texel).rgb);
+    float lumaNE = luma(texture(scene, TexCoord + vec2(1.0, 1.0) * texel).rgb);
+    float lumaSW = luma(texture(scene, TexCoord + vec2(-1.0, -1.0) * texel).rgb);
+    float lumaSE = luma(texture(scene, TexCoord + vec2(1.0, -1.0) * texel).rgb);
+    float lumaM = luma(center);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        FragColor = vec4(center, 1.0);
+        return;
+    }
+
+    // Along the edge, perpendicular to the luma gradient
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+    direction = clamp(direction * scale, -SPAN_MAX, SPAN_MAX) * texel;
+
+    vec3 near = 0.5 * (texture(scene, TexCoord + direction * (1.0 / 3.0 - 0.5)).rgb +
+                       texture(scene, TexCoord + direction * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 far = near * 0.5 + 0.25 * (texture(scene, TexCoord - direction * 0.5).rgb +
+                                    texture(scene, TexCoord + direction * 0.5).rgb);
+
+    float lumaFar = luma(far);
+    FragColor = vec4(lumaFar < lumaMin || lumaFar > lumaMax ? near : far, 1.0);
+}
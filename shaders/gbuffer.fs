@@ -0,0 +1,44 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gSpecular;
+layout (location = 2) out vec4 gNormal;
+layout (location = 3) out vec4 gEmission;
+
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+flat in int MaterialIndex;
+
+struct MaterialData {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular; // w = shininess
+    vec4 emission;
+};
+
+#define MAX_MATERIALS 256
+layout (std140) uniform Materials {
+    MaterialData materials[MAX_MATERIALS];
+};
+
+uniform sampler2D diffuseMap;
+uniform sampler2D specularMap;
+uniform sampler2D emissionMap;
+
+void main()
+{
+    MaterialData material = materials[MaterialIndex];
+
+    vec4 textureDiffuse = texture(diffuseMap, TexCoord);
+#ifndef NO_ALPHA_TEST
+    // A discard anywhere in the shader turns off early depth testing, passes after a depth pre-pass leave it out
+    if(textureDiffuse.a <= 0.1) {
+        discard;
+    }
+#endif
+
+    gAlbedo = vec4(material.diffuse.rgb * textureDiffuse.rgb, 1.0);
+    gSpecular = vec4(material.specular.rgb * texture(specularMap, TexCoord).rgb, material.specular.w);
+    gNormal = vec4(normalize(Normal), 0.0);
+    gEmission = vec4(material.emission.rgb * texture(emissionMap, TexCoord).rgb, 1.0);
+}
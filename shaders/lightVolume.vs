@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// LightInstance
+layout (location = 3) in vec4 iPosition;    // w = volume radius
+layout (location = 4) in vec4 iDirection;   // w = cos(cutOff)
+layout (location = 5) in vec4 iAmbient;     // w = cos(outerCutOff)
+layout (location = 6) in vec4 iDiffuse;     // w = cone base radius over length
+layout (location = 7) in vec4 iSpecular;
+layout (location = 8) in vec4 iAttenuation; // constant, linear, quadratic, first shadow tile
+
+flat out vec4 LightPosition;
+flat out vec4 LightDirection;
+flat out vec4 LightAmbient;
+flat out vec3 LightDiffuse;
+flat out vec3 LightSpecular;
+flat out vec4 LightAttenuation;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform bool isSpot;
+
+void main()
+{
+    vec3 worldPos;
+    float radius = iPosition.w;
+
+    if(isSpot) {
+        // Unit cone along +z, oriented to the light direction
+        vec3 forward = normalize(iDirection.xyz);
+        vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        vec3 right = normalize(cross(up, forward));
+        up = cross(forward, right);
+
+        float baseRadius = radius * iDiffuse.w;
+        worldPos = iPosition.xyz + (right * aPos.x + up * aPos.y) * baseRadius + forward * aPos.z * radius;
+    } else {
+        worldPos = iPosition.xyz + aPos * radius;
+    }
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+
+    LightPosition = iPosition;
+    LightDirection = iDirection;
+    LightAmbient = iAmbient;
+    LightDiffuse = iDiffuse.rgb;
+    LightSpecular = iSpecular.rgb;
+    LightAttenuation = iAttenuation;
+}
@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+// Weighted blended order-independent transparency, McGuire and Bavoil 2013
+uniform sampler2D accumulation; // rgb = sum of weighted premultiplied color, a = revealage
+uniform sampler2D weights;      // r = sum of weighted alpha
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumulation, pixel, 0);
+
+    float revealage = accum.a;
+    if (revealage >= 1.0)
+        discard;
+
+    float weight = texelFetch(weights, pixel, 0).r;
+    FragColor = vec4(accum.rgb / max(weight, 1e-5), 1.0 - revealage);
+}
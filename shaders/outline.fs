@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform isampler2D seeds;
+uniform vec3 color;
+uniform float width;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 seed = texelFetch(seeds, pixel, 0).xy;
+
+    // Pixels of the selected objects are their own seed
+    if (seed.x < 0 || seed == pixel)
+        discard;
+
+    float distance = length(vec2(seed - pixel));
+    FragColor = vec4(color, clamp(width + 1.0 - distance, 0.0, 1.0));
+}
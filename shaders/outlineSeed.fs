@@ -0,0 +1,8 @@
+#version 330 core
+out ivec2 Seed;
+
+// Every covered pixel is its own nearest seed
+void main()
+{
+    Seed = ivec2(gl_FragCoord.xy);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+out uint Id;
+
+uniform uint pickId;
+
+void main()
+{
+    Id = pickId;
+}
@@ -0,0 +1,31 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// The scene at its render resolution, bilinearly filtered up to the window
+uniform sampler2D scene;
+// 0 is plain bilinear
+uniform float sharpness;
+
+void main()
+{
+    vec3 color = texture(scene, TexCoord).rgb;
+    if (sharpness <= 0.0)
+    {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    // Unsharp mask over the neighbours a source texel away, limited to their range so edges do not ring
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec3 north = texture(scene, TexCoord + vec2(0.0, texel.y)).rgb;
+    vec3 south = texture(scene, TexCoord - vec2(0.0, texel.y)).rgb;
+    vec3 east = texture(scene, TexCoord + vec2(texel.x, 0.0)).rgb;
+    vec3 west = texture(scene, TexCoord - vec2(texel.x, 0.0)).rgb;
+
+    vec3 minimum = min(color, min(min(north, south), min(east, west)));
+    vec3 maximum = max(color, max(max(north, south), max(east, west)));
+    vec3 sharpened = color + (4.0 * color - north - south - east - west) * sharpness * 0.5;
+    FragColor = vec4(clamp(sharpened, minimum, maximum), 1.0);
+}
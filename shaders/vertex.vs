@@ -6,17 +6,46 @@ layout (location = 2) in vec2 aTexCoord;
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
+flat out int MaterialIndex;
 
+// The depth pre-pass relies on this matching depth.vs exactly
+invariant gl_Position;
+
+#ifdef GPU_CULLED
+// Instances of a batch start at firstInstance, see GpuCulling. Each one carries its palette index
+#define INSTANCE_TEXELS 6
+uniform samplerBuffer instanceData;
+uniform samplerBuffer instanceVisibility;
+uniform int firstInstance;
+#else
 uniform mat4 model;
 uniform mat4 normalMatrix;
+uniform int materialIndex;
+#endif
 
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+#ifdef GPU_CULLED
+    int instance = firstInstance + gl_InstanceID;
+    mat4 model = mat4(texelFetch(instanceData, instance * INSTANCE_TEXELS),
+                      texelFetch(instanceData, instance * INSTANCE_TEXELS + 1),
+                      texelFetch(instanceData, instance * INSTANCE_TEXELS + 2),
+                      texelFetch(instanceData, instance * INSTANCE_TEXELS + 3));
+    mat4 normalMatrix = transpose(inverse(model));
+    int materialIndex = int(texelFetch(instanceData, instance * INSTANCE_TEXELS + 4).w);
+
+    // Culled instances collapse outside the clip volume
+    if(texelFetch(instanceVisibility, instance).r == 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = (model * vec4(aPos, 1.0)).xyz;
     Normal = mat3(normalMatrix) * aNormal;  
     TexCoord = aTexCoord;
+    MaterialIndex = materialIndex;
 }
\ No newline at end of file